@@ -0,0 +1,592 @@
+// Throughput and peak-memory benchmarks for JSONpp.
+//
+// Every case runs in a child process of its own so that the peak resident
+// set size reported for it is not polluted by the cases that ran before it.
+// The input is generated before the clock starts, so the RSS column includes
+// the input text (reported separately) plus whatever the parser needed.
+//
+//   ./jbench            runs all the cases
+//   ./jbench foo bar    runs the cases whose names contain "foo" or "bar"
+//
+// The inputs are about JBENCH_MB (default 8) megabytes each.
+#include <json/jsonpp.hpp>
+#include <json/incremental.hpp>
+#include <json/ndjson.hpp>
+#include <json/transcode.hpp>
+#include <json/arena.hpp>
+#include <json/tape.hpp>
+#include <json/intern.hpp>
+#include <json/compact.hpp>
+#include <json/lazy.hpp>
+#include <json/parallel.hpp>
+#include <json/cbor.hpp>
+#include <json/image.hpp>
+#include <json/bound.hpp>
+#include <json/footprint.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <pthread.h>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// the structs the bound cases parse into: all of a pretty element, and
+// just the "values" of a record (the rest is skipped)
+struct pretty_element {
+  std::string description;
+  std::vector<std::string> values;
+  int count;
+};
+JSONPP_BIND(pretty_element, (description)(values)(count))
+
+struct record_values {
+  std::vector<std::string> values;
+};
+JSONPP_BIND(record_values, (values))
+
+namespace {
+
+  double now () {
+    timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec*1e-6;
+  }
+
+  // read one of the example files
+  std::string slurp (const char* name) {
+    std::string result;
+    if (FILE *file = std::fopen(name, "rb")) {
+      char buffer[4096];
+      std::size_t n;
+      while (0 < (n = std::fread(buffer, 1, sizeof(buffer), file)))
+        result.append(buffer, n);
+      std::fclose(file);
+    }
+    return result;
+  }
+
+  // an array of `element' repeated until the text is about `bytes' long
+  std::string replicate (std::string const& element, std::size_t bytes) {
+    std::string result = "[";
+    result.reserve(bytes + element.size() + 2);
+    while (result.size() < bytes) {
+      if (1 < result.size())
+        result += ",\n";
+      result += element;
+    }
+    result += "]";
+    return result;
+  }
+
+  //=== [INPUTS] ===
+  const std::size_t MB = 1024*1024;
+
+  std::size_t input_size () {
+    const char *mb = std::getenv("JBENCH_MB");
+    return (mb ? std::atoi(mb) : 8) * MB;
+  }
+
+  std::string records () {
+    return replicate(slurp("examples/large-dod.cif"), input_size());
+  }
+  std::string numbers () {
+    return replicate("[1, -2.5, 3.25e2, 1234567, 0.001, 42, 6.02e23, -7]", input_size());
+  }
+  std::string strings () {
+    return replicate("\"the quick brown fox jumps over the lazy dog\"", input_size());
+  }
+  std::string pretty () {
+    return replicate("{\n"
+                     "            \"description\": \"the quick brown fox jumps over the lazy dog\",\n"
+                     "            \"values\": [\n"
+                     "                \"t\",\n"
+                     "                \"u\"\n"
+                     "            ],\n"
+                     "            \"count\": 12\n"
+                     "        }", input_size());
+  }
+
+  // mostly non-ASCII UTF-8 (CJK), and the records as UTF-16LE
+  std::string cjk () {
+    return replicate("\"\xe4\xb8\xad\xe6\x96\x87 \xe6\x96\x87\xe6\x9c\xac \xe6\xb5\x8b\xe8\xaf\x95 text\"", input_size());
+  }
+  std::string records_utf16 () {
+    const std::string ascii = records();
+    std::string result;
+    for (std::size_t i=0; i<ascii.size(); ++i)
+      (result += ascii[i]) += '\0';
+    return result;
+  }
+
+  // 10k levels of nesting
+  std::string deep () {
+    const std::size_t levels = 10000;
+    std::string result;
+    for (std::size_t i=0; i<levels; ++i)
+      result += (i%2) ? "{\"k\":" : "[";
+    result += "\"leaf\"";
+    for (std::size_t i=levels; i>0; --i)
+      result += ((i-1)%2) ? "}" : "]";
+    return result;
+  }
+  // 1M elements in one array
+  std::string wide () {
+    std::string result = "[";
+    for (std::size_t i=0; i<1000000; ++i)
+      result += i ? ",[\"x\"]" : "[\"x\"]";
+    result += "]";
+    return result;
+  }
+
+  // the records, one per line
+  std::string lines () {
+    const std::string cif = slurp("examples/large-dod.cif");
+    const std::string record = JSONpp::to_string(JSONpp::parse(cif.begin(), cif.end()));
+    std::string result;
+    while (result.size() < input_size())
+      result += record + "\n";
+    return result;
+  }
+
+  // the records, also written out to a file for open
+  const char *records_file = "jbench.json";
+  std::string records_on_disk () {
+    std::string input = records();
+    if (FILE *file = std::fopen(records_file, "wb")) {
+      std::fwrite(input.data(), 1, input.size(), file);
+      std::fclose(file);
+    }
+    return input;
+  }
+
+  //=== [BODIES] ===
+  void dom (std::string const& input) {
+    JSONpp::json_v json = JSONpp::parse(input.begin(), input.end());
+  }
+
+  void opened (std::string const&) {
+    JSONpp::json_v json = JSONpp::open(records_file);
+    std::remove(records_file);
+  }
+
+  // strings kept as UTF-8 instead of folded
+  void dom_decoded (std::string const& input) {
+    JSONpp::push_parser<JSONpp::json_v> parser(JSONpp::decoded);
+    JSONpp::json_v json = parser(input.data(), input.data()+input.size());
+  }
+
+  // from a stream, a chunk at a time
+  void stream (std::string const& input) {
+    std::istringstream istr(input);
+    JSONpp::json_v json = JSONpp::parse_stream<JSONpp::json_v>(istr);
+  }
+
+  // printing; the value is parsed before the clock starts
+  struct printing {
+    printing (std::string const& input, JSONpp::string_form form, signed long format)
+      : format(format) {
+      JSONpp::push_parser<JSONpp::json_v> parser(form);
+      this->json = parser(input.data(), input.data()+input.size());
+    }
+    std::size_t print () const {
+      return JSONpp::to_string(this->json, this->format).size();
+    }
+    JSONpp::json_v json;
+    signed long format;
+  };
+  const printing* printed = 0;
+  std::string print_input (std::string (*input) (), JSONpp::string_form form, signed long format) {
+    std::string text = input();
+    printed = new printing(text, form, format);
+    return text;
+  }
+  std::string strings_printed () {
+    return print_input(strings, JSONpp::folded, 0);
+  }
+  std::string records_printed () {
+    return print_input(records, JSONpp::folded, JSONpp::iomanipulator_::standard);
+  }
+  std::string pretty_printed () {
+    return print_input(pretty, JSONpp::folded, 0);
+  }
+  std::string cjk_printed_ascii () {
+    return print_input(cjk, JSONpp::decoded, JSONpp::iomanipulator_::decoded);
+  }
+  std::string cjk_printed_unicode () {
+    return print_input(cjk, JSONpp::decoded,
+                       JSONpp::iomanipulator_::decoded | JSONpp::iomanipulator_::unicode);
+  }
+  void print (std::string const&) {
+    if (0 == printed->print())
+      std::abort();
+  }
+
+  // one worker, and one per CPU
+  void ndjson (std::string const& input, std::size_t workers) {
+    JSONpp::ndjson_parser<JSONpp::json_v> parser(workers);
+    std::vector<JSONpp::json_v> records = parser.parse(input.data(), input.data()+input.size());
+    if (records.empty())
+      std::abort();
+  }
+  void ndjson_serial (std::string const& input) { ndjson(input, 1); }
+  void ndjson_pool (std::string const& input) { ndjson(input, 0); }
+
+  // the transcoding to JSON-ASCII alone
+  void transcode (std::string const& input) {
+    const char *first = input.data(), *last = first + input.size();
+    std::string scratch;
+    JSONpp::json_ascii(first, last, scratch);
+    if (first == last)
+      std::abort();
+  }
+
+  // aggregates a little, so that the events are not optimized away
+  struct counting_handler : JSONpp::null_handler {
+    counting_handler () : values(0), bytes(0) {}
+    void string (const char* first, const char* last) { ++values; bytes += last-first; }
+    void number (const char* first, const char* last) { ++values; bytes += last-first; }
+    void boolean (bool) { ++values; }
+    void null () { ++values; }
+    std::size_t values, bytes;
+  };
+
+  void events (std::string const& input) {
+    counting_handler handler;
+    JSONpp::push(input.begin(), input.end(), handler);
+    if (0 == handler.values)
+      std::abort();
+  }
+
+  // the same, but fed to the incremental parser 64KB at a time
+  void chunked (std::string const& input) {
+    counting_handler handler;
+    JSONpp::incremental_parser<counting_handler> parser(handler);
+    const std::size_t chunk = 64*1024;
+    for (std::size_t i=0; i<input.size(); i+=chunk)
+      parser.feed(input.data()+i, std::min(chunk, input.size()-i));
+    parser.finish();
+    if (0 == handler.values)
+      std::abort();
+  }
+
+  // the lexer alone, scanning or walking the structural index
+  void lex (std::string const& input, bool indexed) {
+    JSONpp::lexer lex(input.data(), input.data()+input.size(), indexed);
+    while (JSONpp::token::eof != lex.kind())
+      lex.next();
+  }
+  void lex_scan (std::string const& input) { lex(input, false); }
+  void lex_index (std::string const& input) { lex(input, true); }
+
+  // objects in flat_maps
+  void dom_flat (std::string const& input) {
+    JSONpp::push_parser<JSONpp::json_flat_v> parser;
+    JSONpp::json_flat_v json = parser(input.data(), input.data()+input.size());
+  }
+
+  // flat objects, with their keys interned
+  void dom_interned (std::string const& input) {
+    JSONpp::string_pool pool;
+    JSONpp::json_interned_v json = JSONpp::parse_interned<JSONpp::json_interned_v>(
+      input.data(), input.data()+input.size(), pool);
+  }
+
+  // 16-byte values
+  void dom_compact (std::string const& input) {
+    JSONpp::push_parser<JSONpp::compact_value> parser;
+    JSONpp::compact_value json = parser(input.data(), input.data()+input.size());
+  }
+
+  // one field out of each record, on demand
+  void lazy (std::string const& input) {
+    JSONpp::lazy_document doc;
+    JSONpp::lazy_array records = doc.parse(input).array();
+    std::size_t total = 0;
+    for (JSONpp::lazy_array::const_iterator at=records.begin(); at!=records.end(); ++at)
+      total += at->object().find("values")->second.array()[0].length();
+    if (0 == total)
+      std::abort();
+  }
+
+  // the records of one big array, over a pool of threads
+  void parallel (std::string const& input, std::size_t workers) {
+    JSONpp::parallel_parser<JSONpp::json_v> parser(workers, 256*1024);
+    JSONpp::json_v json = parser(input);
+  }
+  void parallel_1 (std::string const& input) { parallel(input, 1); }
+  void parallel_4 (std::string const& input) { parallel(input, 4); }
+
+  // CBOR, to and from json_v; the rate is in bytes of the JSON text, so
+  // that it compares with the text path (dom/..., print/...)
+  std::string cbor_bytes;
+  std::string cbor_input (std::string (*input) ()) {
+    std::string text = input();
+    JSONpp::push_parser<JSONpp::json_v> parser;
+    JSONpp::json_v json = parser(text.data(), text.data()+text.size());
+    JSONpp::cbor_encode(json, std::back_inserter(cbor_bytes));
+    printed = new printing(text, JSONpp::folded, 0);
+    return text;
+  }
+  std::string records_cbor () { return cbor_input(records); }
+  std::string numbers_cbor () { return cbor_input(numbers); }
+  std::string strings_cbor () { return cbor_input(strings); }
+  void cbor_encode (std::string const&) {
+    std::string bytes;
+    JSONpp::cbor_encode(printed->json, std::back_inserter(bytes));
+    if (bytes.size() != cbor_bytes.size())
+      std::abort();
+  }
+  void cbor_decode (std::string const&) {
+    JSONpp::json_v json = JSONpp::cbor_decoder<JSONpp::json_v>()(cbor_bytes);
+  }
+
+  // the flat tape instead of a tree
+  void taped (std::string const& input) {
+    JSONpp::tape doc;
+    doc.parse(input.data(), input.data()+input.size());
+  }
+
+  // opening a document image written before the clock starts, and going
+  // to the last record (none of the strings are read)
+  const char *image_file = "jbench-records.jsonim";
+  std::string records_imaged () {
+    std::string text = records();
+    JSONpp::tape doc;
+    doc.parse(text.data(), text.data()+text.size());
+    JSONpp::write_image(doc, image_file);
+    return text;
+  }
+  void imaged (std::string const&) {
+    {
+      JSONpp::document_image image(image_file);
+      JSONpp::tape_value last;
+      const JSONpp::tape_array array = image.root().array();
+      for (JSONpp::tape_array::const_iterator at=array.begin(); at!=array.end(); ++at)
+        last = *at;
+      if (JSONpp::tape::object != last.kind())
+        std::abort();
+    }
+    std::remove(image_file);
+  }
+
+  // straight into structs, and printed from them
+  void bound_pretty (std::string const& input) {
+    std::vector<pretty_element> elements = JSONpp::bound_parser<std::vector<pretty_element> >()(input);
+  }
+  void bound_records (std::string const& input) {
+    std::vector<record_values> records = JSONpp::bound_parser<std::vector<record_values> >()(input);
+  }
+  const std::vector<pretty_element>* printed_elements = 0;
+  std::string pretty_bound () {
+    std::string text = pretty();
+    printed_elements = new std::vector<pretty_element>(
+      JSONpp::bound_parser<std::vector<pretty_element> >()(text));
+    return text;
+  }
+  void print_bound (std::string const&) {
+    if (0 == JSONpp::bound_to_string(*printed_elements).size())
+      std::abort();
+  }
+
+  // measuring a tree, and shrinking it; it is parsed before the clock starts
+  JSONpp::json_v* measured = 0;
+  std::string records_measured () {
+    std::string text = records();
+    measured = new JSONpp::json_v(JSONpp::parse(text.begin(), text.end()));
+    return text;
+  }
+  void measure (std::string const&) {
+    if (0 == JSONpp::measure(*measured).bytes())
+      std::abort();
+  }
+  void shrink (std::string const&) {
+    JSONpp::shrink_to_fit(*measured);
+  }
+
+  // printing the tape; it is parsed before the clock starts
+  const JSONpp::tape* printed_tape = 0;
+  std::string records_taped () {
+    std::string text = records();
+    JSONpp::tape *doc = new JSONpp::tape;
+    doc->parse(text.data(), text.data()+text.size());
+    printed_tape = doc;
+    return text;
+  }
+  void print_tape (std::string const&) {
+    std::ostringstream ostr;
+    ostr << JSONpp::std_ascii << JSONpp::printer(printed_tape->root());
+    if (0 == ostr.str().size())
+      std::abort();
+  }
+
+  // parse+destroy cycles, one record (line) at a time, on a few threads
+  // each taking every Nth line: the values go to the heap, or to an arena
+  // per thread that is reset for the next record
+  std::size_t cycles_done = 0;
+  struct cycling {
+    const std::string *input;
+    std::size_t thread, threads, cycles;
+    bool arena;
+  };
+  void* cycle (void* arg) {
+    cycling& work = *static_cast<cycling*>(arg);
+    JSONpp::arena memory;
+    JSONpp::arena_document<JSONpp::arena_json_v> doc(memory);
+    JSONpp::push_parser<JSONpp::json_v> parser;
+    const char *first = work.input->data(), *last = first + work.input->size();
+    for (std::size_t line=0; first != last; ++line) {
+      const char *eol = (const char*)std::memchr(first, '\n', last - first);
+      if (not eol) eol = last;
+      if (work.thread == line % work.threads) {
+        if (work.arena)
+          doc.parse(first, eol);
+        else
+          JSONpp::json_v json = parser(first, eol);
+        ++work.cycles;
+      }
+      first = (eol == last) ? last : eol+1;
+    }
+    return 0;
+  }
+  void cycles (std::string const& input, std::size_t threads, bool arena) {
+    std::vector<cycling> work(threads);
+    std::vector<pthread_t> ids(threads);
+    for (std::size_t t=0; t<threads; ++t) {
+      cycling c = { &input, t, threads, 0, arena };
+      work[t] = c;
+      if (0 != pthread_create(&ids[t], 0, cycle, &work[t]))
+        std::abort();
+    }
+    for (std::size_t t=0; t<threads; ++t) {
+      pthread_join(ids[t], 0);
+      cycles_done += work[t].cycles;
+    }
+  }
+  void cycles_heap_1 (std::string const& input) { cycles(input, 1, false); }
+  void cycles_heap_4 (std::string const& input) { cycles(input, 4, false); }
+  void cycles_arena_1 (std::string const& input) { cycles(input, 1, true); }
+  void cycles_arena_4 (std::string const& input) { cycles(input, 4, true); }
+
+  // one big document, parsed into an arena and dropped with it
+  void dom_arena (std::string const& input) {
+    JSONpp::arena memory;
+    JSONpp::arena_document<JSONpp::arena_json_v> doc(memory);
+    doc.parse(input.data(), input.data()+input.size());
+  }
+
+  struct bench_case {
+    const char *name;
+    std::string (*input) ();
+    void (*body) (std::string const&);
+  };
+
+  const bench_case cases[] = {
+    { "dom/records", records, dom },
+    { "dom/numbers", numbers, dom },
+    { "dom/strings", strings, dom },
+    { "dom/cjk", cjk, dom },
+    { "dom-decoded/cjk", cjk, dom_decoded },
+    { "dom-decoded/strings", strings, dom_decoded },
+    { "dom/utf16", records_utf16, dom },
+    { "stream/utf16", records_utf16, stream },
+    { "open/records", records_on_disk, opened },
+    { "dom/deep", deep, dom },
+    { "dom/wide", wide, dom },
+    { "dom/pretty", pretty, dom },
+    { "dom-flat/records", records, dom_flat },
+    { "dom-flat/pretty", pretty, dom_flat },
+    { "dom-interned/records", records, dom_interned },
+    { "dom-interned/pretty", pretty, dom_interned },
+    { "dom-compact/records", records, dom_compact },
+    { "dom-compact/numbers", numbers, dom_compact },
+    { "dom-compact/strings", strings, dom_compact },
+    { "lazy/records", records, lazy },
+    { "parallel-1/records", records, parallel_1 },
+    { "parallel-4/records", records, parallel_4 },
+    { "cbor-encode/records", records_cbor, cbor_encode },
+    { "cbor-decode/records", records_cbor, cbor_decode },
+    { "cbor-decode/numbers", numbers_cbor, cbor_decode },
+    { "cbor-decode/strings", strings_cbor, cbor_decode },
+    { "dom-arena/records", records, dom_arena },
+    { "dom-arena/numbers", numbers, dom_arena },
+    { "dom-arena/wide", wide, dom_arena },
+    { "tape/records", records, taped },
+    { "tape/numbers", numbers, taped },
+    { "tape/strings", strings, taped },
+    { "tape/wide", wide, taped },
+    { "image-open/records", records_imaged, imaged },
+    { "bound/pretty", pretty, bound_pretty },
+    { "bound/records", records, bound_records },
+    { "cycles-heap-1/lines", lines, cycles_heap_1 },
+    { "cycles-heap-4/lines", lines, cycles_heap_4 },
+    { "cycles-arena-1/lines", lines, cycles_arena_1 },
+    { "cycles-arena-4/lines", lines, cycles_arena_4 },
+    { "ndjson-1/lines", lines, ndjson_serial },
+    { "ndjson-N/lines", lines, ndjson_pool },
+    { "transcode/records", records, transcode },
+    { "transcode/cjk", cjk, transcode },
+    { "transcode/utf16", records_utf16, transcode },
+    { "events/records", records, events },
+    { "events/numbers", numbers, events },
+    { "events/strings", strings, events },
+    { "chunked/records", records, chunked },
+    { "chunked/numbers", numbers, chunked },
+    { "chunked/strings", strings, chunked },
+    { "print/strings", strings_printed, print },
+    { "print/records", records_printed, print },
+    { "print/pretty", pretty_printed, print },
+    { "print-tape/records", records_taped, print_tape },
+    { "print-bound/pretty", pretty_bound, print_bound },
+    { "measure/records", records_measured, measure },
+    { "shrink/records", records_measured, shrink },
+    { "print-ascii/cjk", cjk_printed_ascii, print },
+    { "print-unicode/cjk", cjk_printed_unicode, print },
+    { "lex-scan/records", records, lex_scan },
+    { "lex-index/records", records, lex_index },
+    { "lex-scan/pretty", pretty, lex_scan },
+    { "lex-index/pretty", pretty, lex_index },
+  };
+
+  void run (bench_case const& bc) {
+    std::fflush(stdout);
+    pid_t pid = fork();
+    if (0 == pid) {
+      std::string input = bc.input();
+      double start = now();
+      bc.body(input);
+      double elapsed = now() - start;
+      rusage usage;
+      getrusage(RUSAGE_SELF, &usage);
+      std::printf("%-24s %8.1f MB/s %8.3f s  input %6lu KB  peak RSS %8ld KB",
+                  bc.name, input.size()/elapsed/MB, elapsed,
+                  (unsigned long)(input.size()/1024), usage.ru_maxrss);
+      if (cycles_done)
+        std::printf("  %8.0f cycles/s", cycles_done/elapsed);
+      std::printf("\n");
+      std::fflush(stdout);
+      _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (not WIFEXITED(status) or 0 != WEXITSTATUS(status))
+      std::printf("%-24s failed\n", bc.name);
+  }
+
+}
+
+int main (int argc, char *argv[]) {
+  const std::size_t N = sizeof(cases)/sizeof(cases[0]);
+  for (std::size_t i=0; i<N; ++i) {
+    bool selected = (argc < 2);
+    for (int a=1; a<argc; ++a)
+      if (std::strstr(cases[i].name, argv[a]))
+        selected = true;
+    if (selected)
+      run(cases[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,387 @@
+#include "jsonpp.hpp"
+#include "flat_map.hpp"
+// boost
+#include <boost/type_traits/alignment_of.hpp>
+// STL
+#include <cstddef>
+#include <cstdlib>
+#include <limits>
+#include <map>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef JSONPP_ARENA
+#define JSONPP_ARENA
+
+namespace JSONpp {
+
+	//=== [ARENA] ===
+	// A monotonic arena: memory is handed out from big blocks, front to
+	// back, and never given back one piece at a time; reset() takes it all
+	// back at once (and keeps the blocks for the next round), release()
+	// returns the blocks themselves to the heap.
+	//
+	// An arena is not thread-safe; give each thread its own.
+	class arena {
+	public:
+		explicit arena (std::size_t block=64*1024)
+			: block_(block ? block : 1), current_(0), used_(0), spent_(0) {}
+		~arena () { this->release(); }
+
+		void* allocate (std::size_t size, std::size_t align=sizeof(void*)) {
+			while (this->current_ < this->blocks_.size()) {
+				block& b = this->blocks_[this->current_];
+				const std::size_t at = (this->used_ + align-1) & ~(align-1);
+				if (at + size <= b.size) {
+					this->used_ = at + size;
+					return b.memory + at;
+				}
+				// on to the next block; a big request takes one of its own
+				this->spent_ += this->used_;
+				++this->current_;
+				this->used_ = 0;
+			}
+			std::size_t size_of = this->blocks_.empty() ? this->block_
+				: 2*this->blocks_.back().size;
+			if (size_of < size + align)
+				size_of = size + align;
+			void *memory = std::malloc(size_of);
+			if (not memory)
+				throw std::bad_alloc();
+			this->blocks_.push_back(block(static_cast<char*>(memory), size_of));
+			return this->allocate(size, align);
+		}
+
+		// everything allocated so far is gone, at once; no destructors are run
+		void reset () {
+			this->current_ = 0;
+			this->used_ = 0;
+			this->spent_ = 0;
+		}
+		void release () {
+			for (std::size_t b=0; b<this->blocks_.size(); ++b)
+				std::free(this->blocks_[b].memory);
+			this->blocks_.clear();
+			this->reset();
+		}
+
+		// bytes handed out since the last reset, and held from the heap
+		std::size_t used () const { return this->spent_ + this->used_; }
+		std::size_t reserved () const {
+			std::size_t total = 0;
+			for (std::size_t b=0; b<this->blocks_.size(); ++b)
+				total += this->blocks_[b].size;
+			return total;
+		}
+
+		// While a scope is alive, arena_allocators made on its thread (the
+		// ones the parser default-constructs) allocate from its arena.
+		class scope {
+		public:
+			explicit scope (arena& A) : previous_(current()) { current() = &A; }
+			~scope () { current() = this->previous_; }
+		private:
+			scope (scope const&);
+			scope& operator = (scope const&);
+			arena *previous_;
+		};
+		static arena*& current () {
+			static JSONPP_THREAD_LOCAL arena *in_use = 0;
+			return in_use;
+		}
+
+	private:
+		struct block {
+			block (char* memory, std::size_t size) : memory(memory), size(size) {}
+			char *memory;
+			std::size_t size;
+		};
+
+		arena (arena const&);
+		arena& operator = (arena const&);
+
+		std::size_t block_;
+		std::vector<block> blocks_;
+		std::size_t current_, used_; // the block in use, and how far into it
+		std::size_t spent_;          // used of the blocks before it
+	};
+
+	// The allocator for the containers of an arena-backed value: it
+	// allocates from the arena that was current when it was made (copies of
+	// it, and the containers they went into, keep using that arena); made
+	// with no arena current, it is an ordinary heap allocator.
+	template <typename T>
+	class arena_allocator {
+	public:
+		typedef T                  value_type;
+		typedef T*                 pointer;
+		typedef T const*           const_pointer;
+		typedef T&                 reference;
+		typedef T const&           const_reference;
+		typedef std::size_t        size_type;
+		typedef std::ptrdiff_t     difference_type;
+		template <typename U> struct rebind { typedef arena_allocator<U> other; };
+
+		arena_allocator () throw() : arena_(arena::current()) {}
+		explicit arena_allocator (arena& A) throw() : arena_(&A) {}
+		template <typename U>
+		arena_allocator (arena_allocator<U> const& A) throw() : arena_(A.memory()) {}
+
+		T* allocate (size_type n, const void* =0) {
+			if (n > this->max_size())
+				throw std::bad_alloc();
+			if (this->arena_)
+				return static_cast<T*>(this->arena_->allocate(n*sizeof(T),
+					boost::alignment_of<T>::value));
+			return static_cast<T*>(::operator new(n*sizeof(T)));
+		}
+		// nothing is given back to an arena until it is reset
+		void deallocate (T* p, size_type) {
+			if (not this->arena_)
+				::operator delete(p);
+		}
+
+		size_type max_size () const throw() {
+			return std::numeric_limits<size_type>::max() / sizeof(T);
+		}
+#if __cplusplus < 201103L
+		// (from C++11 on, allocator_traits constructs, and moves too)
+		void construct (T* p, T const& value) { new (p) T(value); }
+		void destroy (T* p) { p->~T(); }
+#endif
+		pointer address (reference r) const { return &r; }
+		const_pointer address (const_reference r) const { return &r; }
+
+		arena* memory () const { return this->arena_; }
+
+		friend bool operator == (arena_allocator const& L, arena_allocator const& R) {
+			return L.arena_ == R.arena_;
+		}
+		friend bool operator != (arena_allocator const& L, arena_allocator const& R) {
+			return L.arena_ != R.arena_;
+		}
+
+	private:
+		arena *arena_;
+	};
+
+	// boost::variant keeps the objects and arrays of a recursive value in a
+	// recursive_wrapper, a box on the heap; the box of an arena container
+	// (a std::map, std::vector or flat_map with an arena_allocator) goes in
+	// the same arena (or on the heap, when it has none). Unlike the
+	// heap box, moving it does not throw: the box is handed over, and the
+	// one moved from is left empty (it reads as an empty container, and
+	// gets a box of its own when it is next written to), so an array of
+	// values grows by moving them, not copying them.
+	template <typename T>
+	class arena_box {
+	public:
+		typedef T type;
+
+		T& get () { return *this->made(); }
+		T const& get () const { return this->p_ ? *this->p_ : none(); }
+		T* get_pointer () { return this->made(); }
+		T const* get_pointer () const { return &this->get(); }
+
+		arena_box& operator = (arena_box const& rhs) {
+			this->get() = rhs.get();
+			return *this;
+		}
+		arena_box& operator = (T const& rhs) {
+			this->get() = rhs;
+			return *this;
+		}
+#if __cplusplus >= 201103L
+		arena_box& operator = (arena_box&& rhs) noexcept {
+			this->swap(rhs);
+			return *this;
+		}
+		arena_box& operator = (T&& rhs) {
+			this->get() = std::move(rhs);
+			return *this;
+		}
+#endif
+		void swap (arena_box& operand) throw() {
+			std::swap(this->p_, operand.p_);
+			std::swap(this->arena_, operand.arena_);
+		}
+
+	protected:
+		arena_box () : arena_(arena::current()) { this->p_ = new (this->allocate()) T; }
+		arena_box (T const& operand) : arena_(operand.get_allocator().memory()) {
+			this->p_ = new (this->allocate()) T(operand);
+		}
+		arena_box (arena_box const& operand) : arena_(operand.arena_) {
+			this->p_ = new (this->allocate()) T(operand.get());
+		}
+#if __cplusplus >= 201103L
+		arena_box (T&& operand) : arena_(operand.get_allocator().memory()) {
+			this->p_ = new (this->allocate()) T(std::move(operand));
+		}
+		arena_box (arena_box&& operand) noexcept : p_(operand.p_), arena_(operand.arena_) {
+			operand.p_ = 0;
+		}
+#endif
+		~arena_box () {
+			if (not this->p_) // moved from
+				return;
+			this->p_->~T();
+			if (not this->arena_)
+				::operator delete(this->p_);
+		}
+
+	private:
+		// the box, made again (empty) if it was moved from
+		T* made () {
+#if __cplusplus >= 201103L
+			if (not this->p_) {
+				void *p = this->allocate();
+				this->p_ = this->arena_ ? new (p) T(typename T::allocator_type(*this->arena_)) : new (p) T;
+			}
+#endif
+			return this->p_;
+		}
+		// what a box that was moved from reads as
+		static T const& none () {
+			static const T empty;
+			return empty;
+		}
+		void* allocate () {
+			return this->arena_ ? this->arena_->allocate(sizeof(T), boost::alignment_of<T>::value)
+				: ::operator new(sizeof(T));
+		}
+
+		T *p_;
+		arena *arena_;
+	};
+
+}
+
+namespace boost {
+
+	template <typename K, typename V, typename C>
+	class recursive_wrapper<std::map<K,V,C,JSONpp::arena_allocator<std::pair<const K,V> > > >
+		: public JSONpp::arena_box<std::map<K,V,C,JSONpp::arena_allocator<std::pair<const K,V> > > > {
+		typedef JSONpp::arena_box<std::map<K,V,C,JSONpp::arena_allocator<std::pair<const K,V> > > > box;
+	public:
+		recursive_wrapper () {}
+		recursive_wrapper (typename box::type const& operand) : box(operand) {}
+#if __cplusplus >= 201103L
+		recursive_wrapper (typename box::type&& operand) : box(std::move(operand)) {}
+#endif
+		using box::operator =;
+	};
+
+	template <typename V>
+	class recursive_wrapper<std::vector<V,JSONpp::arena_allocator<V> > >
+		: public JSONpp::arena_box<std::vector<V,JSONpp::arena_allocator<V> > > {
+		typedef JSONpp::arena_box<std::vector<V,JSONpp::arena_allocator<V> > > box;
+	public:
+		recursive_wrapper () {}
+		recursive_wrapper (typename box::type const& operand) : box(operand) {}
+#if __cplusplus >= 201103L
+		recursive_wrapper (typename box::type&& operand) : box(std::move(operand)) {}
+#endif
+		using box::operator =;
+	};
+
+	template <typename K, typename V>
+	class recursive_wrapper<JSONpp::flat_map<K,V,JSONpp::arena_allocator<std::pair<K,V> > > >
+		: public JSONpp::arena_box<JSONpp::flat_map<K,V,JSONpp::arena_allocator<std::pair<K,V> > > > {
+		typedef JSONpp::arena_box<JSONpp::flat_map<K,V,JSONpp::arena_allocator<std::pair<K,V> > > > box;
+	public:
+		recursive_wrapper () {}
+		recursive_wrapper (typename box::type const& operand) : box(operand) {}
+#if __cplusplus >= 201103L
+		recursive_wrapper (typename box::type&& operand) : box(std::move(operand)) {}
+#endif
+		using box::operator =;
+	};
+
+	// (boost says no recursive_wrapper moves without throwing, for all of them)
+	template <typename K, typename V, typename C>
+	struct is_nothrow_move_constructible<recursive_wrapper<
+		std::map<K,V,C,JSONpp::arena_allocator<std::pair<const K,V> > > > >
+		: boost::integral_constant<bool, __cplusplus >= 201103L> {};
+	template <typename V>
+	struct is_nothrow_move_constructible<recursive_wrapper<
+		std::vector<V,JSONpp::arena_allocator<V> > > >
+		: boost::integral_constant<bool, __cplusplus >= 201103L> {};
+	template <typename K, typename V>
+	struct is_nothrow_move_constructible<recursive_wrapper<
+		JSONpp::flat_map<K,V,JSONpp::arena_allocator<std::pair<K,V> > > > >
+		: boost::integral_constant<bool, __cplusplus >= 201103L> {};
+
+}
+
+namespace JSONpp {
+
+	// json_v, with every string and container in an arena:
+	//
+	//    JSONpp::arena memory;
+	//    JSONpp::arena_document<arena_json_v> doc(memory);
+	//    doc.parse(first, last);   // doc.root() is the value
+	//    doc.clear();              // the whole tree is gone, in O(1)
+	//
+	typedef std::basic_string<char,std::char_traits<char>,arena_allocator<char> > arena_string;
+	typedef make_json_value<arena_string,double,bool,nil,arena_allocator<char> > arena_json_gen;
+	typedef arena_json_gen::value_t arena_json_v;
+
+	template <>
+	struct json_traits<arena_json_v> {
+		typedef arena_json_v                    value_t;
+		typedef arena_string                    string_t;
+		typedef double                          number_t;
+		typedef arena_json_gen::object_t        object_t;
+		typedef arena_json_gen::array_t         array_t;
+		typedef bool                            bool_t;
+		typedef nil                             null_t;
+	};
+
+	// A parsed value that lives entirely in an arena, root included. It is
+	// never destroyed, only forgotten: clear() (and the next parse) resets
+	// the arena, and that is all. Values taken out of the root must not
+	// outlive that.
+	template <typename JSONType>
+	class arena_document {
+	public:
+		typedef typename json_traits<JSONType>::value_t value_t;
+
+		explicit arena_document (arena& memory, string_form form=folded)
+			: arena_(&memory), root_(0), form_(form) {}
+
+		template <typename Iter>
+		value_t& parse (Iter first, Iter last, bool extensions=false) {
+			this->clear();
+			arena::scope in(*this->arena_);
+			push_parser<JSONType> parser(this->form_);
+			void *root = this->arena_->allocate(sizeof(value_t),
+				boost::alignment_of<value_t>::value);
+			this->root_ = new (root) value_t(parser(first, last, extensions));
+			return *this->root_;
+		}
+
+		bool empty () const { return 0 == this->root_; }
+		value_t& root () { return *this->root_; }
+		value_t const& root () const { return *this->root_; }
+		arena& memory () const { return *this->arena_; }
+
+		void clear () {
+			this->root_ = 0;
+			this->arena_->reset();
+		}
+
+	private:
+		arena_document (arena_document const&);
+		arena_document& operator = (arena_document const&);
+
+		arena *arena_;
+		value_t *root_;
+		string_form form_;
+	};
+
+}
+
+#endif//JSONPP_ARENA
@@ -0,0 +1,511 @@
+#include "jsonpp.hpp"
+// boost
+#include <boost/optional.hpp>
+#include <boost/preprocessor/seq/for_each.hpp>
+#include <boost/preprocessor/stringize.hpp>
+#include <boost/type_traits/is_floating_point.hpp>
+#include <boost/type_traits/is_integral.hpp>
+#include <boost/type_traits/is_same.hpp>
+#include <boost/utility/enable_if.hpp>
+// STL
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#ifndef JSONPP_BOUND
+#define JSONPP_BOUND
+
+namespace JSONpp {
+
+	//=== [BOUND STRUCTS] ===
+	// Parsing straight into a struct, and printing one, with no json_v in
+	// between. The struct says which of its fields go with which keys by
+	// specializing json_binding:
+	//
+	//    struct point { double x, y; std::string name; };
+	//
+	//    namespace JSONpp {
+	//      template <> struct json_binding<point> {
+	//        template <typename Fields>
+	//        static void fields (Fields& f) {
+	//          f("x", &point::x)("y", &point::y)("label", &point::name);
+	//        }
+	//      };
+	//    }
+	//
+	// or, when the keys are the names of the fields, with the macro (at
+	// namespace scope, outside of any namespace):
+	//
+	//    JSONPP_BIND(point, (x)(y)(name))
+	//
+	// and then
+	//
+	//    JSONpp::bound_parser<point> parser;
+	//    point p = parser(first, last);
+	//    std::string text = JSONpp::bound_to_string(p);
+	//
+	// The parser pulls tokens from the same lexer as push_parser; at each
+	// key of an object it goes straight to its field (trying the field
+	// after the last one first, since the keys usually come in order) and
+	// parses the value into it. A key with no field has its value skipped,
+	// without building anything. Fields whose keys are missing are left as
+	// they were. A field may be a number (any arithmetic type; integers
+	// must be integers, and fit), bool, std::string (in the string_form
+	// of the parser), std::vector of any of these, boost::optional of any
+	// of these (null or missing is none, and none is not printed), or
+	// another bound struct. Anything else is a mistake, and throws
+	// expected_got like push_parser.
+	template <typename T>
+	struct json_binding;
+
+	// what the parser and the printer carry along
+	struct bound_context {
+		bound_context (string_form f) : form(f) {}
+		string_form form;
+		std::string scratch;
+	};
+
+	// the values: read one from the lexer, print one, and whether to print
+	// one at all (bound structs are the primary template)
+	template <typename U, typename Enable=void>
+	struct bound;
+
+	namespace detail {
+		inline void expect_token (lexer& lex, token::kind k, const char* name) {
+			if (k == lex.kind())
+				return;
+			if (token::eof == lex.kind())
+				throw expected_got(name, "nothing");
+			throw expected_got(name, lex.current().value());
+		}
+
+		// a whole value, parsed for its mistakes but not kept
+		inline void skip_value (lexer& lex) {
+			switch (lex.kind()) {
+			case token::string: case token::number:
+			case token::boolean: case token::null:
+				lex.next();
+				return;
+			case token::curlyL:
+				lex.next();
+				if (token::curlyR != lex.kind()) {
+					while (true) {
+						if (token::string != lex.kind() and token::number != lex.kind())
+							expect_token(lex, token::string, "string");
+						lex.next();
+						expect_token(lex, token::colon, ":");
+						lex.next();
+						skip_value(lex);
+						if (token::comma != lex.kind())
+							break;
+						lex.next();
+					}
+				}
+				expect_token(lex, token::curlyR, "}");
+				lex.next();
+				return;
+			case token::brakL:
+				lex.next();
+				if (token::brakR != lex.kind()) {
+					while (true) {
+						skip_value(lex);
+						if (token::comma != lex.kind())
+							break;
+						lex.next();
+					}
+				}
+				expect_token(lex, token::brakR, "]");
+				lex.next();
+				return;
+			case token::eof:
+				throw expected_got("value","nothing");
+			default:
+				throw unexpected_token(lex.current().value());
+			}
+		}
+
+		// the text of a string (or key) token in the form of the parser
+		inline void token_text (bound_context& C, token const& tok, std::string& out) {
+			if (decoded == C.form) {
+				out.clear();
+				json_unescape(tok.first_, tok.last_, out);
+			} else
+				out.assign(tok.first_, tok.last_);
+		}
+
+		inline void write_text (bound_context& C, const char* first, const char* last,
+														std::string& out) {
+			out += '\"';
+			if (decoded == C.form)
+				json_escape(first, last, true, out);
+			else
+				json_folded_escape(first, last, false, out);
+			out += '\"';
+		}
+
+		// a field of T: its key, and how to read and print it
+		template <typename T>
+		struct bound_field {
+			bound_field (const char* k) : key(k), length(std::strlen(k)) {}
+			virtual ~bound_field () {}
+			virtual void read (bound_context& C, lexer& lex, T& object) const = 0;
+			virtual bool present (T const& object) const = 0;
+			virtual void write (bound_context& C, T const& object, std::string& out) const = 0;
+			const char *key;
+			std::size_t length;
+		};
+
+		template <typename T, typename M>
+		struct bound_member : bound_field<T> {
+			bound_member (const char* k, M T::*m) : bound_field<T>(k), member(m) {}
+			void read (bound_context& C, lexer& lex, T& object) const {
+				bound<M>::read(C, lex, object.*this->member);
+			}
+			bool present (T const& object) const {
+				return bound<M>::present(object.*this->member);
+			}
+			void write (bound_context& C, T const& object, std::string& out) const {
+				bound<M>::write(C, object.*this->member, out);
+			}
+			M T::*member;
+		};
+
+		// the fields of T, in the order json_binding<T> gave them, made once
+		template <typename T>
+		class bound_fields {
+		public:
+			typedef std::vector<bound_field<T>*> fields_t;
+
+			static fields_t const& get () {
+				static const bound_fields made;
+				return made.fields_;
+			}
+
+			// what json_binding<T>::fields is called with
+			template <typename M>
+			bound_fields& operator () (const char* key, M T::*member) {
+				this->fields_.push_back(new bound_member<T,M>(key, member));
+				return *this;
+			}
+
+		private:
+			bound_fields () { json_binding<T>::fields(*this); }
+			~bound_fields () {
+				for (std::size_t i=0; i<this->fields_.size(); ++i)
+					delete this->fields_[i];
+			}
+			bound_fields (bound_fields const&);
+			bound_fields& operator = (bound_fields const&);
+
+			fields_t fields_;
+		};
+	}
+
+	// a bound struct
+	template <typename T, typename Enable>
+	struct bound {
+		typedef typename detail::bound_fields<T>::fields_t fields_t;
+
+		static void read (bound_context& C, lexer& lex, T& object) {
+			fields_t const& fields = detail::bound_fields<T>::get();
+			detail::expect_token(lex, token::curlyL, "{");
+			lex.next();
+			if (token::curlyR != lex.kind()) {
+				std::size_t guess = 0;  // where the next key probably is
+				while (true) {
+					if (token::string != lex.kind() and token::number != lex.kind())
+						detail::expect_token(lex, token::string, "string");
+					const std::size_t at = find(C, lex.current(), fields, guess);
+					lex.next();
+					detail::expect_token(lex, token::colon, ":");
+					lex.next();
+					if (at < fields.size()) {
+						fields[at]->read(C, lex, object);
+						guess = at+1;
+					} else
+						detail::skip_value(lex);
+					if (token::comma != lex.kind())
+						break;
+					lex.next();
+				}
+			}
+			detail::expect_token(lex, token::curlyR, "}");
+			lex.next();
+		}
+		static bool present (T const&) { return true; }
+		static void write (bound_context& C, T const& object, std::string& out) {
+			fields_t const& fields = detail::bound_fields<T>::get();
+			out += '{';
+			bool first = true;
+			for (std::size_t i=0; i<fields.size(); ++i) {
+				if (not fields[i]->present(object))
+					continue;
+				if (not first)
+					out += ',';
+				first = false;
+				out += '\"';
+				json_escape(fields[i]->key, fields[i]->key + fields[i]->length, true, out);
+				out += "\":";
+				fields[i]->write(C, object, out);
+			}
+			out += '}';
+		}
+
+	private:
+		// the field with the key of tok (fields.size() if there is none)
+		static std::size_t find (bound_context& C, token const& tok,
+														 fields_t const& fields, std::size_t guess) {
+			const char *first = tok.first_, *last = tok.last_;
+			// an escape in a key has to go before it is compared
+			if (std::memchr(first, '\\', last - first)) {
+				C.scratch.clear();
+				json_unescape(first, last, C.scratch);
+				first = C.scratch.data();
+				last = first + C.scratch.size();
+			}
+			const std::size_t length = last - first;
+			for (std::size_t n=0; n<fields.size(); ++n, ++guess) {
+				if (fields.size() <= guess)
+					guess = 0;
+				if (fields[guess]->length == length
+						and 0 == std::memcmp(fields[guess]->key, first, length))
+					return guess;
+			}
+			return fields.size();
+		}
+	};
+
+	template <>
+	struct bound<bool> {
+		static void read (bound_context&, lexer& lex, bool& b) {
+			detail::expect_token(lex, token::boolean, "boolean");
+			b = ('t' == *lex.current().first_);
+			lex.next();
+		}
+		static bool present (bool) { return true; }
+		static void write (bound_context&, bool b, std::string& out) {
+			out += b ? "true" : "false";
+		}
+	};
+
+	template <>
+	struct bound<std::string> {
+		static void read (bound_context& C, lexer& lex, std::string& s) {
+			detail::expect_token(lex, token::string, "string");
+			detail::token_text(C, lex.current(), s);
+			lex.next();
+		}
+		static bool present (std::string const&) { return true; }
+		static void write (bound_context& C, std::string const& s, std::string& out) {
+			detail::write_text(C, s.data(), s.data()+s.size(), out);
+		}
+	};
+
+	// floating point numbers: printed with as few digits as read back the same
+	template <typename U>
+	struct bound<U, typename boost::enable_if<boost::is_floating_point<U> >::type> {
+		static void read (bound_context&, lexer& lex, U& u) {
+			detail::expect_token(lex, token::number, "number");
+			double d;
+			number_decoder<double>::decode(lex.current().first_, lex.current().last_, d);
+			u = U(d);
+			lex.next();
+		}
+		static bool present (U) { return true; }
+		static void write (bound_context&, U u, std::string& out) {
+			const double d = u;
+			if (d != d or d - d != d - d) { // there is no JSON for NaN or infinity
+				out += "null";
+				return;
+			}
+			char text[32];
+			for (int digits=std::numeric_limits<U>::digits10; digits<=17; ++digits) {
+				std::snprintf(text, sizeof(text), "%.*g", digits, d);
+				if (U(std::strtod(text, 0)) == u)
+					break;
+			}
+			// snprintf follows the C locale, which may not use a `.'
+			for (char *c=text; *c; ++c)
+				if (',' == *c) *c = '.';
+			out += text;
+		}
+	};
+
+	// integers: written as integers (1.0 and 1e3 will do), in range
+	template <typename U>
+	struct bound<U, typename boost::enable_if_c<boost::is_integral<U>::value
+		and not boost::is_same<U,bool>::value>::type> {
+		static void read (bound_context&, lexer& lex, U& u) {
+			detail::expect_token(lex, token::number, "integer");
+			token const& tok = lex.current();
+			const char *c = tok.first_;
+			const bool negative = ('-' == *c);
+			if (negative) ++c;
+			unsigned long long magnitude = 0;
+			bool fits = true;
+			for ( ; c != tok.last_ and '0' <= *c and *c <= '9'; ++c) {
+				fits &= (magnitude <= (std::numeric_limits<unsigned long long>::max() - (*c - '0'))/10);
+				magnitude = 10*magnitude + (*c - '0');
+			}
+			if (c != tok.last_) { // a fraction or an exponent: it had better be whole
+				double d;
+				number_decoder<double>::decode(tok.first_, tok.last_, d);
+				if (d != std::floor(d) or std::fabs(d) >= 18446744073709551616.0)
+					throw expected_got("integer", tok.value());
+				magnitude = (unsigned long long)std::fabs(d);
+				fits = true; // (the digits alone may not have)
+			}
+			const unsigned long long most = std::numeric_limits<U>::max();
+			// the magnitude of min(), as an unsigned (0 if unsigned)
+			const unsigned long long least = std::numeric_limits<U>::is_signed
+				? (unsigned long long)(-(std::numeric_limits<U>::min()+1)) + 1 : 0;
+			if (not fits or (negative ? (0 != magnitude and least < magnitude) : most < magnitude))
+				throw expected_got("integer", tok.value());
+			u = negative ? U(0 - magnitude) : U(magnitude);
+			lex.next();
+		}
+		static bool present (U) { return true; }
+		static void write (bound_context&, U u, std::string& out) {
+			char text[24], *c = text + sizeof(text);
+			const bool negative = (u < U(0));
+			unsigned long long magnitude = negative ? 0 - (unsigned long long)u : (unsigned long long)u;
+			do {
+				*--c = char('0' + magnitude % 10);
+				magnitude /= 10;
+			} while (magnitude);
+			if (negative)
+				*--c = '-';
+			out.append(c, text + sizeof(text));
+		}
+	};
+
+	template <typename U, typename A>
+	struct bound<std::vector<U,A> > {
+		static void read (bound_context& C, lexer& lex, std::vector<U,A>& v) {
+			detail::expect_token(lex, token::brakL, "[");
+			lex.next();
+			v.clear();
+			if (token::brakR != lex.kind()) {
+				while (true) {
+					v.push_back(U());
+					bound<U>::read(C, lex, v.back());
+					if (token::comma != lex.kind())
+						break;
+					lex.next();
+				}
+			}
+			detail::expect_token(lex, token::brakR, "]");
+			lex.next();
+		}
+		static bool present (std::vector<U,A> const&) { return true; }
+		static void write (bound_context& C, std::vector<U,A> const& v, std::string& out) {
+			out += '[';
+			for (std::size_t i=0; i<v.size(); ++i) {
+				if (0 != i)
+					out += ',';
+				bound<U>::write(C, v[i], out);
+			}
+			out += ']';
+		}
+	};
+
+	template <typename U>
+	struct bound<boost::optional<U> > {
+		static void read (bound_context& C, lexer& lex, boost::optional<U>& o) {
+			if (token::null == lex.kind()) {
+				o = boost::none;
+				lex.next();
+				return;
+			}
+			U u = U();
+			bound<U>::read(C, lex, u);
+			o = u;
+		}
+		static bool present (boost::optional<U> const& o) { return o.is_initialized(); }
+		static void write (bound_context& C, boost::optional<U> const& o, std::string& out) {
+			if (o)
+				bound<U>::write(C, *o, out);
+			else
+				out += "null";
+		}
+	};
+
+	// the push_parser of a bound type
+	template <typename T>
+	struct bound_parser {
+		bound_parser (string_form form=folded) : context_(form) {}
+
+		template <typename String>
+		T operator () (String const& text) {
+			T value = T();
+			this->parse(bel::begin(text), bel::end(text), value);
+			return value;
+		}
+		template <typename Iter>
+		T operator () (Iter begin, Iter end) {
+			T value = T();
+			this->parse(begin, end, value);
+			return value;
+		}
+
+		// parse into value (the fields with no key in the input are kept)
+		void parse (const char* begin, const char* end, T& value) {
+			std::string scratch;
+			if (decoded == this->context_.form)
+				utf_8_text(begin, end, scratch);
+			else
+				json_ascii(begin, end, scratch);
+			this->run(begin, end, value);
+		}
+		template <typename Iter>
+		void parse (Iter begin, Iter end, T& value) {
+			std::string lcp;
+			if (decoded == this->context_.form)
+				utf_8_text(begin, end, lcp);
+			else
+				json_ascii(begin, end, lcp);
+			this->run(lcp.data(), lcp.data()+lcp.size(), value);
+		}
+
+	private:
+		void run (const char* begin, const char* end, T& value) {
+			lexer lex(begin, end);
+			bound<T>::read(this->context_, lex, value);
+		}
+
+		bound_context context_;
+	};
+
+	// the text of a bound value, appended to out (no spaces; its strings
+	// in form, like the parser's)
+	template <typename T>
+	void bound_to_string (T const& value, std::string& out, string_form form=folded) {
+		bound_context context(form);
+		bound<T>::write(context, value, out);
+	}
+	template <typename T>
+	std::string bound_to_string (T const& value, string_form form=folded) {
+		std::string out;
+		bound_to_string(value, out, form);
+		return out;
+	}
+
+}
+
+// the json_binding of Type, whose fields (a sequence: (a)(b)(c)) are
+// keyed by their names; use it outside of any namespace
+#define JSONPP_BIND_FIELD(r, Type, name) (BOOST_PP_STRINGIZE(name), &Type::name)
+#define JSONPP_BIND(Type, names) \
+	namespace JSONpp { \
+		template <> struct json_binding<Type> { \
+			template <typename Fields> \
+			static void fields (Fields& f) { \
+				f BOOST_PP_SEQ_FOR_EACH(JSONPP_BIND_FIELD, Type, names); \
+			} \
+		}; \
+	}
+
+#endif//JSONPP_BOUND
@@ -0,0 +1,707 @@
+#include "jsonpp.hpp"
+#include "number.hpp"
+// STL
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <vector>
+// C
+#include <stdint.h>
+
+#ifndef JSONPP_CBOR
+#define JSONPP_CBOR
+
+namespace JSONpp {
+
+	//=== [CBOR] ===
+	// CBOR (RFC 8949), the binary JSON: a value goes straight to bytes and
+	// back, with no text in between.
+	//
+	//    std::string bytes;
+	//    cbor_encode(json, std::back_inserter(bytes));
+	//    json_v again = cbor_decoder<json_v>()(bytes);
+	//
+	// The encoder visits any json_traits type (as the printer does), and
+	// writes to an output iterator as it goes. Numbers go through
+	// cbor_number<number_t>: for a number_t that converts to and from
+	// double, integers (that fit in 64 bits) are written as CBOR integers,
+	// the rest as the shorter of float32 and float64 that holds them
+	// exactly; a json_number keeps its kind, with its int64 and uint64 as
+	// CBOR integers, and its decimals as bignums (tags 2 and 3) or decimal
+	// fractions (tag 4). Strings are UTF-8 text, so folded strings have
+	// their escapes decoded on the way out (say which form they are in, as
+	// for the printer).
+	//
+	// The decoder builds the value in place, as push_parser does, from bytes
+	// in memory; strings are folded (or, if decoded, left as UTF-8) on the
+	// way in, so a folded string comes back meaning the same, but with its
+	// escapes written the way the printer writes them. It takes everything
+	// in CBOR that JSON has an answer for: definite and indefinite lengths,
+	// half floats, `undefined' (as null), bignums and decimal fractions (as
+	// numbers, through number_decoder<number_t>), and other tags (which are
+	// skipped). Byte strings, keys that are not text, and malformed or
+	// truncated items throw an invalid_encoding at the offending byte.
+	namespace detail {
+		// the decimal digits of n
+		inline std::string cbor_digits (uint64_t n) {
+			char text[24], *c = text + sizeof(text);
+			do {
+				*--c = char('0' + n % 10);
+				n /= 10;
+			} while (n);
+			return std::string(c, text + sizeof(text));
+		}
+		// digits + 1
+		inline void cbor_plus_one (std::string& digits) {
+			std::size_t i = digits.size();
+			while (i and '9' == digits[i-1])
+				digits[--i] = '0';
+			if (i)
+				++digits[i-1];
+			else
+				digits.insert(digits.begin(), '1');
+		}
+		// the decimal digits of a big-endian unsigned of any length
+		inline std::string cbor_bytes_to_digits (std::string const& bytes) {
+			std::string digits(1, '0');   // least significant first
+			for (std::size_t b=0; b<bytes.size(); ++b) {
+				unsigned carry = (unsigned char)bytes[b];
+				for (std::size_t d=0; d<digits.size(); ++d) {
+					carry += 256 * unsigned(digits[d] - '0');
+					digits[d] = char('0' + carry % 10);
+					carry /= 10;
+				}
+				for ( ; carry; carry /= 10)
+					digits += char('0' + carry % 10);
+			}
+			while (1 < digits.size() and '0' == digits[digits.size()-1])
+				digits.erase(digits.size()-1);
+			return std::string(digits.rbegin(), digits.rend());
+		}
+		// the big-endian bytes (as few as will do) of decimal digits
+		inline std::string cbor_digits_to_bytes (std::string digits) {
+			std::string bytes;
+			while (not (1 == digits.size() and '0' == digits[0])) {
+				unsigned rest = 0;
+				for (std::size_t d=0; d<digits.size(); ++d) {
+					rest = 10*rest + unsigned(digits[d] - '0');
+					digits[d] = char('0' + rest / 256);
+					rest %= 256;
+				}
+				bytes += char(rest);
+				const std::size_t nonzero = digits.find_first_not_of('0');
+				digits.erase(0, (std::string::npos == nonzero) ? digits.size()-1 : nonzero);
+			}
+			return std::string(bytes.rbegin(), bytes.rend());
+		}
+		// digits, if they fit in 64 bits
+		inline bool cbor_fits (std::string const& digits, uint64_t& n) {
+			n = 0;
+			for (std::size_t d=0; d<digits.size(); ++d) {
+				const unsigned digit = digits[d] - '0';
+				if (n > (~uint64_t(0) - digit) / 10)
+					return false;
+				n = 10*n + digit;
+			}
+			return true;
+		}
+	}
+
+	// How a number_t goes to CBOR (write) and comes back from it (integer,
+	// negative, real). This one is for any number_t that converts to and
+	// from double.
+	template <typename Number>
+	struct cbor_number {
+		template <typename Writer>
+		static void write (Writer& w, Number const& N) {
+			const double d = double(N);
+			if (std::floor(d) == d and -9223372036854775808.0 <= d and d < 9223372036854775808.0
+					and not (0 == d and 1/d < 0)) {   // -0 stays a float
+				const int64_t i = int64_t(d);
+				if (0 <= i)
+					w.head(0, uint64_t(i));
+				else
+					w.head(1, uint64_t(-1 - i));
+				return;
+			}
+			const float f = float(d);
+			if (double(f) == d or d != d) {
+				uint32_t bits;
+				std::memcpy(&bits, &f, sizeof(bits));
+				w.byte(0xFA);
+				w.big_endian(bits, 4);
+			} else {
+				uint64_t bits;
+				std::memcpy(&bits, &d, sizeof(bits));
+				w.byte(0xFB);
+				w.big_endian(bits, 8);
+			}
+		}
+		// major type 0: n
+		static Number integer (uint64_t n) { return Number(double(n)); }
+		// major type 1: -1-n
+		static Number negative (uint64_t n) { return Number(-1.0 - double(n)); }
+		// a float
+		static Number real (double d) { return Number(d); }
+	};
+
+	// json_number keeps its kind: 64-bit integers are exact both ways, and
+	// a decimal is written as a bignum (if it is an integer) or a decimal
+	// fraction, whose mantissa is a bignum if it has to be
+	template <>
+	struct cbor_number<json_number> {
+		template <typename Writer>
+		static void write (Writer& w, json_number const& N) {
+			switch (N.which()) {
+			case json_number::int64: {
+				const long long i = N.as_int64();
+				if (0 <= i)
+					w.head(0, uint64_t(i));
+				else
+					w.head(1, uint64_t(-1 - i));
+			} break;
+			case json_number::uint64:
+				w.head(0, N.as_uint64());
+				break;
+			case json_number::real:
+				cbor_number<double>::write(w, N.as_double());
+				break;
+			default:
+				decimal(w, N.text());
+				break;
+			}
+		}
+		static json_number integer (uint64_t n) {
+			if (n <= uint64_t(std::numeric_limits<long long>::max()))
+				return json_number((long long)n);
+			return json_number((unsigned long long)n);
+		}
+		static json_number negative (uint64_t n) {
+			if (n <= uint64_t(std::numeric_limits<long long>::max()))
+				return json_number(-1 - (long long)n);
+			std::string text = detail::cbor_digits(n);
+			detail::cbor_plus_one(text);
+			text.insert(text.begin(), '-');
+			return json_number::from_text(text.data(), text.data()+text.size());
+		}
+		static json_number real (double d) { return json_number(d); }
+
+	private:
+		// the text of a JSON number, as a bignum or [exponent, mantissa]; an
+		// exponent too big for 64 bits is left as text
+		template <typename Writer>
+		static void decimal (Writer& w, std::string const& text) {
+			const char *c = text.data(), *last = c + text.size();
+			const bool negative = ('-' == *c);
+			if (negative) ++c;
+			std::string digits;
+			long long exponent = 0;
+			for ( ; c != last and '0' <= *c and *c <= '9'; ++c)
+				digits += *c;
+			if (c != last and '.' == *c)
+				for (++c; c != last and '0' <= *c and *c <= '9'; ++c, --exponent)
+					digits += *c;
+			if (c != last) { // the exponent
+				++c;
+				bool negexp = false;
+				if (c != last and ('-' == *c or '+' == *c))
+					negexp = ('-' == *(c++));
+				long long e = 0;
+				for ( ; c != last; ++c) {
+					if (e > 100000000000000000LL) {
+						w.text(text);
+						return;
+					}
+					e = 10*e + (*c - '0');
+				}
+				exponent += negexp ? -e : e;
+			}
+			const std::size_t nonzero = digits.find_first_not_of('0');
+			digits.erase(0, (std::string::npos == nonzero) ? digits.size()-1 : nonzero);
+			if (0 != exponent) {
+				w.head(6, 4);
+				w.head(4, 2);
+				if (0 <= exponent)
+					w.head(0, uint64_t(exponent));
+				else
+					w.head(1, uint64_t(-1 - exponent));
+			}
+			uint64_t n;
+			if (detail::cbor_fits(digits, n)) {
+				if (negative and 0 != n)
+					w.head(1, n - 1);
+				else
+					w.head(0, n);
+				return;
+			}
+			// -1-n for a negative bignum
+			std::string bytes = detail::cbor_digits_to_bytes(digits);
+			if (negative) {
+				std::size_t i = bytes.size();
+				while ('\0' == bytes[--i])
+					bytes[i] = '\xFF';
+				bytes[i] = char((unsigned char)bytes[i] - 1);
+				if ('\0' == bytes[0])
+					bytes.erase(0, 1);
+			}
+			w.head(6, negative ? 3 : 2);
+			w.head(2, bytes.size());
+			for (std::size_t b=0; b<bytes.size(); ++b)
+				w.byte((unsigned char)bytes[b]);
+		}
+	};
+
+	template <typename JSONType, typename Out>
+	struct cbor_writer : boost::static_visitor<void> {
+		typedef json_traits<JSONType> traits;
+		typedef typename traits::string_t     string_t;
+		typedef typename traits::number_t     number_t;
+		typedef typename traits::object_t     object_t;
+		typedef typename traits::array_t      array_t;
+		typedef typename traits::bool_t       bool_t;
+		typedef typename traits::null_t       null_t;
+
+		cbor_writer (Out out, string_form form) : out(out), form(form) {}
+
+		void operator () (number_t const& N) {
+			cbor_number<number_t>::write(*this, N);
+		}
+		void operator () (string_t const& S) {
+			this->text(S);
+		}
+		void operator () (bool_t const& B) {
+			this->byte(B ? 0xF5 : 0xF4);
+		}
+		void operator () (null_t const&) {
+			this->byte(0xF6);
+		}
+		void operator () (array_t const& A) {
+			const std::size_t n = A.size();
+			this->head(4, n);
+			for (std::size_t i=0; i<n; ++i)
+				boost::apply_visitor(*this, A[i]);
+		}
+		void operator () (object_t const& O) {
+			this->head(5, O.size());
+			for (typename object_t::const_iterator at=O.begin(); at!=O.end(); ++at) {
+				this->text(at->first);
+				boost::apply_visitor(*this, at->second);
+			}
+		}
+
+		// an item's major type and argument
+		void head (unsigned major, uint64_t n) {
+			major <<= 5;
+			if (n < 24)
+				this->byte(major | unsigned(n));
+			else if (n <= 0xFF) {
+				this->byte(major | 24);
+				this->big_endian(n, 1);
+			} else if (n <= 0xFFFF) {
+				this->byte(major | 25);
+				this->big_endian(n, 2);
+			} else if (n <= 0xFFFFFFFFu) {
+				this->byte(major | 26);
+				this->big_endian(n, 4);
+			} else {
+				this->byte(major | 27);
+				this->big_endian(n, 8);
+			}
+		}
+		void byte (unsigned b) {
+			*this->out = char(b);
+			++this->out;
+		}
+		void big_endian (uint64_t n, unsigned bytes) {
+			while (bytes--)
+				this->byte(unsigned(n >> (8*bytes)) & 0xFF);
+		}
+		void text (const char* first, const char* last) {
+			if (folded == this->form and std::memchr(first, '\\', last - first)) {
+				this->scratch.clear();
+				json_unescape(first, last, this->scratch);
+				first = this->scratch.data();
+				last = first + this->scratch.size();
+			}
+			this->head(3, last - first);
+			this->out = std::copy(first, last, this->out);
+		}
+		void text (std::string const& S) {
+			this->text(S.data(), S.data()+S.size());
+		}
+		// other strings are copied only when they have escapes to undo
+		template <typename String>
+		void text (String const& S) {
+			if (folded == this->form and bel::end(S) != std::find(bel::begin(S), bel::end(S), '\\')) {
+				const std::string bytes(bel::begin(S), bel::end(S));
+				this->text(bytes);
+				return;
+			}
+			this->head(3, std::distance(bel::begin(S), bel::end(S)));
+			this->out = std::copy(bel::begin(S), bel::end(S), this->out);
+		}
+
+		Out out;
+		string_form form;
+		std::string scratch;   // an unescaped string
+	};
+
+	// the CBOR of v, to out; the iterator after the last byte is returned
+	template <typename JSONType, typename Out>
+	Out cbor_encode (JSONType const& v, Out out, string_form form=folded) {
+		cbor_writer<JSONType,Out> writer(out, form);
+		boost::apply_visitor(writer, v);
+		return writer.out;
+	}
+
+	template <typename JSONType>
+	class cbor_decoder {
+	public:
+		typedef json_traits<JSONType> traits;
+		typedef typename traits::value_t      value_t;
+		typedef typename traits::string_t     string_t;
+		typedef typename traits::number_t     number_t;
+		typedef typename traits::object_t     object_t;
+		typedef typename traits::array_t      array_t;
+		typedef typename traits::bool_t       bool_t;
+		typedef typename traits::null_t       null_t;
+		typedef typename object_key<object_t,string_t>::type key_t;
+
+		cbor_decoder (string_form form=folded) : form_(form), origin_(0), first_(0), last_(0) {}
+
+		// the one item that is all of [first, last)
+		value_t operator () (const char* first, const char* last) {
+			value_t val;
+			if (last != this->decode(first, last, val))
+				this->fail();
+			return val;
+		}
+		value_t operator () (std::string const& bytes) {
+			return (*this)(bytes.data(), bytes.data()+bytes.size());
+		}
+
+		// the first item of [first, last) into val; where it ends is returned
+		// (so a CBOR sequence is decoded one call after another)
+		const char* decode (const char* first, const char* last, value_t& val) {
+			this->origin_ = this->first_ = first;
+			this->last_ = last;
+			this->item(val);
+			return this->first_;
+		}
+
+	private:
+		enum { indefinite = 31 };
+
+		void fail () const {
+			throw invalid_encoding("CBOR", this->first_ - this->origin_);
+		}
+		unsigned byte () {
+			if (this->first_ == this->last_)
+				this->fail();
+			return (unsigned char)*this->first_++;
+		}
+		uint64_t big_endian (unsigned bytes) {
+			if (std::size_t(this->last_ - this->first_) < bytes)
+				this->fail();
+			uint64_t n = 0;
+			while (bytes--)
+				n = (n << 8) | (unsigned char)*this->first_++;
+			return n;
+		}
+		// the argument of an item whose low five bits are `info'
+		uint64_t argument (unsigned info) {
+			if (info < 24)
+				return info;
+			switch (info) {
+			case 24: return this->big_endian(1);
+			case 25: return this->big_endian(2);
+			case 26: return this->big_endian(4);
+			case 27: return this->big_endian(8);
+			default: --this->first_; this->fail(); return 0;
+			}
+		}
+		// a definite count of items, which cannot be more than there are
+		// bytes left
+		std::size_t count (unsigned info) {
+			const uint64_t n = this->argument(info);
+			if (n > uint64_t(this->last_ - this->first_))
+				this->fail();
+			return std::size_t(n);
+		}
+		bool at_break () {
+			if (this->first_ == this->last_)
+				this->fail();
+			if (0xFF != (unsigned char)*this->first_)
+				return false;
+			++this->first_;
+			return true;
+		}
+
+		// the bytes of a text string, folded (or checked) for string_t
+		template <typename String>
+		void text (unsigned info, String& str) {
+			if (indefinite == info) {
+				std::string chunks;
+				while (not this->at_break()) {
+					const unsigned b = this->byte();
+					if (3 != (b >> 5) or indefinite == (b & 31)) {
+						--this->first_;
+						this->fail();
+					}
+					const std::size_t n = this->count(b & 31);
+					chunks.append(this->first_, this->first_ + n);
+					this->first_ += n;
+				}
+				// (a mistake in the UTF-8 is reported at its offset in the text)
+				this->made(chunks.data(), chunks.data()+chunks.size(), chunks.data(), str);
+				return;
+			}
+			const std::size_t n = this->count(info);
+			const char *first = this->first_;
+			this->first_ += n;
+			this->made(first, first+n, this->origin_, str);
+		}
+		template <typename String>
+		void made (const char* first, const char* last, const char* origin, String& str) {
+			if (json_plain_span(first, last, true) == last) {
+				str = String(first, last);
+				return;
+			}
+			null_sink check;
+			utf_8_decode(first, last, check, origin);
+			if (decoded == this->form_) {
+				str = String(first, last);
+				return;
+			}
+			this->scratch_.clear();
+			json_escape(first, last, true, this->scratch_);
+			str = String(this->scratch_.begin(), this->scratch_.end());
+		}
+
+		void item (value_t& val) {
+			const unsigned b = this->byte();
+			const unsigned info = b & 31;
+			switch (b >> 5) {
+			case 0: {
+				number_t number = cbor_number<number_t>::integer(this->argument(info));
+				val = number;
+			} break;
+			case 1: {
+				number_t number = cbor_number<number_t>::negative(this->argument(info));
+				val = number;
+			} break;
+			case 3: {
+				string_t string;
+				this->text(info, string);
+				val = JSONPP_MOVE(string);
+			} break;
+			case 4: {
+				array_t array;
+				if (indefinite == info) {
+					value_t element;
+					while (not this->at_break()) {
+						this->item(element);
+						array.push_back(JSONPP_MOVE(element));
+					}
+				} else {
+					const std::size_t n = this->count(info);
+					reserve(array, n);
+					value_t element;
+					for (std::size_t i=0; i<n; ++i) {
+						this->item(element);
+						array.push_back(JSONPP_MOVE(element));
+					}
+				}
+				val = JSONPP_MOVE(array);
+			} break;
+			case 5: {
+				object_t object;
+				if (indefinite == info)
+					while (not this->at_break())
+						this->member(object);
+				else
+					for (std::size_t n = this->count(info); n; --n)
+						this->member(object);
+				val = JSONPP_MOVE(object);
+			} break;
+			case 6: { // a tag: what it says about the item is dropped, but for
+			          // the numbers
+				const uint64_t tag = this->argument(info);
+				if (2 <= tag and tag <= 4)
+					this->number(tag, val);
+				else
+					this->item(val);
+			} break;
+			case 7:
+				this->simple(info, val);
+				break;
+			default: // a byte string
+				--this->first_;
+				this->fail();
+			}
+		}
+		// a bignum (tags 2 and 3) or a decimal fraction (tag 4), which is
+		// [exponent, mantissa]: made into text for number_decoder
+		void number (uint64_t tag, value_t& val) {
+			std::string text;
+			if (4 == tag) {
+				if (0x82 != this->byte()) {
+					--this->first_;
+					this->fail();
+				}
+				const unsigned b = this->byte();
+				if (1 < (b >> 5)) {
+					--this->first_;
+					this->fail();
+				}
+				std::string exponent = detail::cbor_digits(this->argument(b & 31));
+				if (1 == (b >> 5)) {
+					detail::cbor_plus_one(exponent);
+					exponent.insert(exponent.begin(), '-');
+				}
+				this->integer(this->byte(), text);
+				// the point goes among the digits, or just before them after
+				// a few zeros, if it can (as it was written, most likely);
+				// otherwise there is an exponent
+				const std::size_t sign = ('-' == text[0]), digits = text.size() - sign;
+				const uint64_t point = ('-' == exponent[0] and exponent.size() <= 20)
+					? std::strtoull(exponent.c_str()+1, 0, 10) : 0;
+				if (0 != point and point < digits)
+					text.insert(text.size() - std::size_t(point), 1, '.');
+				else if (0 != point and point <= digits + 6)
+					text.insert(sign, "0." + std::string(std::size_t(point) - digits, '0'));
+				else
+					text += 'e' + exponent;
+			} else
+				this->bignum(tag, text);
+			number_t number;
+			number_decoder<number_t>::decode(text.data(), text.data()+text.size(), number);
+			val = number;
+		}
+		// the digits of an integer or a bignum, with their sign
+		void integer (unsigned b, std::string& text) {
+			switch (b >> 5) {
+			case 0: text = detail::cbor_digits(this->argument(b & 31)); break;
+			case 1:
+				text = detail::cbor_digits(this->argument(b & 31));
+				detail::cbor_plus_one(text);
+				text.insert(text.begin(), '-');
+				break;
+			case 6: {
+				const char *at = this->first_ - 1;
+				const uint64_t tag = this->argument(b & 31);
+				if (2 != tag and 3 != tag) {
+					this->first_ = at;
+					this->fail();
+				}
+				this->bignum(tag, text);
+			} break;
+			default:
+				--this->first_;
+				this->fail();
+			}
+		}
+		void bignum (uint64_t tag, std::string& text) {
+			const unsigned b = this->byte();
+			if (2 != (b >> 5)) {
+				--this->first_;
+				this->fail();
+			}
+			std::string bytes;
+			if (indefinite == (b & 31)) {
+				while (not this->at_break()) {
+					const unsigned chunk = this->byte();
+					if (2 != (chunk >> 5) or indefinite == (chunk & 31)) {
+						--this->first_;
+						this->fail();
+					}
+					const std::size_t n = this->count(chunk & 31);
+					bytes.append(this->first_, this->first_ + n);
+					this->first_ += n;
+				}
+			} else {
+				const std::size_t n = this->count(b & 31);
+				bytes.assign(this->first_, this->first_ + n);
+				this->first_ += n;
+			}
+			text = detail::cbor_bytes_to_digits(bytes);
+			if (3 == tag) {
+				detail::cbor_plus_one(text);
+				text.insert(text.begin(), '-');
+			}
+		}
+		void member (object_t& object) {
+			const unsigned b = this->byte();
+			if (3 != (b >> 5)) {
+				--this->first_;
+				this->fail();
+			}
+			key_t key;
+			this->text(b & 31, key);
+			this->item(object[key]);
+		}
+		void simple (unsigned info, value_t& val) {
+			switch (info) {
+			case 20: case 21: {
+				bool_t boolean;
+				boolean = (21 == info);
+				val = boolean;
+			} break;
+			case 22: case 23: {
+				null_t null;
+				val = null;
+			} break;
+			case 25: {
+				const unsigned half = unsigned(this->big_endian(2));
+				const int exponent = (half >> 10) & 0x1F;
+				const double mantissa = half & 0x3FF;
+				double d;
+				if (0 == exponent)
+					d = std::ldexp(mantissa, -24);
+				else if (31 == exponent)
+					d = mantissa ? std::numeric_limits<double>::quiet_NaN()
+						: std::numeric_limits<double>::infinity();
+				else
+					d = std::ldexp(mantissa + 1024, exponent - 25);
+				number_t number = cbor_number<number_t>::real((half & 0x8000) ? -d : d);
+				val = number;
+			} break;
+			case 26: {
+				const uint32_t bits = uint32_t(this->big_endian(4));
+				float f;
+				std::memcpy(&f, &bits, sizeof(f));
+				number_t number = cbor_number<number_t>::real(double(f));
+				val = number;
+			} break;
+			case 27: {
+				const uint64_t bits = this->big_endian(8);
+				double d;
+				std::memcpy(&d, &bits, sizeof(d));
+				number_t number = cbor_number<number_t>::real(d);
+				val = number;
+			} break;
+			default: // other simple values, and a break out of place
+				--this->first_;
+				this->fail();
+			}
+		}
+
+		// a vector is given its size first, so that it does not copy the
+		// elements as it grows
+		template <typename T, typename A>
+		static void reserve (std::vector<T,A>& array, std::size_t n) { array.reserve(n); }
+		template <typename Array>
+		static void reserve (Array&, std::size_t) {}
+
+		string_form form_;
+		const char *origin_, *first_, *last_;
+		std::string scratch_;   // a folded string, on its way into string_t
+	};
+
+}
+
+#endif//JSONPP_CBOR
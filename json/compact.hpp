@@ -0,0 +1,297 @@
+#include "jsonpp.hpp"
+#include "flat_map.hpp"
+// STL
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+// C
+#include <stdint.h>
+
+#ifndef JSONPP_COMPACT
+#define JSONPP_COMPACT
+
+namespace JSONpp {
+
+	//=== [COMPACT VALUE] ===
+	// A JSON value in 16 bytes: one NaN-boxed word, and one more for the
+	// first characters of a short string.
+	//
+	// The word is a double, unless its top 13 bits are all set (a negative
+	// quiet NaN, which no number is stored as: every NaN is kept as the one
+	// positive quiet NaN). Then the next 3 bits say what it is instead, and
+	// the low 48 bits carry it:
+	//    null, false/true         nothing, or 0/1
+	//    a string of <= 13 bytes  the last 5 characters and the length (the
+	//                             first 8 are in the second word)
+	//    a longer string          a std::string* on the heap
+	//    an object, an array      a pointer to the container on the heap
+	// (so it takes pointers of 48 bits, as on x86-64 and AArch64).
+	//
+	// It has the typedefs json_traits wants, so json_traits<compact_value>
+	// needs no specialization, and apply_visitor, so the printer visits it
+	// like a variant. Objects are flat_maps, and a compact_value moves, so
+	// neither the vector of an array nor a flat_map copies when it grows.
+	class compact_value {
+	public:
+		typedef compact_value                         value_t;
+		typedef std::string                           string_t;
+		typedef double                                number_t;
+		typedef flat_map<std::string,compact_value>   object_t;
+		typedef std::vector<compact_value>            array_t;
+		typedef bool                                  bool_t;
+		typedef nil                                   null_t;
+
+		enum kind_t {
+			number_kind,
+			null_kind,
+			boolean_kind,
+			string_kind,
+			object_kind,
+			array_kind,
+		};
+
+		static const std::size_t inline_length = 13;
+
+		compact_value () : box_(tag(null_tag, 0)), more_(0) {}
+		compact_value (double n) : box_(0), more_(0) { this->set(n); }
+		compact_value (bool b) : box_(tag(boolean_tag, b ? 1 : 0)), more_(0) {}
+		compact_value (nil) : box_(tag(null_tag, 0)), more_(0) {}
+		compact_value (std::string const& s) : box_(tag(null_tag, 0)), more_(0) { this->set(s.data(), s.size()); }
+		compact_value (const char* s) : box_(tag(null_tag, 0)), more_(0) { this->set(s, std::strlen(s)); }
+		compact_value (object_t const& o) : box_(tag(object_tag, address(new object_t(o)))), more_(0) {}
+		compact_value (array_t const& a) : box_(tag(array_tag, address(new array_t(a)))), more_(0) {}
+		compact_value (compact_value const& other) : box_(other.box_), more_(other.more_) {
+			switch (other.tag_of()) {
+			case long_tag:   this->box_ = tag(long_tag, address(new std::string(other.long_string()))); break;
+			case object_tag: this->box_ = tag(object_tag, address(new object_t(other.object()))); break;
+			case array_tag:  this->box_ = tag(array_tag, address(new array_t(other.array()))); break;
+			default: break;
+			}
+		}
+		~compact_value () { this->release(); }
+
+		compact_value& operator = (compact_value const& rhs) {
+			compact_value copy(rhs);
+			this->swap(copy);
+			return *this;
+		}
+		compact_value& operator = (double n) { this->release(); this->set(n); return *this; }
+		compact_value& operator = (bool b) { this->release(); this->box_ = tag(boolean_tag, b ? 1 : 0); return *this; }
+		compact_value& operator = (nil) { this->release(); this->box_ = tag(null_tag, 0); return *this; }
+		compact_value& operator = (std::string const& s) {
+			compact_value copy(s);
+			this->swap(copy);
+			return *this;
+		}
+		compact_value& operator = (object_t const& o) {
+			compact_value copy(o);
+			this->swap(copy);
+			return *this;
+		}
+		compact_value& operator = (array_t const& a) {
+			compact_value copy(a);
+			this->swap(copy);
+			return *this;
+		}
+#if __cplusplus >= 201103L
+		compact_value (compact_value&& other) noexcept : box_(other.box_), more_(other.more_) {
+			other.box_ = tag(null_tag, 0);
+		}
+		compact_value& operator = (compact_value&& rhs) noexcept {
+			this->swap(rhs);
+			return *this;
+		}
+		compact_value& operator = (object_t&& o) {
+			compact_value box(tag(object_tag, address(new object_t(std::move(o)))));
+			this->swap(box);
+			return *this;
+		}
+		compact_value& operator = (array_t&& a) {
+			compact_value box(tag(array_tag, address(new array_t(std::move(a)))));
+			this->swap(box);
+			return *this;
+		}
+#endif
+
+		void swap (compact_value& other) {
+			std::swap(this->box_, other.box_);
+			std::swap(this->more_, other.more_);
+		}
+
+		kind_t kind () const {
+			switch (this->tag_of()) {
+			case number_tag:  return number_kind;
+			case boolean_tag: return boolean_kind;
+			case short_tag: case long_tag: return string_kind;
+			case object_tag:  return object_kind;
+			case array_tag:   return array_kind;
+			default:          return null_kind;
+			}
+		}
+		static const char* name (kind_t k) {
+			static const char* names[] = { "number", "null", "boolean", "string", "object", "array" };
+			return names[k];
+		}
+
+		double number () const {
+			this->expect(number_kind);
+			double n;
+			std::memcpy(&n, &this->box_, sizeof(n));
+			return n;
+		}
+		bool boolean () const {
+			this->expect(boolean_kind);
+			return 0 != payload_of(this->box_);
+		}
+		bool is_null () const { return null_tag == this->tag_of(); }
+		std::size_t length () const {
+			this->expect(string_kind);
+			if (long_tag == this->tag_of())
+				return this->long_string().size();
+			return std::size_t(payload_of(this->box_) >> 40);
+		}
+		std::string str () const {
+			this->expect(string_kind);
+			if (long_tag == this->tag_of())
+				return this->long_string();
+			char text[inline_length];
+			this->unpack(text);
+			return std::string(text, text + this->length());
+		}
+		object_t& object () { this->expect(object_kind); return *static_cast<object_t*>(this->pointer()); }
+		object_t const& object () const { this->expect(object_kind); return *static_cast<object_t*>(this->pointer()); }
+		array_t& array () { this->expect(array_kind); return *static_cast<array_t*>(this->pointer()); }
+		array_t const& array () const { this->expect(array_kind); return *static_cast<array_t*>(this->pointer()); }
+
+		// so that boost::apply_visitor (and so json_to_string) can visit it
+		// like a variant of its typedefs
+		template <typename Visitor>
+		typename Visitor::result_type apply_visitor (Visitor& visitor) const {
+			switch (this->kind()) {
+			case number_kind: {
+				const double n = this->number();
+				return visitor(n);
+			}
+			case boolean_kind: {
+				const bool b = this->boolean();
+				return visitor(b);
+			}
+			case string_kind: {
+				const std::string text = this->str();
+				return visitor(text);
+			}
+			case object_kind:
+				return visitor(this->object());
+			case array_kind:
+				return visitor(this->array());
+			default: {
+				const nil null = nil();
+				return visitor(null);
+			}
+			}
+		}
+
+		friend bool operator == (compact_value const& L, compact_value const& R) {
+			if (L.kind() != R.kind())
+				return false;
+			switch (L.kind()) {
+			case number_kind: return L.number() == R.number();
+			case string_kind: return L.length() == R.length() and L.str() == R.str();
+			case object_kind: return L.object() == R.object();
+			case array_kind:  return L.array() == R.array();
+			default:          return L.box_ == R.box_;
+			}
+		}
+		friend bool operator != (compact_value const& L, compact_value const& R) {
+			return not (L == R);
+		}
+
+	private:
+		enum tag_t {
+			number_tag,
+			null_tag,
+			boolean_tag,
+			short_tag,
+			long_tag,
+			object_tag,
+			array_tag,
+		};
+
+		static const uint64_t boxed = 0xFFF8000000000000ull;    // the top 13 bits
+		static const uint64_t payload_mask = 0x0000FFFFFFFFFFFFull;
+
+		explicit compact_value (uint64_t box) : box_(box), more_(0) {}
+
+		static uint64_t tag (tag_t t, uint64_t payload) {
+			return boxed | (uint64_t(t) << 48) | payload;
+		}
+		static uint64_t payload_of (uint64_t box) { return box & payload_mask; }
+		static uint64_t address (void* p) { return uint64_t(reinterpret_cast<uintptr_t>(p)); }
+
+		tag_t tag_of () const {
+			if (boxed != (this->box_ & boxed))
+				return number_tag;
+			return tag_t((this->box_ >> 48) & 7);
+		}
+		void* pointer () const {
+			return reinterpret_cast<void*>(uintptr_t(payload_of(this->box_)));
+		}
+		std::string const& long_string () const {
+			return *static_cast<std::string*>(this->pointer());
+		}
+		void expect (kind_t k) const {
+			if (k != this->kind())
+				throw expected_got(name(k), name(this->kind()));
+		}
+
+		void set (double n) {
+			if (n != n)
+				n = std::numeric_limits<double>::quiet_NaN();
+			std::memcpy(&this->box_, &n, sizeof(n));
+			if (boxed == (this->box_ & boxed))   // a NaN with its sign set
+				this->box_ = 0x7FF8000000000000ull;
+		}
+		void set (const char* text, std::size_t length) {
+			if (inline_length < length) {
+				this->box_ = tag(long_tag, address(new std::string(text, length)));
+				return;
+			}
+			char padded[inline_length] = {};
+			std::memcpy(padded, text, length);
+			std::memcpy(&this->more_, padded, sizeof(this->more_));
+			uint64_t rest = 0;
+			for (std::size_t i=sizeof(this->more_); i<inline_length; ++i)
+				rest |= uint64_t((unsigned char)padded[i]) << (8*(i-sizeof(this->more_)));
+			this->box_ = tag(short_tag, (uint64_t(length) << 40) | rest);
+		}
+		void unpack (char* text) const {
+			std::memcpy(text, &this->more_, sizeof(this->more_));
+			const uint64_t rest = payload_of(this->box_);
+			for (std::size_t i=sizeof(this->more_); i<inline_length; ++i)
+				text[i] = char((rest >> (8*(i-sizeof(this->more_)))) & 0xFF);
+		}
+		void release () {
+			switch (this->tag_of()) {
+			case long_tag:   delete static_cast<std::string*>(this->pointer()); break;
+			case object_tag: delete static_cast<object_t*>(this->pointer()); break;
+			case array_tag:  delete static_cast<array_t*>(this->pointer()); break;
+			default: break;
+			}
+			this->box_ = tag(null_tag, 0);
+		}
+
+		uint64_t box_;
+		uint64_t more_;   // the first characters of a short string
+	};
+
+	const std::size_t compact_value::inline_length;
+
+	inline void swap (compact_value& L, compact_value& R) {
+		L.swap(R);
+	}
+
+}
+
+#endif//JSONPP_COMPACT
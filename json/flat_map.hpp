@@ -0,0 +1,249 @@
+#include "jsonpp.hpp"
+// STL
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+// C
+#include <stdint.h>
+
+#ifndef JSONPP_FLAT_MAP
+#define JSONPP_FLAT_MAP
+
+namespace JSONpp {
+
+	// FNV-1a, over a run of characters
+	template <typename Iter>
+	std::size_t fnv_1a (Iter first, Iter last) {
+		uint64_t h = 14695981039346656037ull;
+		for (; first!=last; ++first)
+			h = (h ^ (unsigned long)*first) * 1099511628211ull;
+		return std::size_t(h ^ (h >> 32));
+	}
+	// the hash of an object key; a key type that knows its hash can overload
+	// this (it is found by argument dependent lookup)
+	template <typename Key>
+	std::size_t json_key_hash (Key const& key) {
+		return fnv_1a(key.begin(), key.end());
+	}
+
+	//=== [FLAT MAP] ===
+	// The members of an object in one vector, in the order they were
+	// inserted (for a parsed object: document order), instead of a node per
+	// member. Small objects, the usual case, are searched front to back; an
+	// object with more than linear_limit members also gets an open-addressed
+	// hash index (positions into the vector), so lookups stay O(1).
+	//
+	// It has the part of std::map's interface the library uses (O[K] = V,
+	// find, count, erase, size, begin/end); the iterators are those of the
+	// vector, and value_type is a (non-const) pair.
+	template <typename Key, typename Value,
+						typename Allocator=std::allocator<std::pair<Key,Value> > >
+	class flat_map {
+	public:
+		typedef Key                                       key_type;
+		typedef Value                                     mapped_type;
+		typedef std::pair<Key,Value>                      value_type;
+		typedef typename rebind_allocator<Allocator,value_type>::type allocator_type;
+		typedef std::vector<value_type,allocator_type>    entries_t;
+		typedef typename entries_t::iterator              iterator;
+		typedef typename entries_t::const_iterator        const_iterator;
+		typedef typename entries_t::size_type             size_type;
+
+		static const std::size_t linear_limit = 16;
+
+		flat_map () {}
+		explicit flat_map (allocator_type const& a) : entries_(a), index_(a) {}
+
+		allocator_type get_allocator () const { return this->entries_.get_allocator(); }
+
+		iterator begin () { return this->entries_.begin(); }
+		iterator end () { return this->entries_.end(); }
+		const_iterator begin () const { return this->entries_.begin(); }
+		const_iterator end () const { return this->entries_.end(); }
+		size_type size () const { return this->entries_.size(); }
+		bool empty () const { return this->entries_.empty(); }
+
+		iterator find (Key const& key) {
+			return this->begin() + this->position(key);
+		}
+		const_iterator find (Key const& key) const {
+			return this->begin() + this->position(key);
+		}
+		size_type count (Key const& key) const {
+			return (this->position(key) != this->size()) ? 1 : 0;
+		}
+
+		// the value of key, default-constructed (at the end) if it is new
+		Value& operator [] (Key const& key) {
+			const std::size_t at = this->position(key);
+			if (at != this->size())
+				return this->entries_[at].second;
+			this->grow();
+			this->entries_.push_back(value_type(key, Value()));
+			this->add(this->size()-1);
+			return this->entries_.back().second;
+		}
+
+		size_type erase (Key const& key) {
+			const std::size_t at = this->position(key);
+			if (at == this->size())
+				return 0;
+			this->entries_.erase(this->begin() + at);
+			this->rebuild();
+			return 1;
+		}
+		void clear () {
+			this->entries_.clear();
+			this->index_.clear();
+		}
+		void swap (flat_map& other) {
+			this->entries_.swap(other.entries_);
+			this->index_.swap(other.index_);
+		}
+
+		// the members it has room for, and the bytes of its hash index
+		size_type capacity () const { return this->entries_.capacity(); }
+		std::size_t index_memory () const { return this->index_.capacity() * sizeof(uint32_t); }
+		// give back the room the members and the index do not use
+		void shrink_to_fit () {
+			if (this->entries_.size() < this->entries_.capacity())
+				this->reallocate(this->entries_.size());
+			if (this->index_.size() < this->index_.capacity())
+				index_t(this->index_).swap(this->index_);
+		}
+
+		// the same members with the same values, in any order
+		friend bool operator == (flat_map const& L, flat_map const& R) {
+			if (L.size() != R.size())
+				return false;
+			for (const_iterator at=L.begin(); at!=L.end(); ++at) {
+				const_iterator there = R.find(at->first);
+				if (there == R.end() or not (there->second == at->second))
+					return false;
+			}
+			return true;
+		}
+		friend bool operator != (flat_map const& L, flat_map const& R) {
+			return not (L == R);
+		}
+
+	private:
+		typedef typename rebind_allocator<Allocator,uint32_t>::type index_allocator;
+		typedef std::vector<uint32_t,index_allocator> index_t;
+
+		static std::size_t hash (Key const& key) {
+			return json_key_hash(key);
+		}
+
+		// where key is, or size()
+		std::size_t position (Key const& key) const {
+			const std::size_t n = this->entries_.size();
+			if (this->index_.empty()) {
+				for (std::size_t at=0; at<n; ++at)
+					if (this->entries_[at].first == key)
+						return at;
+				return n;
+			}
+			const std::size_t mask = this->index_.size() - 1;
+			for (std::size_t slot = hash(key) & mask; this->index_[slot]; slot = (slot+1) & mask)
+				if (this->entries_[this->index_[slot]-1].first == key)
+					return this->index_[slot]-1;
+			return n;
+		}
+
+		// index the entry at `at', when there are enough to need it
+		void add (std::size_t at) {
+			const std::size_t n = this->entries_.size();
+			if (n <= linear_limit)
+				return;
+			if (this->index_.size() < 2*n) {
+				this->rebuild();
+				return;
+			}
+			const std::size_t mask = this->index_.size() - 1;
+			std::size_t slot = hash(this->entries_[at].first) & mask;
+			while (this->index_[slot])
+				slot = (slot+1) & mask;
+			this->index_[slot] = uint32_t(at+1);
+		}
+		void rebuild () {
+			const std::size_t n = this->entries_.size();
+			this->index_.clear();
+			if (n <= linear_limit)
+				return;
+			std::size_t slots = 64;
+			while (slots < 4*n)
+				slots *= 2;
+			this->index_.resize(slots, 0);
+			const std::size_t mask = slots - 1;
+			for (std::size_t at=0; at<n; ++at) {
+				std::size_t slot = hash(this->entries_[at].first) & mask;
+				while (this->index_[slot])
+					slot = (slot+1) & mask;
+				this->index_[slot] = uint32_t(at+1);
+			}
+		}
+
+		// make room for one more
+		void grow () {
+			if (this->entries_.size() < this->entries_.capacity())
+				return;
+			this->reallocate(this->entries_.empty() ? 4 : 2*this->entries_.size());
+		}
+		// room for exactly capacity members, by moving the members, not
+		// copying them (a vector copies whatever might throw while it moves,
+		// and the values of a recursive variant might)
+		void reallocate (std::size_t capacity) {
+			entries_t moved(this->entries_.get_allocator());
+			moved.reserve(capacity);
+			for (iterator at=this->begin(); at!=this->end(); ++at) {
+#if __cplusplus >= 201103L
+				moved.push_back(std::move(*at));
+#else
+				moved.push_back(value_type());
+				using std::swap;
+				swap(moved.back().first, at->first);
+				swap(moved.back().second, at->second);
+#endif
+			}
+			this->entries_.swap(moved);
+		}
+
+		entries_t entries_;
+		index_t index_;   // 1+ the position of an entry, 0 for an empty slot
+	};
+
+	template <typename Key, typename Value, typename Allocator>
+	const std::size_t flat_map<Key,Value,Allocator>::linear_limit;
+
+	// make_json_value<..., flat_objects> keeps its objects in flat_maps
+	struct flat_objects {
+		template <typename Key, typename Value, typename Allocator>
+		struct apply {
+			typedef flat_map<Key,Value,
+				typename rebind_allocator<Allocator,std::pair<Key,Value> >::type> type;
+		};
+	};
+
+	// json_v, with flat objects
+	typedef make_json_value<std::string,double,bool,nil,
+		std::allocator<char>,flat_objects> json_flat_gen;
+	typedef json_flat_gen::value_t json_flat_v;
+
+	template <>
+	struct json_traits<json_flat_v> {
+		typedef json_flat_v                   value_t;
+		typedef std::string                   string_t;
+		typedef double                        number_t;
+		typedef json_flat_gen::object_t       object_t;
+		typedef json_flat_gen::array_t        array_t;
+		typedef bool                          bool_t;
+		typedef nil                           null_t;
+	};
+
+}
+
+#endif//JSONPP_FLAT_MAP
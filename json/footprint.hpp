@@ -0,0 +1,258 @@
+#include "jsonpp.hpp"
+#include "flat_map.hpp"
+// STL
+#include <cstddef>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#ifndef JSONPP_FOOTPRINT
+#define JSONPP_FOOTPRINT
+
+namespace JSONpp {
+
+	//=== [FOOTPRINT] ===
+	// What a tree of values (json_v, or any other make_json_value) holds in
+	// memory, by kind:
+	//
+	//    JSONpp::footprint used = JSONpp::measure(doc);
+	//    std::cout << used;               // a table
+	//    JSONpp::shrink_to_fit(doc);      // and give back the slack
+	//
+	// For every kind it counts the values, the bytes they hold, and of
+	// those bytes the ones that are not the data itself:
+	//    overhead   bookkeeping: the part of a value's slot (sizeof(value_t))
+	//               its kind does not use, the links of std::map nodes (four
+	//               words each, as in libstdc++), the hash index of a flat_map
+	//    slack      capacity not in use: the unused elements of a vector (or
+	//               flat_map), the unused characters of a string on the heap
+	// A value's slot is counted with its kind, wherever it is (an element of
+	// an array, a member of an object, the root). An object or array also
+	// holds the box the variant keeps it in; a string, the heap buffer it
+	// has when it is too long to keep inside itself. Keys are counted on
+	// their own. What the allocator keeps for itself (malloc's headers and
+	// rounding, an arena's unused block) is not counted.
+	struct footprint {
+		struct part {
+			part () : count(0), bytes(0), overhead(0), slack(0) {}
+			std::size_t count;
+			std::size_t bytes;
+			std::size_t overhead;
+			std::size_t slack;
+			std::size_t wasted () const { return this->overhead + this->slack; }
+			part& operator += (part const& p) {
+				this->count += p.count;
+				this->bytes += p.bytes;
+				this->overhead += p.overhead;
+				this->slack += p.slack;
+				return *this;
+			}
+		};
+
+		part strings, numbers, booleans, nulls, objects, arrays, keys;
+
+		// all of them together
+		part total () const {
+			part all;
+			all += this->strings;
+			all += this->numbers;
+			all += this->booleans;
+			all += this->nulls;
+			all += this->objects;
+			all += this->arrays;
+			all += this->keys;
+			return all;
+		}
+		std::size_t bytes () const { return this->total().bytes; }
+		std::size_t wasted () const { return this->total().wasted(); }
+
+		friend std::ostream& operator << (std::ostream& ostr, footprint const& F) {
+			const char *names[] = { "strings", "numbers", "booleans", "nulls", "objects", "arrays", "keys", "total" };
+			const part parts[] = { F.strings, F.numbers, F.booleans, F.nulls, F.objects, F.arrays, F.keys, F.total() };
+			ostr << std::left << std::setw(10) << "kind" << std::right
+					 << std::setw(12) << "count" << std::setw(14) << "bytes"
+					 << std::setw(14) << "overhead" << std::setw(14) << "slack" << std::endl;
+			for (std::size_t p=0; p<sizeof(parts)/sizeof(parts[0]); ++p)
+				ostr << std::left << std::setw(10) << names[p] << std::right
+						 << std::setw(12) << parts[p].count << std::setw(14) << parts[p].bytes
+						 << std::setw(14) << parts[p].overhead << std::setw(14) << parts[p].slack << std::endl;
+			return ostr;
+		}
+	};
+
+	namespace detail {
+		// the heap buffer of a string that does not fit inside itself
+		template <typename C, typename T, typename A>
+		bool on_heap (std::basic_string<C,T,A> const& s) {
+			const char *here = (const char*)&s, *data = (const char*)s.data();
+			return data < here or here + sizeof(s) <= data;
+		}
+		template <typename C, typename T, typename A>
+		void heap_bytes (std::basic_string<C,T,A> const& s, footprint::part& p) {
+			if (not on_heap(s))
+				return;
+			p.bytes += (s.capacity()+1) * sizeof(C);
+			p.slack += (s.capacity()-s.size()) * sizeof(C);
+		}
+		// (anything else is all in its slot: interned keys, numbers)
+		template <typename T>
+		void heap_bytes (T const&, footprint::part&) {}
+
+		template <typename C, typename T, typename A>
+		void fit (std::basic_string<C,T,A>& s) {
+			if (on_heap(s) and s.size() < s.capacity())
+				std::basic_string<C,T,A>(s).swap(s);
+		}
+		template <typename T>
+		void fit (T&) {}
+
+		template <typename Value>
+		struct measuring : boost::static_visitor<void> {
+			typedef json_traits<Value> traits;
+			typedef typename traits::string_t     string_t;
+			typedef typename traits::number_t     number_t;
+			typedef typename traits::object_t     object_t;
+			typedef typename traits::array_t      array_t;
+			typedef typename traits::bool_t       bool_t;
+			typedef typename traits::null_t       null_t;
+
+			measuring (footprint& F) : out(&F) {}
+
+			// a slot holding a T (in place, or a pointer to its box)
+			static void slot (footprint::part& p, std::size_t used) {
+				++p.count;
+				p.bytes += sizeof(Value);
+				p.overhead += (used < sizeof(Value)) ? sizeof(Value) - used : 0;
+			}
+
+			void operator () (string_t const& S) const {
+				slot(this->out->strings, sizeof(string_t));
+				heap_bytes(S, this->out->strings);
+			}
+			void operator () (number_t const& N) const {
+				slot(this->out->numbers, sizeof(number_t));
+				heap_bytes(N, this->out->numbers);
+			}
+			void operator () (bool_t const&) const {
+				slot(this->out->booleans, sizeof(bool_t));
+			}
+			void operator () (null_t const&) const {
+				slot(this->out->nulls, 0);
+			}
+			void operator () (array_t const& A) const {
+				footprint::part& p = this->out->arrays;
+				slot(p, sizeof(void*));
+				const std::size_t unused = (A.capacity() - A.size()) * sizeof(Value);
+				p.bytes += sizeof(array_t) + unused;
+				p.slack += unused;
+				for (typename array_t::const_iterator at=A.begin(); at!=A.end(); ++at)
+					boost::apply_visitor(*this, *at);
+			}
+			void operator () (object_t const& O) const {
+				footprint::part& p = this->out->objects;
+				slot(p, sizeof(void*));
+				p.bytes += sizeof(object_t);
+				this->container(O, p);
+				for (typename object_t::const_iterator at=O.begin(); at!=O.end(); ++at) {
+					footprint::part& k = this->out->keys;
+					++k.count;
+					k.bytes += sizeof(at->first);
+					heap_bytes(at->first, k);
+					boost::apply_visitor(*this, at->second);
+				}
+			}
+
+			// what an object keeps besides its members' keys and values
+			template <typename K, typename V, typename C, typename A>
+			void container (std::map<K,V,C,A> const& O, footprint::part& p) const {
+				const std::size_t links = 4 * sizeof(void*) * O.size();
+				p.bytes += links;
+				p.overhead += links;
+			}
+			template <typename K, typename V, typename A>
+			void container (flat_map<K,V,A> const& O, footprint::part& p) const {
+				const std::size_t unused = (O.capacity() - O.size())
+					* sizeof(typename flat_map<K,V,A>::value_type);
+				p.bytes += unused + O.index_memory();
+				p.slack += unused;
+				p.overhead += O.index_memory();
+			}
+
+			footprint *out;
+		};
+
+		template <typename Value>
+		struct fitting : boost::static_visitor<void> {
+			typedef json_traits<Value> traits;
+			typedef typename traits::object_t     object_t;
+			typedef typename traits::array_t      array_t;
+
+			void operator () (array_t& A) const {
+				for (typename array_t::iterator at=A.begin(); at!=A.end(); ++at)
+					boost::apply_visitor(*this, *at);
+				if (A.size() == A.capacity())
+					return;
+				// moved into a vector of the right size, not copied (the
+				// vector would copy what might throw while it moves)
+				array_t fitted(A.get_allocator());
+				fitted.reserve(A.size());
+				for (typename array_t::iterator at=A.begin(); at!=A.end(); ++at) {
+#if __cplusplus >= 201103L
+					fitted.push_back(std::move(*at));
+#else
+					fitted.push_back(Value());
+					using std::swap;
+					swap(fitted.back(), *at);
+#endif
+				}
+				A.swap(fitted);
+			}
+			void operator () (object_t& O) const {
+				this->container(O);
+			}
+			template <typename T>
+			void operator () (T& t) const {
+				fit(t);
+			}
+
+			// (the keys of a std::map are const, and are left as they are)
+			template <typename K, typename V, typename C, typename A>
+			void container (std::map<K,V,C,A>& O) const {
+				for (typename std::map<K,V,C,A>::iterator at=O.begin(); at!=O.end(); ++at)
+					boost::apply_visitor(*this, at->second);
+			}
+			template <typename K, typename V, typename A>
+			void container (flat_map<K,V,A>& O) const {
+				for (typename flat_map<K,V,A>::iterator at=O.begin(); at!=O.end(); ++at) {
+					fit(at->first);
+					boost::apply_visitor(*this, at->second);
+				}
+				O.shrink_to_fit();
+			}
+		};
+	}
+
+	// the footprint of value, and all it holds
+	template <typename Value>
+	footprint measure (Value const& value) {
+		footprint F;
+		detail::measuring<Value> measuring(F);
+		boost::apply_visitor(measuring, value);
+		return F;
+	}
+
+	// Give back the slack of every vector, flat_map and string under value,
+	// in place. The values are moved (swapped, before C++11), not copied, into
+	// containers of the right size; a tree in an arena gains nothing, since
+	// an arena does not take memory back.
+	template <typename Value>
+	void shrink_to_fit (Value& value) {
+		detail::fitting<Value> fitting;
+		boost::apply_visitor(fitting, value);
+	}
+
+}
+
+#endif//JSONPP_FOOTPRINT
@@ -0,0 +1,174 @@
+#include "jsonpp.hpp"
+#include "tape.hpp"
+// STL
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <string>
+// C
+#include <stdint.h>
+
+#ifndef JSONPP_IMAGE
+#define JSONPP_IMAGE
+
+namespace JSONpp {
+
+	//=== [DOCUMENT IMAGES] ===
+	// A parsed document saved as it sits in memory, so that a program can
+	// start with it already parsed: the image is a tape (see tape.hpp) --
+	// its words, then the text of its strings -- behind a small header.
+	// Nothing on the tape is a pointer (the words hold offsets and indices),
+	// so the file is mapped read-only and the tape is read straight out of
+	// it; opening one costs the same for 1 KB as for 1 GB, and the pages
+	// are read in as they are touched. Every process that opens the image
+	// shares the one copy in the page cache.
+	//
+	//    JSONpp::tape doc;
+	//    doc.parse(text);
+	//    JSONpp::write_image(doc, "config.jsonim");
+	//    ...
+	//    JSONpp::document_image image("config.jsonim");
+	//    std::cout << JSONpp::printer(image.root());
+	//
+	// The header is (all in the byte order of the machine that wrote it):
+	//    "JSONPPIM"             8 bytes
+	//    version                32 bits (image_version)
+	//    0x01020304             32 bits, to tell the byte order
+	//    the number of words    64 bits
+	//    the bytes of text      64 bits
+	//    a checksum             64 bits, of the words and the text
+	// and an image made with another version or byte order, or of the wrong
+	// size for its header, is refused with bad_image. The checksum has to
+	// read the whole file, so it is only checked when asked for (verify):
+	// without it a damaged image can read past the ends of its tape.
+	static const uint32_t image_version = 1;
+
+	struct bad_image : std::exception {
+		std::string message;
+		bad_image (std::string const& filename, std::string const& why) {
+			this->message = std::string("Bad document image: ") + filename + std::string(": ") + why;
+		}
+		virtual ~bad_image () throw() {}
+		virtual const char* what () const throw() {
+			return this->message.c_str();
+		}
+	};
+
+	struct image_header {
+		char magic[8];
+		uint32_t version;
+		uint32_t byte_order;
+		uint64_t words;
+		uint64_t text;
+		uint64_t checksum;
+	};
+
+	// FNV-1a, a word at a time (the words, then the text)
+	inline uint64_t image_checksum (tape const& doc) {
+		const uint64_t prime = 0x100000001b3ull;
+		uint64_t h = 0xcbf29ce484222325ull;
+		for (std::size_t i=0; i<doc.size(); ++i)
+			h = (h ^ doc.at(i)) * prime;
+		const char *text = doc.chars();
+		const std::size_t length = doc.chars_size();
+		std::size_t i = 0;
+		for ( ; i+sizeof(uint64_t) <= length; i+=sizeof(uint64_t)) {
+			uint64_t w;
+			std::memcpy(&w, text+i, sizeof(w));
+			h = (h ^ w) * prime;
+		}
+		for ( ; i<length; ++i)
+			h = (h ^ (unsigned char)text[i]) * prime;
+		return h;
+	}
+
+	// the image of doc
+	inline void write_image (tape const& doc, std::ostream& out) {
+		image_header header;
+		std::memcpy(header.magic, "JSONPPIM", sizeof(header.magic));
+		header.version = image_version;
+		header.byte_order = 0x01020304;
+		header.words = doc.size();
+		header.text = doc.chars_size();
+		header.checksum = image_checksum(doc);
+		out.write((const char*)&header, sizeof(header));
+		uint64_t block[1024];
+		for (std::size_t i=0; i<doc.size(); ) {
+			std::size_t n = 0;
+			for ( ; n<1024 and i<doc.size(); ++n, ++i)
+				block[n] = doc.at(i);
+			out.write((const char*)block, n*sizeof(uint64_t));
+		}
+		out.write(doc.chars(), doc.chars_size());
+	}
+
+	// the image of doc, as the file filename; it is written next to it and
+	// renamed into place, so a program that has the old image open keeps it
+	inline void write_image (tape const& doc, std::string const& filename) {
+		const std::string temporary = filename + ".tmp";
+		{
+			std::ofstream out(temporary.c_str(), std::ios::binary | std::ios::trunc);
+			if (out)
+				write_image(doc, out);
+			out.close();
+			if (not out) {
+				std::remove(temporary.c_str());
+				throw cannot_open(temporary);
+			}
+		}
+		if (0 != std::rename(temporary.c_str(), filename.c_str())) {
+			std::remove(temporary.c_str());
+			throw cannot_open(filename);
+		}
+	}
+
+	// An image file, mapped, and the tape in it; the values it gives out
+	// are valid while it is open.
+	class document_image {
+	public:
+		explicit document_image (std::string const& filename, bool verify=false)
+			: file_(filename, false) {
+			if (this->file_.size() < sizeof(image_header))
+				throw bad_image(filename, "too short");
+			std::memcpy(&this->header_, this->file_.begin(), sizeof(this->header_));
+			if (0 != std::memcmp(this->header_.magic, "JSONPPIM", sizeof(this->header_.magic)))
+				throw bad_image(filename, "not an image");
+			if (0x01020304 != this->header_.byte_order)
+				throw bad_image(filename, "another byte order");
+			if (image_version != this->header_.version)
+				throw bad_image(filename, "another version");
+			const uint64_t room = this->file_.size() - sizeof(image_header);
+			if (this->header_.words > room/sizeof(uint64_t)
+					or this->header_.text != room - this->header_.words*sizeof(uint64_t))
+				throw bad_image(filename, "the wrong size");
+			const char *words = this->file_.begin() + sizeof(image_header);
+			this->tape_.attach((const uint64_t*)words, std::size_t(this->header_.words),
+				words + this->header_.words*sizeof(uint64_t), std::size_t(this->header_.text));
+			if (verify and not this->verify())
+				throw bad_image(filename, "the checksum is wrong");
+		}
+
+		tape const& document () const { return this->tape_; }
+		tape_value root () const { return this->tape_.root(); }
+		bool empty () const { return this->tape_.empty(); }
+		// the bytes of the file
+		std::size_t size () const { return this->file_.size(); }
+
+		// whether the words and text are what was written (it reads them all)
+		bool verify () const {
+			return this->header_.checksum == image_checksum(this->tape_);
+		}
+
+	private:
+		document_image (document_image const&);
+		document_image& operator = (document_image const&);
+
+		mapped_file file_;
+		image_header header_;
+		tape tape_;
+	};
+
+}
+
+#endif//JSONPP_IMAGE
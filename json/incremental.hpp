@@ -0,0 +1,471 @@
+#include "jsonpp.hpp"
+// STL
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+#ifndef JSONPP_INCREMENTAL
+#define JSONPP_INCREMENTAL
+
+namespace JSONpp {
+
+	//=== [INCREMENTAL PARSER] ===
+	// push_parser and event_parser need the whole document up front. The
+	// incremental_parser instead takes the input in chunks of any size,
+	// through feed(), and keeps its place between them -- including in the
+	// middle of a string, an escape, a number, an identifier or a comment.
+	// It drives the same Handler interface as event_parser (see there), and
+	// an event is delivered as soon as the token behind it is complete.
+	//
+	// The input is a sequence of JSON values (one is fine; so is NDJSON or
+	// plain concatenation) in UTF-8. Strings are handed over in the same
+	// canonical JSON-ASCII form push_parser gives string_t.
+	//
+	// Only the text of a token that straddles two chunks is copied (into
+	// carry_), so memory is bounded by the largest token plus the nesting
+	// depth, whatever the size of the input.
+	//
+	//    incremental_parser<H> parser(handler);
+	//    while (n = read(fd, buf, sizeof(buf)))
+	//      parser.feed(buf, n);
+	//    parser.finish();
+	template <typename Handler>
+	class incremental_parser {
+	public:
+		incremental_parser (Handler& handler) : handler_(handler) {
+			this->reset();
+		}
+
+		// forget everything, ready for a new stream
+		void reset () {
+			this->expect_ = value;
+			this->stack_.clear();
+			this->lex_ = none;
+			this->carry_.clear();
+			this->completed_ = 0;
+		}
+
+		// parse the next chunk; returns the number of top-level values that
+		// were completed by it
+		std::size_t feed (const char* data, std::size_t size) {
+			const char *first = data, *last = data + size;
+			this->completed_ = 0;
+			while (first != last) {
+				if (none != this->lex_) { // in the middle of a token
+					this->start_ = first;
+					first = this->resume(first, last);
+					continue;
+				}
+				switch (*first) {
+				case ' ':case '\n':case '\v':case '\r':case '\b':case '\f':case '\t':
+					++first; break;
+				case '{': case '}': case '[': case ']': case ':': case ',':
+					this->structural(*first, first, first+1);
+					++first; break;
+				case '\"':
+					this->lex_ = string; this->escape_ = 0;
+					this->start_ = ++first;
+					first = this->resume(first, last);
+					break;
+				case '0':case '1':case '2':case '3':case '4':
+				case '5':case '6':case '7':case '8':case '9':
+				case '-':
+					this->lex_ = number; this->number_ = ('-' == *first) ? sign : integer;
+					this->start_ = first++;
+					first = this->resume(first, last);
+					break;
+				case 't': case 'f': case 'n':
+					this->lex_ = identifier;
+					this->spelling_ = ('t' == *first) ? JSON__true
+						: ('f' == *first) ? JSON__false : JSON__null;
+					this->matched_ = 1;
+					this->start_ = first++;
+					first = this->resume(first, last);
+					break;
+				case '#':
+					this->lex_ = line_comment;
+					++first; break;
+				case '/':
+					this->lex_ = comment;
+					++first; break;
+				default:
+					this->structural(token::unk, first, first+1);
+					++first;
+				}
+			}
+			return this->completed_;
+		}
+
+		// the end of the input: completes a number still waiting for its
+		// delimiter, and complains about anything left unfinished
+		std::size_t finish () {
+			this->completed_ = 0;
+			switch (this->lex_) {
+			case none: case line_comment: break;
+			case number:
+				if (sign == this->number_)
+					throw unknown_token(this->carry_);
+				this->emit(this->carry_.data(), this->carry_.data()+this->carry_.size());
+				break;
+			case string: throw expected_got("\"","nothing");
+			case identifier: throw unknown_token(this->carry_);
+			case comment: throw unknown_token("/");
+			case block_comment: case block_star: throw unknown_token("*");
+			}
+			this->lex_ = none;
+			this->carry_.clear();
+			if (not this->stack_.empty()) {
+				if (colon == this->expect_ or value == this->expect_)
+					throw expected_got("value","nothing");
+				if (key == this->expect_ or object_first == this->expect_)
+					throw expected_got("string","nothing");
+				throw expected_got(('{' == this->stack_.back()) ? "}" : "]", "nothing");
+			}
+			return this->completed_;
+		}
+
+		// between two top-level values, with nothing pending
+		bool idle () const {
+			return none == this->lex_ and this->stack_.empty();
+		}
+
+	private:
+		// what the lexer is in the middle of
+		enum lexing {
+			none, string, number, identifier,
+			comment,        // seen a '/'
+			line_comment, block_comment,
+			block_star,     // in a block comment, just seen a '*'
+		};
+		// where in a number we are: -?[0-9]+(.[0-9]*)?([eE][+-]?[0-9]*)?
+		enum numbering { sign, integer, fraction, exponent, exponent_digits };
+		// what the grammar wants next
+		enum expecting {
+			value,          // any value
+			array_first,    // a value or ]
+			object_first,   // a key or }
+			key,            // a key (after a comma)
+			colon,          // :
+			after,          // , or the close of the container
+		};
+
+		// carry on with the token in progress over [first,last); returns
+		// where the token ended (or last, if it did not)
+		const char* resume (const char* first, const char* last) {
+			switch (this->lex_) {
+			case string:
+				for ( ; first != last; ++first) {
+					const char c = *first;
+					if (0 == this->escape_) {
+						if ('\"' == c) {
+							this->lex_ = none;
+							this->complete(first, token::string);
+							return first+1;
+						}
+						if ('\\' == c)
+							this->escape_ = 1;
+					} else if (1 == this->escape_) {
+						switch (c) {
+						case '\"': case '\\': case '/':
+						case 'b': case 'f': case 'n': case 'r': case 't':
+							this->escape_ = 0; break;
+						case 'u':
+							this->escape_ = 2; break;
+						default:
+							throw unknown_token(std::string("\\")+c);
+						}
+					} else { // \uXXXX
+						if (not ((('0' <= c) and (c <= '9'))
+										 or (('a' <= c) and (c <= 'f'))
+										 or (('A' <= c) and (c <= 'F'))))
+							throw expected_got("\\u[0-9a-fA-F]*4", std::string(1,c));
+						this->escape_ = (6 == this->escape_+1) ? 0 : this->escape_+1;
+					}
+				}
+				break;
+			case number:
+				for ( ; first != last; ++first) {
+					const char c = *first;
+					const bool digit = ('0' <= c and c <= '9');
+					switch (this->number_) {
+					case sign:
+						if (not digit)
+							throw unknown_token(this->carry_ + std::string(this->start_, first));
+						this->number_ = integer; continue;
+					case integer:
+						if (digit) continue;
+						if ('.' == c) { this->number_ = fraction; continue; }
+						if ('e' == c or 'E' == c) { this->number_ = exponent; continue; }
+						break;
+					case fraction:
+						if (digit) continue;
+						if ('e' == c or 'E' == c) { this->number_ = exponent; continue; }
+						break;
+					case exponent:
+						if (digit or '-' == c or '+' == c) { this->number_ = exponent_digits; continue; }
+						break;
+					case exponent_digits:
+						if (digit) continue;
+						break;
+					}
+					// the number ended just before c
+					this->lex_ = none;
+					this->complete(first, token::number);
+					return first;
+				}
+				break;
+			case identifier:
+				for ( ; first != last and 0 != this->spelling_[this->matched_]; ++first, ++this->matched_)
+					if (*first != this->spelling_[this->matched_])
+						throw unknown_token(this->carry_ + std::string(this->start_, first+1));
+				if (0 == this->spelling_[this->matched_]) {
+					this->lex_ = none;
+					this->complete(first, ('n' == this->spelling_[0]) ? token::null : token::boolean);
+					return first;
+				}
+				break;
+			case comment:
+				if ('*' == *first)
+					this->lex_ = block_comment;
+				else if ('/' == *first)
+					this->lex_ = line_comment;
+				else
+					throw unknown_token(std::string(first,first+1));
+				return first+1;
+			case line_comment: {
+				const char *eol = (const char*)std::memchr(first, '\n', last - first);
+				if (not eol)
+					return last;
+				this->lex_ = none;
+				return eol+1;
+			}
+			case block_comment: case block_star:
+				for ( ; first != last; ++first) {
+					if (block_star == this->lex_ and '/' == *first) {
+						this->lex_ = none;
+						return first+1;
+					}
+					this->lex_ = ('*' == *first) ? block_star : block_comment;
+				}
+				return last;
+			case none:
+				break;
+			}
+			// the token goes on into the next chunk
+			this->carry_.append(this->start_, last);
+			return last;
+		}
+
+		// the token that started at start_ (or in carry_) ends at last
+		void complete (const char* last, token::kind kind) {
+			const char *first = this->start_;
+			if (not this->carry_.empty()) {
+				this->carry_.append(first, last);
+				first = this->carry_.data();
+				last = first + this->carry_.size();
+			}
+			if (token::string == kind and not json_ascii_clean(first, last)) {
+				this->folded_.clear();
+				utf_8_to_json_ascii(first, last, this->folded_);
+				first = this->folded_.data();
+				last = first + this->folded_.size();
+			}
+			this->structural(kind, first, last);
+			this->carry_.clear();
+		}
+
+		void emit (const char* first, const char* last) {
+			this->structural(token::number, first, last);
+		}
+
+		// the grammar; the same productions as push_parser, as a state
+		// machine with an explicit stack of the open containers
+		void structural (char kind, const char* first, const char* last) {
+			switch (this->expect_) {
+			case array_first:
+				if (']' == kind) {
+					this->handler_.end_array();
+					this->close();
+					return;
+				}
+				// fall through
+			case value:
+				switch (kind) {
+				case token::string: this->handler_.string(first, last); break;
+				case token::number: this->handler_.number(first, last); break;
+				case token::boolean: this->handler_.boolean('t' == *first); break;
+				case token::null: this->handler_.null(); break;
+				case '{':
+					this->handler_.begin_object();
+					this->stack_.push_back('{');
+					this->expect_ = object_first;
+					return;
+				case '[':
+					this->handler_.begin_array();
+					this->stack_.push_back('[');
+					this->expect_ = array_first;
+					return;
+				default:
+					throw unexpected_token(std::string(first,last));
+				}
+				this->after_value();
+				return;
+			case object_first:
+				if ('}' == kind) {
+					this->handler_.end_object();
+					this->close();
+					return;
+				}
+				// fall through
+			case key:
+				if (token::string != kind and token::number != kind)
+					throw expected_got("string",std::string(first,last));
+				this->handler_.key(first, last);
+				this->expect_ = colon;
+				return;
+			case colon:
+				if (':' != kind)
+					throw expected_got(":",std::string(first,last));
+				this->expect_ = value;
+				return;
+			case after:
+				if ('{' == this->stack_.back()) {
+					if (',' == kind) { this->expect_ = key; return; }
+					if ('}' != kind) throw expected_got("}",std::string(first,last));
+					this->handler_.end_object();
+				} else {
+					if (',' == kind) { this->expect_ = value; return; }
+					if (']' != kind) throw expected_got("]",std::string(first,last));
+					this->handler_.end_array();
+				}
+				this->close();
+				return;
+			}
+		}
+		void close () {
+			this->stack_.pop_back();
+			this->after_value();
+		}
+		void after_value () {
+			if (this->stack_.empty()) {
+				++this->completed_;
+				this->expect_ = value;
+			} else
+				this->expect_ = after;
+		}
+
+		Handler& handler_;
+		expecting expect_;
+		std::vector<char> stack_;     // the open containers, '{' or '['
+		lexing lex_;
+		numbering number_;
+		int escape_;                  // 0, 1 after a \, 2-5 in a \uXXXX
+		const char *spelling_;        // the identifier being matched
+		std::size_t matched_;         //   and how much of it
+		const char *start_;           // where the token started in this chunk
+		std::string carry_;           // the token so far, from earlier chunks
+		std::string folded_;          // a string token, folded to JSON-ASCII
+		std::size_t completed_;       // top-level values finished by this feed/finish
+	};
+
+	//=== [VALUE BUILDER] ===
+	// A Handler that builds value_t's out of the events, for the parsers
+	// that only produce events (e.g., the incremental_parser). Completed
+	// top-level values queue up until they are taken.
+	template <typename JSONType>
+	class value_builder : public null_handler {
+	public:
+		typedef json_traits<JSONType> traits;
+		typedef typename traits::value_t      value_t;
+		typedef typename traits::string_t     string_t;
+		typedef typename traits::number_t     number_t;
+		typedef typename traits::object_t     object_t;
+		typedef typename traits::array_t      array_t;
+		typedef typename traits::bool_t       bool_t;
+		typedef typename traits::null_t       null_t;
+		typedef typename object_key<object_t,string_t>::type key_t;
+
+		// the number of completed values waiting to be taken
+		std::size_t ready () const { return this->values_.size(); }
+		// the oldest completed value
+		value_t take () {
+			value_t val = JSONPP_MOVE(this->values_.front());
+			this->values_.pop_front();
+			return val;
+		}
+
+		void begin_object () {
+			this->frames_.push_back(frame());
+			this->frames_.back().object = true;
+		}
+		void begin_array () {
+			this->frames_.push_back(frame());
+			this->frames_.back().object = false;
+		}
+		void end_object () {
+			value_t val;
+			val = JSONPP_MOVE(this->frames_.back().obj);
+			this->frames_.pop_back();
+			this->add(val);
+		}
+		void end_array () {
+			value_t val;
+			val = JSONPP_MOVE(this->frames_.back().arr);
+			this->frames_.pop_back();
+			this->add(val);
+		}
+		void key (const char* first, const char* last) {
+			this->frames_.back().key = key_t(first, last);
+		}
+		void string (const char* first, const char* last) {
+			value_t val;
+			val = string_t(first, last);
+			this->add(val);
+		}
+		void number (const char* first, const char* last) {
+			number_t num;
+			number_decoder<number_t>::decode(first, last, num);
+			value_t val;
+			val = num;
+			this->add(val);
+		}
+		void boolean (bool b) {
+			bool_t boolean;
+			boolean = b;
+			value_t val;
+			val = boolean;
+			this->add(val);
+		}
+		void null () {
+			value_t val;
+			val = null_t();
+			this->add(val);
+		}
+
+	private:
+		// an open container (only one of obj/arr is in use)
+		struct frame {
+			bool object;
+			object_t obj;
+			array_t arr;
+			key_t key;
+		};
+
+		void add (value_t& val) {
+			if (this->frames_.empty())
+				this->values_.push_back(JSONPP_MOVE(val));
+			else if (this->frames_.back().object) {
+				frame& top = this->frames_.back();
+				top.obj[top.key] = JSONPP_MOVE(val);
+			} else
+				this->frames_.back().arr.push_back(JSONPP_MOVE(val));
+		}
+
+		std::deque<frame> frames_;    // a deque never moves its elements
+		std::deque<value_t> values_;
+	};
+
+}
+
+#endif//JSONPP_INCREMENTAL
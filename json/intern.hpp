@@ -0,0 +1,216 @@
+#include "jsonpp.hpp"
+#include "flat_map.hpp"
+// STL
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifndef JSONPP_INTERN
+#define JSONPP_INTERN
+
+namespace JSONpp {
+
+	//=== [STRING POOL] ===
+	// A document of records repeats the same handful of keys over and over;
+	// with interned keys each distinct key is kept once, in a string_pool,
+	// and every occurrence is a pointer to it. Two keys from the same pool
+	// are equal exactly when the pointers are, and hash to what the pool
+	// worked out when it first saw the text.
+	//
+	// The pool has to outlive every value whose keys came from it (it hands
+	// nothing back until it goes away), and is not safe to share between
+	// threads that are parsing at the same time: give each its own.
+	class string_pool;
+
+	struct pooled_string {
+		std::string text;
+		std::size_t hash;
+		string_pool const* pool;  // where it lives (0 for the empty string)
+	};
+
+	class interned_string {
+	public:
+		typedef char                 value_type;
+		typedef const char*          const_iterator;
+		typedef const char*          iterator;
+		typedef std::size_t          size_type;
+
+		// the empty string, which belongs to no pool
+		interned_string () : entry_(&nothing()) {}
+		// the text [first, last), interned in the pool in scope on this thread
+		// (this is how the parsers make keys)
+		template <typename Iter>
+		interned_string (Iter first, Iter last);
+
+		const char* begin () const { return this->entry_->text.data(); }
+		const char* end () const { return this->begin() + this->size(); }
+		const char* data () const { return this->entry_->text.data(); }
+		const char* c_str () const { return this->entry_->text.c_str(); }
+		std::size_t size () const { return this->entry_->text.size(); }
+		bool empty () const { return this->entry_->text.empty(); }
+		std::string const& str () const { return this->entry_->text; }
+		std::size_t hash () const { return this->entry_->hash; }
+
+		// keys from one pool compare by address; from different pools (or
+		// for ordering) by their text
+		friend bool operator == (interned_string const& L, interned_string const& R) {
+			return L.entry_ == R.entry_
+				or (L.entry_->pool != R.entry_->pool and L.entry_->text == R.entry_->text);
+		}
+		friend bool operator != (interned_string const& L, interned_string const& R) {
+			return not (L == R);
+		}
+		friend bool operator < (interned_string const& L, interned_string const& R) {
+			return L.entry_ != R.entry_ and L.entry_->text < R.entry_->text;
+		}
+
+	private:
+		friend class string_pool;
+		explicit interned_string (pooled_string const* entry) : entry_(entry) {}
+
+		static pooled_string const& nothing () {
+			static const pooled_string empty = { std::string(), fnv_1a((const char*)0, (const char*)0), 0 };
+			return empty;
+		}
+
+		pooled_string const* entry_;
+	};
+
+	inline std::size_t json_key_hash (interned_string const& key) {
+		return key.hash();
+	}
+
+	class string_pool {
+	public:
+		string_pool () {}
+
+		// the one copy of [first, last) in this pool
+		interned_string intern (const char* first, const char* last) {
+			if (first == last)
+				return interned_string();
+			const std::size_t h = fnv_1a(first, last);
+			const std::size_t n = std::size_t(last - first);
+			if (2*(this->entries_.size()+1) > this->index_.size())
+				this->rehash();
+			const std::size_t mask = this->index_.size() - 1;
+			std::size_t slot = h & mask;
+			for (; this->index_[slot]; slot = (slot+1) & mask) {
+				pooled_string const* at = this->index_[slot];
+				if (at->hash == h and at->text.size() == n
+						and at->text.compare(0, n, first, n) == 0)
+					return interned_string(at);
+			}
+			pooled_string entry = { std::string(first, last), h, this };
+			this->entries_.push_back(entry);
+			this->index_[slot] = &this->entries_.back();
+			return interned_string(this->index_[slot]);
+		}
+		template <typename Iter>
+		interned_string intern (Iter first, Iter last) {
+			this->scratch_.assign(first, last);
+			// (data() is a char* in C++17, which would pick this template again)
+			const char *text = this->scratch_.c_str();
+			return this->intern(text, text + this->scratch_.size());
+		}
+		interned_string intern (std::string const& text) {
+			return this->intern(text.data(), text.data()+text.size());
+		}
+		interned_string intern (const char* text) {
+			return this->intern(text, text+std::strlen(text));
+		}
+
+		// the number of distinct strings, and the bytes they take up
+		std::size_t size () const { return this->entries_.size(); }
+		std::size_t memory () const {
+			std::size_t total = this->index_.capacity() * sizeof(pooled_string const*);
+			for (std::deque<pooled_string>::const_iterator at=this->entries_.begin();
+					at!=this->entries_.end(); ++at)
+				total += sizeof(pooled_string) + at->text.capacity();
+			return total;
+		}
+
+		// While a scope is alive, the keys the parsers make on its thread are
+		// interned in its pool.
+		class scope {
+		public:
+			explicit scope (string_pool& P) : previous_(current()) { current() = &P; }
+			~scope () { current() = this->previous_; }
+		private:
+			scope (scope const&);
+			scope& operator = (scope const&);
+			string_pool *previous_;
+		};
+		static string_pool*& current () {
+			static JSONPP_THREAD_LOCAL string_pool *in_use = 0;
+			return in_use;
+		}
+
+	private:
+		string_pool (string_pool const&);
+		string_pool& operator = (string_pool const&);
+
+		void rehash () {
+			std::vector<pooled_string const*> bigger(this->index_.empty() ? 64 : 2*this->index_.size(), 0);
+			const std::size_t mask = bigger.size() - 1;
+			for (std::deque<pooled_string>::const_iterator at=this->entries_.begin();
+					at!=this->entries_.end(); ++at) {
+				std::size_t slot = at->hash & mask;
+				while (bigger[slot])
+					slot = (slot+1) & mask;
+				bigger[slot] = &*at;
+			}
+			this->index_.swap(bigger);
+		}
+
+		std::deque<pooled_string> entries_;          // a deque never moves its elements
+		std::vector<pooled_string const*> index_;    // open addressed, 0 for empty
+		std::string scratch_;
+	};
+
+	template <typename Iter>
+	interned_string::interned_string (Iter first, Iter last) : entry_(&nothing()) {
+		string_pool *pool = string_pool::current();
+		if (0 == pool)
+			throw std::logic_error("interned_string: no string_pool in scope");
+		*this = pool->intern(first, last);
+	}
+
+	// make_json_value<..., interned_keys<Objects> > keys its objects (kept
+	// in Objects) by interned_string
+	template <typename Objects=map_objects>
+	struct interned_keys {
+		template <typename Key, typename Value, typename Allocator>
+		struct apply : Objects::template apply<interned_string,Value,Allocator> {};
+	};
+
+	// json_flat_v, with interned keys
+	typedef make_json_value<std::string,double,bool,nil,
+		std::allocator<char>,interned_keys<flat_objects> > json_interned_gen;
+	typedef json_interned_gen::value_t json_interned_v;
+
+	template <>
+	struct json_traits<json_interned_v> {
+		typedef json_interned_v               value_t;
+		typedef std::string                   string_t;
+		typedef double                        number_t;
+		typedef json_interned_gen::object_t   object_t;
+		typedef json_interned_gen::array_t    array_t;
+		typedef bool                          bool_t;
+		typedef nil                           null_t;
+	};
+
+	// parse [first, last) with its keys interned in pool
+	template <typename JSONType, typename Iter>
+	typename json_traits<JSONType>::value_t
+	parse_interned (Iter first, Iter last, string_pool& pool, bool extensions=false) {
+		string_pool::scope in(pool);
+		push_parser<JSONType> parser;
+		return parser(first, last, extensions);
+	}
+
+}
+
+#endif//JSONPP_INTERN
@@ -1,23 +1,62 @@
 // boost
 #include <boost/variant.hpp>
 #include <boost/variant/recursive_variant.hpp>
+#include <boost/mpl/eval_if.hpp>
+#include <boost/mpl/has_xxx.hpp>
+#include <boost/mpl/identity.hpp>
 // STL
 #include <exception>
 #include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include <clocale>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <iterator>
+#include <limits>
+#include <locale>
 #include <map>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
-// iconv
-#include <iconv.h>
+#if __cplusplus >= 201703L and defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
+// POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 // BEL library
 #include <utility/begin-end.hpp>
+// JSONpp
+#include <json/structural.hpp>
+#include <json/utf.hpp>
 
 #ifndef JSON_PARSER
 #define JSON_PARSER
 
+// with C++0x rvalue references the parser hands finished values up the
+// tree instead of copying them; without them it falls back to copying
+#if __cplusplus >= 201103L
+#define JSONPP_MOVE(x) std::move(x)
+#else
+#define JSONPP_MOVE(x) (x)
+#endif
+
+// per-thread state (the arena or string pool a thread is building with)
+#if __cplusplus >= 201103L
+#define JSONPP_THREAD_LOCAL thread_local
+#else
+#define JSONPP_THREAD_LOCAL __thread
+#endif
+
 namespace JSONpp {
 	
 	//=== [JSTRING (UNICODE SUPPORT)] ===
@@ -53,112 +92,19 @@ namespace JSONpp {
 	// Case 2:
 	//    Lazily read (chunks) and convert by-chunk into the ASCII folding
 	//
-	// Utilities:
-	//  UTF-16LE => JSON-ASCII
+	// Utilities (in utf.hpp):
+	//  UTF-8, UTF-16BE/LE, UTF-32BE/LE => JSON-ASCII
 	
 	char to_hex_value (wchar_t S) {
 		return (15&S) + (((15&S) > 9) ? ('A'-10) : '0');
 	}
 	
-	std::string utf_16le_to_json_ascii (std::string const& utf16le) {
-		typedef std::string::const_iterator citer;
-		
-		std::string result(utf16le.size()*6, 0); // worst case scenario
-		std::size_t offset = 0;
-		
-		for (citer ctr=utf16le.begin(), cnd=utf16le.end(); ctr!=cnd; ctr+=2) {
-			const wchar_t value = (unsigned char)*ctr + (((unsigned char)*(ctr+1)) << 8);
-			if (31 < value and value < 127) {
-				result[offset] = (char)value;
-				++offset;
-			} else {
-				switch (value) {
-				case '\t': result[offset] = '\t'; ++offset; break;
-				case '\v': result[offset] = '\v'; ++offset; break;
-				case '\n': result[offset] = '\n'; ++offset; break;
-				case '\r': result[offset] = '\r'; ++offset; break;
-				case '\b': result[offset] = '\b'; ++offset; break;
-				case '\f': result[offset] = '\f'; ++offset; break;
-				default: // large code-points
-					result[offset] = '\\'; ++offset;
-					result[offset] = 'u'; ++offset;
-					result[offset] = to_hex_value(value>>12); ++offset;
-					result[offset] = to_hex_value(value>> 8); ++offset;
-					result[offset] = to_hex_value(value>> 4); ++offset;
-					result[offset] = to_hex_value(value>> 0); ++offset;
-					break;
-				}
-			}
-		}
-		return result;
-	}
-	
-	template <typename X>
-	std::string utf_to_utf_16le (std::basic_string<X> const& str) {
-		typedef typename std::basic_string<X>::const_iterator xc_iter;
-		
-		const char * utf_32be = "UTF-32BE";
-		const char * utf_16be = "UTF-16BE";
-		const char * utf_32le = "UTF-32LE";
-		const char * utf_16le = "UTF-16LE";
-		const char * utf_8    = "UTF8";
-		
-		// first, determine if it is "packed"
-		bool packed = (str[0]>>8) > 0; // whether the values are greater than 255
-		char *source = 0;
-		if (packed) {
-			source = (char*)calloc(str.size(), sizeof(X));
-			std::memcpy(source, reinterpret_cast<const char*>(str.c_str()), str.size()*sizeof(X));
-		} else {
-			source = (char*)calloc(str.size(), 1);
-			char *src = source;
-			for (xc_iter xtr=str.begin(), xnd=str.end(); xtr!=xnd; ++xtr, ++src)
-				*src = *xtr;
-		}
-		// look at the first four bytes and determine the encoding
-		const char * from;
-		int encoding = (0 != source[0] ? 8 : 0)
-			| (0 != source[1] ? 4 : 0)
-			| (0 != source[2] ? 2 : 0)
-			| (0 != source[3] ? 1 : 0);
-		switch (encoding) {
-		case 1  /*UTF-32BE*/: from = utf_32be; break;
-		case 5  /*UTF-16BE*/: from = utf_16be; break;
-		case 8  /*UTF-32LE*/: from = utf_32le; break;
-		case 10 /*UTF-16LE*/: from = utf_16le; break;
-		case 15 /*UTF-8*/:
-		default:  from = utf_8; break; // why not?
-		}
-		
-		// the worst case scenario is that we'll need two 16-bit values for
-		// each character...
-		const std::size_t sourceL = str.size();
-		const std::size_t destinationL = 2*str.size();
-		char *destination = (char*)calloc(destinationL, 1);
-		
-		// now we use iconv to convert...
-		std::size_t length = 0;
-		iconv_t cd = iconv_open ("UTF-16LE", from);
-		if ((iconv_t)-1 != cd) {
-			std::size_t srcL = sourceL, dstL = destinationL;
-			char *src = source;
-			char *dst = destination;
-			std::size_t result = iconv(cd, &src, &srcL, &dst, &dstL);
-			length = destinationL - dstL;
-			iconv_close(cd);
-		}
-		std::string result(destination, length);
-		
-		free(destination), destination = 0;
-		free(source), source = 0;
+	inline std::string utf_16le_to_json_ascii (std::string const& utf16le) {
+		std::string result;
+		utf_16_to_json_ascii(utf16le.data(), utf16le.data()+utf16le.size(), false, result);
 		return result;
 	}
 	
-	template <typename X>
-	std::string json_ascii (std::basic_string<X> const& str) {
-		return utf_16le_to_json_ascii(utf_to_utf_16le(str));
-	}
-	
 	//=== [ERROR MESSAGES] ===
 	struct unknown_identifier : std::exception {
 		std::string message;
@@ -193,6 +139,17 @@ namespace JSONpp {
 		}
 	};
 	
+	struct cannot_open : std::exception {
+		std::string message;
+		cannot_open (std::string const& filename) {
+			this->message = std::string("Cannot open: ") + filename;
+		}
+		virtual ~cannot_open () throw() {}
+		virtual const char* what () const throw() {
+			return this->message.c_str();
+		}
+	};
+	
 	struct expected_got : std::exception {
 		std::string message;
 		expected_got (std::string const& exp, std::string const& got) {
@@ -228,6 +185,9 @@ namespace JSONpp {
 		// 3. object_t should have the following legal expressions:
 		//     O[S] = V;
 		//    where O is an object_t, S is a string_t, and V is one of the types above
+		//    (the parser builds each member in place, in the value_t& O[S]);
+		//    if object_t has a key_type, the keys are made as that instead
+		//    (see object_key)
 		// 4. array_t should have the following legal expressions:
 		//     A.push_back(V);
 		//    where A is an array_t, and V is one of the types above
@@ -235,7 +195,688 @@ namespace JSONpp {
 		// 6. null_t has no requirements, but should probably be cheap to move around!
 	};
 	
+	namespace detail {
+		BOOST_MPL_HAS_XXX_TRAIT_DEF(key_type)
+	}
+	
+	// the type the parsers make the keys of an object_t as: its key_type, if
+	// it has one, or else string_t; either is made from the text of the key
+	// as K(first, last)
+	template <typename Object, typename String>
+	struct object_key {
+		struct get_key_type { typedef typename Object::key_type type; };
+		typedef typename boost::mpl::eval_if<detail::has_key_type<Object>,
+			get_key_type, boost::mpl::identity<String> >::type type;
+	};
+	
+	//=== [LEXER] ===
+	// this kludginess allows us to easily look for identifiers
+	// welcome the wonderful world of Unicode!
+	static const char JSON__true[] = "true";
+	static const char JSON__false[] = "false";
+	static const char JSON__null[] = "null";
+
+	// internal token class, should not be publically exposed
+	// a token only lives as long as the lexer is looking at it, so
+	// there is only ever one of them alive at a time; it does not copy
+	// its text, it refers to the range [first_,last_) of the input, which
+	// must outlive it
+	struct token {
+		// The set of tokens; note that when we tokenize
+		// we will convert identifiers into "boolean" or "null",
+		// and character-strings that start/end with `"` become strings,
+		// and character-strings that match the weird "number" spec
+		// for JSON become "number".
+		enum kind {
+			unk = '?',
+			curlyL = '{',
+			curlyR = '}',
+			brakL = '[',
+			brakR = ']',
+			string = '\"',
+			number = 'n',
+			colon = ':',
+			comma = ',',
+			boolean = 'b',
+			null = '0',
+			eof = '$',
+		};
+		token () : kind_(unk), first_(0), last_(0), offset_(0) {}
+		
+		// a copy of the text; for error messages and the like
+		std::string value () const { return std::string(this->first_, this->last_); }
+		
+		// mainly for debug purposes
+		friend std::ostream& operator << (std::ostream& ostr, token const& tok) {
+			ostr << "`" << tok.value() << "`@" << tok.offset_;
+			return ostr;
+		}
+		kind kind_;           // which kind of token we are
+		const char *first_;   // the text of the token in the input
+		const char *last_;    //   (strings without their quotes)
+		std::size_t offset_;  // the offset into the file for printing purposes
+		// TODO: build an offset->(line,col) converter
+	};
+	
+	// The lexer is a pull-tokenizer over a character range: instead of
+	// lexing the whole file into a list of tokens up front, the parser
+	// asks for the next token only when it is ready to consume it. The
+	// lexer always holds exactly one token of look-ahead; once the input
+	// is exhausted the look-ahead is a token::eof.
+	//
+	// Large inputs are first run through a structural_index, which finds
+	// the start of every token (SIMD, 64 bytes at a time); the lexer then
+	// jumps from one start to the next rather than walking the whitespace,
+	// and finds the end of a string from the index rather than scanning.
+	// Inputs with comments cannot be indexed and are always scanned.
+	// Now that tokens are cheap the index only pays for itself when
+	// there is a lot of whitespace to jump over (pretty-printed files),
+	// so the lexer samples the input before deciding to build it.
+	class lexer {
+	public:
+		// inputs shorter than this are not worth indexing
+		static const std::size_t index_threshold = 1024;
+		
+		lexer (const char* first, const char* last, bool indexed=true)
+			: init_(first), first_(first), last_(last)
+			, indexed_(false), next_(0) {
+			if (indexed and worth_indexing(first, last))
+				this->indexed_ = this->index_.build(first, last);
+			this->next();
+		}
+		
+		// the look-ahead token
+		token const& current () const { return this->tok_; }
+		token::kind kind () const { return this->tok_.kind_; }
+		
+		// advance the look-ahead by one token
+		void next () {
+			if (not this->indexed_)
+				return this->scan();
+			structural_index::positions_t const& positions = this->index_.positions();
+			const char *first = this->first_;
+			const bool done = (positions.size() == this->next_);
+			// a token glued to the end of the previous one (`truex', `1-2')
+			// does not start a run, so it is not in the index; scan it
+			if (first != this->last_ and not is_space(*first)
+					and (done or first != this->init_ + positions[this->next_]))
+				return this->scan();
+			if (done) { // nothing but whitespace left
+				this->first_ = this->last_;
+				return this->scan();
+			}
+			first = this->init_ + positions[this->next_++];
+			token& tok = this->tok_;
+			switch (*first) {
+			case '{': tok.kind_ = token::curlyL; break;
+			case '}': tok.kind_ = token::curlyR; break;
+			case '[': tok.kind_ = token::brakL; break;
+			case ']': tok.kind_ = token::brakR; break;
+			case ':': tok.kind_ = token::colon; break;
+			case ',': tok.kind_ = token::comma; break;
+			default: tok.kind_ = token::unk; break;
+			}
+			if (token::unk != tok.kind_) {
+				tok.offset_ = first - this->init_;
+				tok.first_ = first; tok.last_ = first+1;
+				this->first_ = first+1;
+				return;
+			}
+			if ('\"' == *first and positions.size() != this->next_) {
+				// the closing quote is the next position, so all that is
+				// left to do is to check the escapes in between
+				const char *begin = first+1;
+				const char *close = this->init_ + positions[this->next_++];
+				const char *esc = begin;
+				while (this->index_.escapes()
+							 and (esc = (const char*)std::memchr(esc, '\\', close - esc)))
+					esc = escape(esc, close, begin) + 1;
+				tok.kind_ = token::string;
+				tok.offset_ = first - this->init_;
+				tok.first_ = begin; tok.last_ = close;
+				this->first_ = close+1;
+				return;
+			}
+			this->first_ = first;
+			this->scan();
+		}
+		
+	private:
+		// This function lexes exactly one token into the look-ahead
+		// it is NOT recursive, it is iterative.
+		void scan () {
+			const char *first = this->first_, *last = this->last_;
+			const char *begin = first;
+			token& tok = this->tok_;
+			
+			// Iterate over the characters until we have generated a token.
+			// Whitespace and comments do not generate tokens, so we loop
+			// (skip) past them. The pointers "first" and "last" tell us
+			// where we're at in the input. The pointer "init_" tells us
+			// the global start-position (for calculating the offset), and
+			// the pointer "begin" is used as a dummy value.
+			bool skip = true;
+			while (skip) {
+				skip = false;
+				tok.offset_ = first - this->init_;
+				if (first == last) {
+					tok.kind_ = token::eof;
+					tok.first_ = tok.last_ = last;
+					break;
+				}
+				tok.first_ = first; tok.last_ = first+1;
+				// we're going to greedily eat the following things:
+				// 1. strings "...", which include the legal escapes
+				// 2. numbers 12.4e-35
+				// 3. identifiers starting with "t" "f" or "n"
+				// 4. comments, both c and c++ style
+				// 5. the rest of the characters come in three groups:
+				//    a. whitespace, which we ignore
+				//    b. tokenizing chars: [ ] { } : ,
+				//    c. error generating chars (everything else)
+				switch (*first) {
+				case ' ':case '\n':case '\v':case '\r':case '\b':case '\f':case '\t':
+					skip = true; ++first; break;
+				case '{': tok.kind_ = token::curlyL; ++first; break;
+				case '}': tok.kind_ = token::curlyR; ++first; break;
+				case '[': tok.kind_ = token::brakL; ++first; break;
+				case ']': tok.kind_ = token::brakR; ++first; break;
+				case ':': tok.kind_ = token::colon; ++first; break;
+				case ',': tok.kind_ = token::comma; ++first; break;
+				case '\"': {
+					// strings start and end with a `"`
+					// there are only a subset of legal escape sequences (see escape)
+					begin = first+1;
+					// scan until we have an unescaped "
+					tok.kind_ = token::string;
+					for (++first; first != last; ++first) {
+						if ('\"' == *first) // end-of-string
+							break;
+						if ('\\' == *first) // escape sequence
+							first = escape(first, last, begin);
+					}
+					if (first == last) // ran out of characters
+						throw expected_got("\"","nothing");
+					tok.first_ = begin; tok.last_ = first;
+					++first; // eat last " character
+				} break;
+				case '0':case '1':case '2':case '3':case '4':
+				case '5':case '6':case '7':case '8':case '9':
+				case '-': {
+					// numbers start with [0-9] or a '-'
+					// they are of this format: -?[0-9]+(.[0-9]+)?([eE][+-][0-9]+)
+					// which is a pretty ghetto integer/float format
+					begin = first;
+					// scan until we have a non-number char
+					// the allowed characters are:
+					tok.kind_ = token::number;
+					// get digits portion
+					if ('-' == *first) ++first; // get optional -
+					const char *digits = first;
+					first = get_digits(first,last); // get the digits
+					if (digits == first) // a lonely '-'
+						throw unknown_token(std::string(begin,first));
+					// we could have a dot and some digits
+					if (first != last and '.' == *first) {
+						++first; // if we have a ., we have to have more digits
+						first = get_digits(first,last);
+					}
+					// optional "exponent" for our "mantissa"
+					if (first != last and ('e' == *first || 'E' == *first)) {
+						++first;
+						if (first != last and ('-' == *first || '+' == *first)) // optional sign
+							++first;
+						first = get_digits(first,last);
+					}
+					tok.first_ = begin; tok.last_ = first;
+				} break;
+				case 't': case 'f': case 'n': {
+					// possibly an identifier, there are three legal ones:
+					// "true", "false", and "null"
+					// What we do is figure out which identifier it is by its first
+					// character. Then we compare the identifier it *should* be
+					// to the next k-characters. If it doesn't match (not the
+					// right identifier, or not enough characters, whatever), we
+					// abort.
+					begin = first;
+					tok.kind_ = token::boolean;
+					const char *wh = JSON__true; // default to "true"
+					if ('f' == *first) wh = JSON__false; // "false"
+					else if ('n' == *first) {
+						wh = JSON__null; // "null"; also, change the token type
+						tok.kind_ = token::null;
+					}
+					// compare the next few chars to our identifier
+					while (first != last and 0 != *wh) {
+						if (*first != *wh)
+							throw unknown_token(std::string(begin,first+1));
+						++first; ++wh;
+					}
+					if (0 != *wh) // ran out of characters
+						throw unknown_token(std::string(begin,first));
+					tok.first_ = begin; tok.last_ = first;
+				} break;
+				case '/': case '#': {
+					// comments are actually an optional construt for JSON, but
+					// they're so useful, it just feels right to have them; also,
+					// this is more liberal than not having them, and they're pretty
+					// easy to build
+					// All comments start with "/" (or "#")
+					//   1. C++ continue (immediately) with "/" and go to "\n"
+					//   2. C continue (immediately) with "*" and go to "*/"
+					//   3. shell comments start with "#" and go to "\n"
+					// consume first slash
+					skip = true;
+					const char *orig = first;
+					++first;
+					if ('#' == *orig) { // shell-style
+						first = skip_line(first,last);
+					} else if (first == last) { // / is not a legal anything
+						throw unknown_token("/");
+					} else if ('*' == *first) { // C-style comment
+						// c-style
+						++first;
+						while (true) {
+							if (first == last) // comment ended before */
+								throw unknown_token("*");
+							if ('*' == *first) { // look for a */
+								++first;
+								if (first != last and '/' == *first) { // it is done!
+									++first;
+									break;
+								}
+								continue;
+							}
+							++first;
+						}
+					} else if ('/' == *first) { // C++ style comment must have //
+						// c++ style
+						// go to the end of the line or file
+						first = skip_line(first,last);
+					} else // /? is not legal
+						throw unknown_token(std::string(first,first+1));
+				} break;
+				default: // don't know ... but also don't care (for now)
+					tok.kind_ = token::unk;
+					++first;
+				}
+			}
+			this->first_ = first;
+		}
+		
+		// check the escape sequence at first (a backslash) and return the
+		// position of its last character; begin is where the string started
+		// there are only a subset of legal escape sequences:
+		//   1. whitespace \[bfnrt]
+		//   2. unicode \u[0-9a-fA-F]*4, where '*4' means "four of them"
+		//   3. other escape sequences \["\/]
+		static const char* escape (const char* first, const char* last, const char* begin) {
+			++first; // looking at the next character
+			if (first == last) // ran out of characters
+				throw unknown_token("\\");
+			switch (*first) {
+			case '\"': case '\\': case '/':
+			case 'b': case 'f': case 'n': case 'r': case 't':
+				break; // fine, ignore these guys
+			case 'u': { // unicode character-point format
+				// four hex digits, I assume this means: [0-9a-fA-F]
+				for (std::size_t i=0; i<4; ++i) {
+					++first; // look at next char
+					if (first == last)
+						throw expected_got("\\u[0-9a-fA-F]*4",
+															 std::string(begin,first));
+					if (not ((('0' <= *first) and (*first <= '9'))
+									 or (('a' <= *first) and (*first <= 'f'))
+									 or (('A' <= *first) and (*first <= 'F'))))
+						throw expected_got("\\u[0-9a-fA-F]*4",
+															 std::string(first,first+1));
+				}
+			} break;
+			default: // uhoh
+				throw unknown_token(std::string("\\")+*first);
+			}
+			return first;
+		}
+		// at least a third of the first few KB is whitespace
+		static bool worth_indexing (const char* first, const char* last) {
+			const std::size_t size = last - first;
+			if (size < index_threshold)
+				return false;
+			const char *sample = first + std::min<std::size_t>(size, 4096);
+			std::size_t spaces = 0;
+			for (const char *c = first; c != sample; ++c)
+				spaces += is_space(*c);
+			return std::size_t(sample - first) <= 3*spaces;
+		}
+		static bool is_space (char c) {
+			switch (c) {
+			case ' ':case '\n':case '\v':case '\r':case '\b':case '\f':case '\t':
+				return true;
+			default:
+				return false;
+			}
+		}
+		static const char* get_digits (const char* first, const char* last) {
+			// scan, look for 0-9
+			while (first != last) {
+				if ('0' > *first || '9' < *first)
+					break;
+				++first;
+			}
+			return first;
+		}
+		static const char* skip_line (const char* first, const char* last) {
+			// go to the end of the line or file, eating the newline
+			while (first != last) {
+				if ('\n' == *first)
+					return ++first;
+				++first;
+			}
+			return first;
+		}
+		
+		const char *init_;   // start of the input (for offsets)
+		const char *first_;  // the first character not yet lexed
+		const char *last_;   // end of the input
+		token tok_;          // the look-ahead
+		bool indexed_;       // whether index_ is in use
+		structural_index index_;
+		std::size_t next_;   // the next position in the index
+	};
+	
+	//=== [EVENT PARSER] ===
+	// The event (SAX) parser walks exactly the same grammar as push_parser,
+	// using the same lexer (and so the same comment extensions), but instead
+	// of building a value_t it calls back into a Handler as each piece of
+	// the document is recognized. No tree is ever built, so the memory used
+	// is bounded by the nesting depth of the document.
+	//
+	// A Handler must provide the following (null_handler, below, provides
+	// all of them as no-ops, so it is a convenient base class):
+	//    H.begin_object();          H.end_object();
+	//    H.begin_array();           H.end_array();
+	//    H.key(first, last);        the key of the next member
+	//    H.string(first, last);     H.number(first, last);
+	//    H.boolean(b);              H.null();
+	// where [first,last) is a range of const char* holding the text of the
+	// token (strings without their quotes, in the same canonical form that
+	// push_parser gives string_t). The range is only valid for the duration
+	// of the call.
+	struct null_handler {
+		void begin_object () {}
+		void end_object () {}
+		void begin_array () {}
+		void end_array () {}
+		void key (const char*, const char*) {}
+		void string (const char*, const char*) {}
+		void number (const char*, const char*) {}
+		void boolean (bool) {}
+		void null () {}
+	};
+	
+	template <typename Handler>
+	struct event_parser {
+		event_parser (Handler& handler) : handler_(handler) {}
+		
+		// push the events of the (single) JSON value in [begin,end) into
+		// the handler; an empty input produces no events
+		template <typename Iter>
+		void operator () (Iter begin, Iter end) {
+			// same canonicalization as push_parser::parse
+			std::string lcp;
+			json_ascii(begin, end, lcp);
+			this->run(lcp.data(), lcp.data()+lcp.size());
+		}
+		// bytes in memory need no copy unless they have to be transcoded
+		void operator () (const char* begin, const char* end) {
+			std::string scratch;
+			json_ascii(begin, end, scratch);
+			this->run(begin, end);
+		}
+		
+	private:
+		Handler& handler_;
+		
+		void run (const char* begin, const char* end) {
+			lexer lex(begin, end);
+			if (token::eof != lex.kind())
+				this->parse(lex);
+		}
+		
+		// the productions mirror push_parser's, see there for the details
+		void parse (lexer& lex) {
+			token const& tok = lex.current();
+			switch (tok.kind_) {
+			case token::string:
+				this->handler_.string(tok.first_, tok.last_);
+				lex.next();
+				break;
+			case token::number:
+				this->handler_.number(tok.first_, tok.last_);
+				lex.next();
+				break;
+			case token::boolean:
+				this->handler_.boolean('t' == *tok.first_);
+				lex.next();
+				break;
+			case token::null:
+				this->handler_.null();
+				lex.next();
+				break;
+			case token::curlyL:
+				this->parse_object(lex);
+				break;
+			case token::brakL:
+				this->parse_array(lex);
+				break;
+			case token::eof:
+				throw expected_got("value","nothing");
+			default:
+				throw unexpected_token(tok.value());
+			}
+		}
+		
+		void parse_object (lexer& lex) {
+			token const& tok = lex.current();
+			this->handler_.begin_object();
+			// eat the {
+			lex.next();
+			if (token::curlyR != tok.kind_) {
+				while (true) {
+					// eat the key
+					if (token::string != tok.kind_ and token::number != tok.kind_) {
+						if (token::eof == tok.kind_)
+							throw expected_got("string","nothing");
+						throw expected_got("string",tok.value());
+					}
+					this->handler_.key(tok.first_, tok.last_);
+					lex.next();
+					// eat the colon (:)
+					if (token::colon != tok.kind_)
+						throw expected_got(":",tok.value());
+					lex.next();
+					// eat the value
+					this->parse(lex);
+					if (token::comma != tok.kind_)
+						break;
+					lex.next();
+				}
+			}
+			// had better be a }, if so, eat it
+			if (token::eof == tok.kind_)
+				throw expected_got("}","nothing");
+			if (token::curlyR != tok.kind_)
+				throw expected_got("}",tok.value());
+			lex.next();
+			this->handler_.end_object();
+		}
+		
+		void parse_array (lexer& lex) {
+			token const& tok = lex.current();
+			this->handler_.begin_array();
+			// eat the [
+			lex.next();
+			if (token::brakR != tok.kind_) {
+				while (true) {
+					this->parse(lex);
+					if (token::comma != tok.kind_)
+						break;
+					lex.next();
+				}
+			}
+			if (token::eof == tok.kind_)
+				throw expected_got("]", "nothing");
+			if (token::brakR != tok.kind_)
+				throw expected_got("]", tok.value());
+			// eat the ]
+			lex.next();
+			this->handler_.end_array();
+		}
+	};
+	
+	// push the events of [first,last) into handler, returning the handler
+	template <typename Iter, typename Handler>
+	Handler& push (Iter first, Iter last, Handler& handler) {
+		event_parser<Handler> parser(handler);
+		parser(first, last);
+		return handler;
+	}
+	
+	//=== [NUMBER DECODING] ===
+	// Converts the text of a number token into a number_t. The general case
+	// goes through a stringstream (this is where the requirement that number_t
+	// be stream-convertible comes from), imbued with the classic locale so
+	// that the decimal point is always a `.'.
+	//
+	// That is slow, so plain doubles get their own decoder:
+	//   1. up to 19 significant digits are gathered into an integer
+	//   2. integers (no fraction, no exponent) convert exactly, or with a
+	//      single correctly rounded conversion
+	//   3. otherwise, if the digits fit in 53 bits and the power of ten is
+	//      at most 22, both are exact doubles and one multiplication (or
+	//      division) rounds correctly (Clinger's fast path)
+	//   4. everything else (very long mantissas, huge exponents) is rare and
+	//      goes to std::from_chars, or strtod before C++17; both round
+	//      correctly, and neither needs a stream
+	// The token has already been checked by the lexer, so [first,last) is
+	//   -?[0-9]+(.[0-9]*)?([eE][+-]?[0-9]*)?
+	template <typename Number>
+	struct number_decoder {
+		static void decode (const char* first, const char* last, Number& num) {
+			std::istringstream ss(std::string(first, last));
+			ss.imbue(std::locale::classic());
+			ss >> num;
+		}
+	};
+	
+	template <>
+	struct number_decoder<double> {
+		static void decode (const char* first, const char* last, double& num) {
+			static const double powers[] = {
+				1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+				1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+				1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+			};
+			const char *c = first;
+			const bool negative = ('-' == *c);
+			if (negative) ++c;
+			// gather the significant digits
+			unsigned long long mantissa = 0;
+			int digits = 0;         // significant digits in mantissa
+			int exponent = 0;       // the decimal exponent of mantissa
+			bool truncated = false; // more than 19 significant digits
+			bool integer = true;
+			for ( ; c != last and '0' <= *c and *c <= '9'; ++c) {
+				if (digits < 19) {
+					mantissa = 10*mantissa + (*c - '0');
+					digits += (0 != mantissa);
+				} else {
+					truncated |= ('0' != *c);
+					++exponent;
+				}
+			}
+			if (c != last and '.' == *c) {
+				integer = false;
+				for (++c; c != last and '0' <= *c and *c <= '9'; ++c) {
+					if (digits < 19) {
+						mantissa = 10*mantissa + (*c - '0');
+						digits += (0 != mantissa);
+						--exponent;
+					} else
+						truncated |= ('0' != *c);
+				}
+			}
+			if (c != last and ('e' == *c or 'E' == *c)) {
+				integer = false;
+				++c;
+				bool negexp = false;
+				if (c != last and ('-' == *c or '+' == *c))
+					negexp = ('-' == *(c++));
+				int e = 0;
+				for ( ; c != last and '0' <= *c and *c <= '9'; ++c)
+					if (e < 100000) // far beyond the range of double
+						e = 10*e + (*c - '0');
+				exponent += negexp ? -e : e;
+			}
+			
+			double value;
+			if (not truncated and integer and 0 == exponent) {
+				value = double(mantissa);
+			} else if (not truncated and mantissa <= (1ULL << 53)
+								 and -22 <= exponent and exponent <= 22) {
+				value = double(mantissa);
+				if (exponent < 0)
+					value /= powers[-exponent];
+				else
+					value *= powers[exponent];
+			} else { // the slow path
+				num = slow(first, last, exponent + digits > 0);
+				return;
+			}
+			num = negative ? -value : value;
+		}
+
+		// correctly rounded, whatever the mantissa and exponent; values out
+		// of range go to infinity (huge) or zero, with their sign
+		static double slow (const char* first, const char* last, bool huge) {
+#if defined(__cpp_lib_to_chars)
+			double value = 0;
+			if (std::errc::result_out_of_range == std::from_chars(first, last, value).ec)
+				value = huge ? std::numeric_limits<double>::infinity() : 0.0;
+			return ('-' == *first) ? -std::abs(value) : value;
+#else
+			// strtod wants a terminated copy, with the decimal point of the
+			// C locale (which might not be a `.')
+			char buffer[64];
+			std::string longer;
+			char *text = buffer;
+			const std::size_t length = last - first;
+			if (length >= sizeof(buffer)) {
+				longer.assign(length+1, '\0');
+				text = &longer[0];
+			}
+			std::memcpy(text, first, length);
+			text[length] = '\0';
+			const char point = *std::localeconv()->decimal_point;
+			if ('.' != point)
+				std::replace(text, text+length, '.', point);
+			(void)huge; // strtod saturates by itself
+			return std::strtod(text, 0);
+#endif
+		}
+	};
+	
 	//=== [parser generator] ===
+	// How the parser keeps the text of strings (and keys) in string_t:
+	//   folded:  JSON-ASCII, escapes as written and the rest of unicode
+	//            folded into \uXXXX escapes (see JSTRING)
+	//   decoded: UTF-8, with every escape replaced by what it stands for;
+	//            print these with the iomanipulator_::decoded flag
+	enum string_form {
+		folded,
+		decoded,
+	};
+	
 	// Given a type that satisfies the JSON type
 	template <typename JSONType>
 	struct push_parser {
@@ -247,6 +888,7 @@ namespace JSONpp {
 		typedef typename traits::array_t      array_t;
 		typedef typename traits::bool_t       bool_t;
 		typedef typename traits::null_t       null_t;
+		typedef typename object_key<object_t,string_t>::type key_t;
 		
 		// JSON defines three identifiers:
 		//   "true" "false" "null"
@@ -257,46 +899,7 @@ namespace JSONpp {
 		static const std::string False;
 		static const std::string Null;
 		
-	private:
-		// internal token class, should not be publically exposed
-		// this thing is a little bulky because it stores a string
-		// representation of everything it looks at. That means
-		// that the tokens are about the same mass as the input string
-		struct token {
-			// The set of tokens; note that when we tokenize
-			// we will convert identifiers into "boolean" or "null",
-			// and character-strings that start/end with `"` become strings,
-			// and character-strings that match the weird "number" spec
-			// for JSON become "number".
-			enum kind {
-				unk = '?',
-				curlyL = '{',
-				curlyR = '}',
-				brakL = '[',
-				brakR = ']',
-				string = '\"',
-				number = 'n',
-				colon = ':',
-				comma = ',',
-				boolean = 'b',
-				null = '0',
-			};
-			token () : kind_(unk), value_(), offset_(0) {}
-			
-			// mainly for debug purposes
-			friend std::ostream& operator << (std::ostream& ostr, token const& tok) {
-				ostr << "`" << tok.value_ << "`@" << tok.offset_;
-				return ostr;
-			}
-			kind kind_;           // which kind of token we are
-			std::string value_;   // the string representation from the file
-			std::size_t offset_;  // the offset into the file for printing purposes
-			// TODO: build an offset->(line,col) converter
-		};
-		
-		typedef std::vector<token> tokens_t;
-		typedef typename tokens_t::const_iterator tok_iter;
-	public:
+		push_parser (string_form form=folded) : form_(form) {}
 		
 		// given a string (filestr) whose contents are supposedly a JSON
 		// try to parse; we return a recursive data-structure representing
@@ -318,238 +921,99 @@ namespace JSONpp {
 			return parse(bel::begin(filestr), bel::end(filestr), extensions);
 		}
 		
+		// the event-driven alternative: no value_t is built, instead the
+		// handler is called as the document is recognized (see event_parser)
+		template <typename Iter, typename Handler>
+		Handler& push (Iter begin, Iter end, Handler& handler) {
+			return JSONpp::push(begin, end, handler);
+		}
+		
+		// bytes in memory need no copy unless they have to be transcoded
+		value_t parse (const char* begin, const char* end, bool extensions=false) {
+			this->extensions_ = extensions;
+			std::string scratch;
+			if (decoded == this->form_)
+				utf_8_text(begin, end, scratch);
+			else
+				json_ascii(begin, end, scratch);
+			lexer lex(begin, end);
+			return this->parse(lex);
+		}
+		
+		// exactly one value, with nothing but whitespace after it (a record
+		// of newline-delimited JSON): anything more throws
+		value_t parse_one (const char* begin, const char* end) {
+			this->extensions_ = false;
+			std::string scratch;
+			if (decoded == this->form_)
+				utf_8_text(begin, end, scratch);
+			else
+				json_ascii(begin, end, scratch);
+			lexer lex(begin, end);
+			value_t val = this->parse(lex);
+			if (token::eof != lex.kind())
+				throw expected_got("the end", lex.current().value());
+			return val;
+		}
+		
 		template <typename Iter>
 		value_t parse (Iter begin, Iter end, bool extensions=false) {
 			this->extensions_ = extensions;
 			// make a copy of the input string into our internal
 			// string type to simplify things, heavy-weight, but
 			// we can optimize later
-			std::string lcp(begin, end);
-			lcp = json_ascii(lcp);
-			// lex the file and get the tokens
-			std::vector<token> tokens = this->lex(bel::begin(lcp),bel::end(lcp));
-			// parse tokens
-			return this->parse(tokens);
+			std::string lcp;
+			if (decoded == this->form_)
+				utf_8_text(begin, end, lcp);
+			else
+				json_ascii(begin, end, lcp);
+			// the recursive descent pulls tokens from the lexer as it
+			// goes, so we never hold more than one token at a time
+			lexer lex(lcp.data(), lcp.data()+lcp.size());
+			return this->parse(lex);
 		}
 		
+		// the values of [begin, end), which is what is between the brackets
+		// of an array: text that has already been through json_ascii (or
+		// utf_8_text), values separated by commas; they are appended to out
+		// (any sequence with push_back). This is how parallel_parser parses
+		// a piece of a big array.
+		template <typename Sequence>
+		void parse_elements (const char* begin, const char* end, Sequence& out) {
+			lexer lex(begin, end);
+			value_t val;
+			while (true) {
+				this->parse(lex, val);
+				out.push_back(JSONPP_MOVE(val));
+				if (token::comma != lex.kind())
+					break;
+				lex.next();
+			}
+			if (token::eof != lex.kind())
+				throw expected_got("]", lex.current().value());
+		}
+		
+		string_form form () const { return this->form_; }
+		
 	private:
 		// allows certain extensions to be used:
 		// 0. none supported (needs metaprogramming)
 		bool extensions_;
+		string_form form_;
+		std::string text_; // a decoded string, on its way into string_t
 
-		// We're going to re-dispatch on the sequence [b,e) instead
-		// of the token-container. This is a hand-written recursive
-		// descent parser. Note that the JSON standard is "pseudo-regular"
-		// so this is pretty easy to parse.
-		value_t parse (tokens_t const& toks) {
+		// This is a hand-written recursive descent parser over the
+		// look-ahead token of the lexer; each parse function starts on
+		// the first token of its production and leaves the lexer on the
+		// first token after it. Note that the JSON standard is
+		// "pseudo-regular" so this is pretty easy to parse.
+		value_t parse (lexer& lex) {
 			value_t val;
-			tok_iter first = bel::begin(toks), last = bel::end(toks), prog;
-			if (first != last) // prevent naughtiness
-				prog = this->parse(first, last, val);
+			if (token::eof != lex.kind()) // prevent naughtiness
+				this->parse(lex, val);
 			return val;
 		}
 		
-		// This function lexes a string into a list of tokens
-		// it is NOT recursive, it is iterative.
-		template <typename Iter>
-		std::vector<token>
-		lex (Iter first, Iter last) {
-			std::vector<token> tokens;
-			
-			Iter begin = first, init = first;
-			
-			// Iterate over all the characters to generat tokens.
-			// Since we're going to generate a token in each "pass"
-			// through the while-loop, we create a default token (tok)
-			// and set its initial values. The iterators, "first" and
-			// "last" tell us where we're at in the list. The iterator
-			// "init" tells us the global start-position (for calculating
-			// the offset), and the iterator "begin" is used as a dummy
-			// value.
-			while (first != last) {
-				token tok;
-				tok.offset_ = first - init;
-				tok.value_ = std::string(first,first+1);
-				bool skip = false;
-				// we're going to greedily eat the following things:
-				// 1. strings "...", which include the legal escapes
-				// 2. numbers 12.4e-35
-				// 3. identifiers starting with "t" "f" or "n"
-				// 4. comments, both c and c++ style
-				// 5. the rest of the characters come in three groups:
-				//    a. whitespace, which we ignore
-				//    b. tokenizing chars: [ ] { } : ,
-				//    c. error generating chars (everything else)
-				switch (*first) {
-				case ' ':case '\n':case '\v':case '\r':case '\b':case '\f':case '\t':
-					skip = true; ++first; break;
-				case '{': tok.kind_ = token::curlyL; ++first; break;
-				case '}': tok.kind_ = token::curlyR; ++first; break;
-				case '[': tok.kind_ = token::brakL; ++first; break;
-				case ']': tok.kind_ = token::brakR; ++first; break;
-				case ':': tok.kind_ = token::colon; ++first; break;
-				case ',': tok.kind_ = token::comma; ++first; break;
-				case '\"': {
-          // strings start and end with a `"`
-          // there are only a subset of legal escape sequences:
-          //   1. whitespace \[bfnrt]
-          //   2. unicode \u[0-9a-fA-F]*4, where '*4' means "four of them"
-          //   3. other escape sequences \["\/]
-          begin = first+1;
-          // scan until we have an unescaped "
-          tok.kind_ = token::string;
-          while (first != last) {
-            ++first;
-            if ('\"' == *first) // end-of-string
-              break;
-            if ('\\' == *first) { // escape sequence
-              ++first; // looking at the next character
-              if (first == last) // ran out of characters
-                throw unknown_token("\\");
-              switch (*first) {
-              case '\"': case '\\': case '/':
-              case 'b': case 'f': case 'n': case 'r': case 't':
-                break; // fine, ignore these guys
-              case 'u': { // unicode character-point format
-								// four hex digits, I assume this means: [0-9a-fA-F]
-								for (std::size_t i=0; i<4; ++i) {
-									++first; // look at next char
-									if (first == last)
-										throw expected_got("\\u[0-9a-fA-F]*4",
-																			 std::string(begin,first));
-									if (not ((('0' <= *first) and (*first <= '9'))
-													 or (('a' <= *first) and (*first <= 'f'))
-													 or (('A' <= *first) and (*first <= 'F'))))
-										throw expected_got("\\u[0-9a-fA-F]*4",
-																			 std::string(first,first+1));
-								}
-							} break;
-              default: // uhoh
-                throw unknown_token("");
-								//to_string_t("\\")+*first);
-              }
-            }
-          }
-          tok.value_ = std::string(begin, first);
-          ++first; // eat last " character
-        } break;
-				case '0':case '1':case '2':case '3':case '4':
-				case '5':case '6':case '7':case '8':case '9':
-				case '-': {
-          // numbers start with [0-9] or a '-'
-          // they are of this format: -?[0-9]+(.[0-9]+)?([eE][+-][0-9]+)
-          // which is a pretty ghetto integer/float format
-          begin = first;
-          // scan until we have a non-number char
-          // the allowed characters are:
-          tok.kind_ = token::number;
-          // get digits portion
-          if ('-' == *first) ++first; // get optional -
-          first = get_digits(first,last); // get the digits
-          // we could have a dot and some digits
-          if ('.' == *first) {
-            ++first; // if we have a ., we have to have more digits
-            first = get_digits(first,last);
-          }
-          // optional "exponent" for our "mantissa"
-          if ('e' == *first || 'E' == *first) {
-            ++first;
-            if ('-' == *first || '+' == *first) // optional sign
-              ++first;
-            first = get_digits(first,last);
-          }
-          tok.value_ = std::string(begin, first);
-        } break;
-				case 't': case 'f': case 'n': {
-          // possibly an identifier, there are three legal ones:
-          // "true", "false", and "null"
-          // What we do is figure out which identifier it is by its first
-          // character. Then we compare the identifier it *should* be
-          // to the next k-characters. If it doesn't match (not the
-          // right identifier, or not enough characters, whatever), we
-          // abort.
-          begin = first;
-          tok.kind_ = token::boolean;
-          std::string wh = True; // default to "true"
-          if ('f' == *first) wh = False; // "false"
-          else if ('n' == *first) {
-            wh = Null; // "null"; also, change the token type
-            tok.kind_ = token::null;
-          }
-          // compare the next few chars to our identifier
-          typename std::string::const_iterator whs = bel::begin(wh), whd = bel::end(wh);
-          while (first != last and whs != whd) {
-            if (*first != *whs) {
-              throw unknown_token(std::string(begin,first));
-            }
-            ++first; ++whs;
-          }
-          tok.value_ = std::string(begin, first);
-        } break;
-				case '/': case '#': {
-          // comments are actually an optional construt for JSON, but
-          // they're so useful, it just feels right to have them; also,
-          // this is more liberal than not having them, and they're pretty
-          // easy to build
-          // All comments start with "/"
-          //   1. C++ continue (immediately) with "/" and go to "\n"
-          //   2. C continue (immediately) with "*" and go to "*/"
-          // consume first slash
-          skip = true;
-          const Iter orig = first;
-          ++first;
-          if (first == last) // / is not a legal anything
-            throw unknown_token("/");
-          if ('*' == *first) { // C-style comment
-            // c-style
-            while (first != last) {
-              if ('*' == *first) { // look for a */
-                ++first;
-                if (first == last) // comment ended before */
-                  throw unknown_token("*");
-                if ('/' == *first) { // it is done!
-                  ++first;
-                  break;
-                }
-              }
-              ++first;
-            }
-          } else if ('/' == *first) { // C++ style comment must have //
-            // c++ style
-            // go to the end of the line or file
-					cppcomment: while (first != last) {
-              if ('\n' == *first)
-                break;
-              ++first;
-            }
-            if (first != last)
-              ++first;
-          } else if ('#' == *orig)
-            goto cppcomment; // blech
-          else // /? is not legal
-            throw unknown_token(std::string(first,first+1));
-        } break;
-				default: // don't know ... but also don't care (for now)
-					tok.kind_ = token::unk;
-					++first;
-				}
-				if (not skip)
-					tokens.push_back(tok);
-			}
-			return tokens;
-		}
-		
-		template <typename StrIter>
-		StrIter get_digits(StrIter first, StrIter last) {
-			// scan, look for 0-9
-			while (first != last) {
-				if ('0' > *first || '9' < *first)
-					break;
-				++first;
-			}
-			return first;
-		}
-		
 		// The parser is recursive-descent...
 		// This function tries to make a value, in some sense it is the
 		// general case. We could have any of the different "types" in
@@ -563,161 +1027,152 @@ namespace JSONpp {
 		//   0 -> null
 		// These are the only legal (top-level) tokens. We reject everything
 		// else.
-		tok_iter parse (tok_iter first, tok_iter last, value_t& val) {
-			if (first == last) return last;
-			string_t string;
-			number_t number;
-			object_t object;
-			array_t  array;
-			bool_t   boolean;
-			null_t   null;
-			switch (first->kind_) {
-      case token::string:
-        first = this->parse(first, last, string);
-        val = string;
-        break;
-      case token::number:
-        first = this->parse(first, last, number);
-        val = number;
-        break;
-      case token::boolean:
-        first = this->parse(first, last, boolean);
-        val = boolean;
-        break;
-      case token::null:
-        first = this->parse(first, last, null);
-        val = null;
-        break;
-      case token::curlyL:
-        first = this->parse(first, last, object);
-        val = object;
-        break;
-      case token::brakL:
-        first = this->parse(first, last, array);
-        val = array;
-        break;
-      default:
-        throw unexpected_token(first->value_);
-        break;
+		// The temporaries are scoped to their case so that deep nesting
+		// does not pay for all six of them in every stack frame, and they
+		// are moved (not copied) into val, so that a value nested N levels
+		// deep is not copied N times on the way up.
+		void parse (lexer& lex, value_t& val) {
+			switch (lex.kind()) {
+			case token::string: {
+				string_t string;
+				this->parse(lex, string);
+				val = JSONPP_MOVE(string);
+			} break;
+			case token::number: {
+				number_t number;
+				this->parse(lex, number);
+				val = number;
+			} break;
+			case token::boolean: {
+				bool_t boolean;
+				this->parse(lex, boolean);
+				val = boolean;
+			} break;
+			case token::null: {
+				null_t null;
+				this->parse(lex, null);
+				val = null;
+			} break;
+			case token::curlyL: {
+				object_t object;
+				this->parse(lex, object);
+				val = JSONPP_MOVE(object);
+			} break;
+			case token::brakL: {
+				array_t array;
+				this->parse(lex, array);
+				val = JSONPP_MOVE(array);
+			} break;
+			case token::eof:
+				throw expected_got("value","nothing");
+			default:
+				throw unexpected_token(lex.current().value());
 			}
-			return first;
 		}
 		
 		// a string is a single token, just assign to the out value
-		tok_iter parse (tok_iter first, tok_iter last, string_t& str) {
-			if (first == last) return last;
-			str = string_t(first->value_.begin(), first->value_.end());
-			return ++first;
+		// (this is where the text of the token is first copied)
+		void parse (lexer& lex, string_t& str) {
+			this->text(lex, str);
+		}
+		// (and a key, which might not be a string_t)
+		template <typename String>
+		void text (lexer& lex, String& str) {
+			token const& tok = lex.current();
+			if (decoded == this->form_) {
+				this->text_.clear();
+				json_unescape(tok.first_, tok.last_, this->text_);
+				str = String(this->text_.begin(), this->text_.end());
+			} else
+				str = String(tok.first_, tok.last_);
+			lex.next();
 		}
 		// a number is a single token, just assign to the out value
-		// NB: we build our own stringstream for conversion ... oy
-		tok_iter parse (tok_iter first, tok_iter last, number_t& num) {
-			if (first == last) return last;
-			std::stringstream ss(first->value_);
-			ss >> num; // this is where our requirement
-			// for stringstream convertible comes from
-			return ++first;
+		// (see number_decoder)
+		void parse (lexer& lex, number_t& num) {
+			token const& tok = lex.current();
+			number_decoder<number_t>::decode(tok.first_, tok.last_, num);
+			lex.next();
 		}
 		// a boolean is a single token, just assign the right value
-		tok_iter parse (tok_iter first, tok_iter last, bool_t& b) {
-			if (first == last) return last;
-			if (True == first->value_)
-				b = true;
-			else if (False == first->value_)
-				b = false;
-			else // other kinds of identifier values are illegal
-				throw unknown_identifier(first->value_);
-			return ++first;
+		// (the lexer only makes a boolean of "true" or "false")
+		void parse (lexer& lex, bool_t& b) {
+			b = ('t' == *lex.current().first_);
+			lex.next();
 		}
 		// a null is a single token, eat it
-		tok_iter parse (tok_iter first, tok_iter last, null_t& n) {
-			if (first == last) return last;
-			if (Null != first->value_) // reject other kinds of identifiers
-				throw unknown_identifier(first->value_);
-			return ++first;
+		// (the lexer only makes a null of "null")
+		void parse (lexer& lex, null_t& n) {
+			lex.next();
 		}
 		// an object is where we lose "regularity" for our language (along with
 		// arrays):
 		//    object ::= `{` (string : value [, string : value]*)? `}`
 		// Where value could ALSO be an object.
 		// However, there is still the "string : value" to maintain
-		tok_iter parse (tok_iter first, tok_iter last, object_t& obj) {
-			if (first == last) return last;
+		// (we are lenient and also take a number as the key)
+		void parse (lexer& lex, object_t& obj) {
 			// eat the {
-			++first;
-			tok_iter prog; // we must guarantee progress
-			string_t key;  // the key
-			value_t val;   // the value
-			do {
-				// eat the key
-				prog = this->parse(first, last, key);
-				if (prog == first) // maintain progress
-					break; // no key!
-				first = prog;
-				// eat the colon (:)
-				if (token::colon != first->kind_)
-					throw expected_got(":",first->value_);
-				++first;
-				// eat the value
-				prog = this->parse(first, last, val);
-				if (prog == first) // maintain progress
-					throw expected_got("value","nothing");
-				first = prog;
-				// eat possible comma (,)
-				obj[key] = val;
-				// if there is a comma, there must be another "string : value"
-				// pair; otherwise we're done
-				if (token::comma != first->kind_)
-					break;
-				else
-					++first;
-			} while (first != last);
+			lex.next();
+			if (token::curlyR != lex.kind()) {
+				key_t key;  // the key
+				while (true) {
+					// eat the key
+					if (token::string != lex.kind() and token::number != lex.kind()) {
+						if (token::eof == lex.kind())
+							throw expected_got("string","nothing");
+						throw expected_got("string",lex.current().value());
+					}
+					this->text(lex, key);
+					// eat the colon (:)
+					if (token::colon != lex.kind())
+						throw expected_got(":",lex.current().value());
+					lex.next();
+					// eat the value, building it in place
+					this->parse(lex, obj[key]);
+					// if there is a comma, there must be another "string : value"
+					// pair; otherwise we're done
+					if (token::comma != lex.kind())
+						break;
+					lex.next();
+				}
+			}
 			// had better be a }, if so, eat it
-			if (first == last)
+			if (token::eof == lex.kind())
 				throw expected_got("}","nothing");
-			if (token::curlyR != first->kind_)
-				throw expected_got("}",first->value_);
-			return ++first;
+			if (token::curlyR != lex.kind())
+				throw expected_got("}",lex.current().value());
+			lex.next();
 		}
 		// arrays are a simpler versino of objects, the format is easier,
 		// but also not regular:
 		//    array ::= `[` (value [, value]*)? `]`
 		// Note the nesting
-		tok_iter parse (tok_iter first, tok_iter last, array_t& arr) {
-			if (first == last) return last;
+		void parse (lexer& lex, array_t& arr) {
 			// eat the [
-			++first;
-			tok_iter prog;
-			value_t val; // list of values
-			do {
-				prog = this->parse(first, last, val);
-				if (prog == first) // maintain progress after looking for a value
-					break;
-				first = prog;
-				// eat the comma (,)
-				arr.push_back(val);
-				// if we see a comma there had best be another value
-				// (note it is because we eat this comma, then force progress on
-				//  the loop that we get an error: there is a trailing `]' instead
-				//  of a value!)
-				if (token::comma != first->kind_)
-					break;
-				else
-					++first;
-			} while (first != last);
-			if (first == last)
+			lex.next();
+			if (token::brakR != lex.kind()) {
+				value_t val; // list of values
+				while (true) {
+					// (note it is because we eat the comma, then demand a value
+					//  that we get an error: there is a trailing `]' instead
+					//  of a value!)
+					this->parse(lex, val);
+					arr.push_back(JSONPP_MOVE(val));
+					// if we see a comma there had best be another value
+					if (token::comma != lex.kind())
+						break;
+					lex.next();
+				}
+			}
+			if (token::eof == lex.kind())
 				throw expected_got("]", "nothing");
-			if (token::brakR != first->kind_)
-				throw expected_got("]", first->value_);
+			if (token::brakR != lex.kind())
+				throw expected_got("]", lex.current().value());
 			// eat the ]
-			return ++first;
+			lex.next();
 		}
 	};
-	// this kludginess allows us to easily look for identifiers
-	// welcome the wonderful world of Unicode!
-	static const char JSON__true[] = "true";
-	static const char JSON__false[] = "false";
-	static const char JSON__null[] = "null";
 	template <typename JsonType>
 	const std::string push_parser<JsonType>::True = std::string(JSON__true);
 	template <typename JsonType>
@@ -733,22 +1188,50 @@ namespace JSONpp {
 	bool operator == (nil const&, nil const&) { return true; }
 	bool operator != (nil const&, nil const&) { return false; }
 	
+	// Allocator is rebound for the objects and arrays (the strings bring
+	// their own, in String); see arena.hpp for one that puts a whole tree
+	// in an arena
+	template <typename Allocator, typename T>
+	struct rebind_allocator {
+		typedef typename Allocator::template rebind<T>::other type;
+	};
+	template <typename U, typename T>
+	struct rebind_allocator<std::allocator<U>,T> {
+		typedef std::allocator<T> type;
+	};
+	
+	// Objects picks the container of the members of an object: its
+	// apply<Key,Value,Allocator>::type, which must have the O[S] = V of
+	// json_traits; map_objects (the default) is a std::map, see flat_map.hpp
+	// for another
+	struct map_objects {
+		template <typename Key, typename Value, typename Allocator>
+		struct apply {
+			typedef std::map<Key,Value,std::less<Key>,
+				typename rebind_allocator<Allocator,std::pair<const Key,Value> >::type> type;
+		};
+	};
+	
 	template <typename String=std::string,
 						typename Double=double,
 						typename Bool=bool,
-						typename Null=nil>
+						typename Null=nil,
+						typename Allocator=std::allocator<char>,
+						typename Objects=map_objects>
 	struct make_json_value {
 		
 		typedef typename boost::make_recursive_variant<
 			String,Double,Bool,Null,
-			std::map<String,boost::recursive_variant_>,
-			std::vector<boost::recursive_variant_> >::type type;
+			typename Objects::template apply<String,boost::recursive_variant_,Allocator>::type,
+			std::vector<boost::recursive_variant_,
+				typename rebind_allocator<Allocator,boost::recursive_variant_>::type> >::type type;
 		
 		typedef type                            value_t;
 		typedef String                          string_t;
 		typedef Double                          number_t;
-		typedef std::map<String,type>           object_t;
-		typedef std::vector<type>               array_t;
+		typedef typename Objects::template apply<String,type,Allocator>::type object_t;
+		typedef std::vector<type,
+			typename rebind_allocator<Allocator,type>::type> array_t;
 		typedef Bool                            bool_t;
 		typedef Null                            null_t;
 	};
@@ -775,12 +1258,74 @@ namespace JSONpp {
 		return parser(first, last);
 	}
 	
-	json_v open (std::string const& filename) {
-		std::wifstream wifstr(filename.c_str());
-		wifstr >> std::noskipws;
-		std::istream_iterator<wchar_t,wchar_t> ctr(wifstr);
-		std::istream_iterator<wchar_t,wchar_t> cnd;
-		return JSONpp::parse(ctr, cnd);
+	//=== [FILE INPUT] ===
+	// The bytes of a file, for parsing in place: regular files are mapped
+	// read-only (and, unless told otherwise, the kernel is told we read them
+	// front to back), the rest -- pipes, sockets, ttys, and anything mmap
+	// refuses -- are read into a buffer.
+	class mapped_file {
+	public:
+		explicit mapped_file (std::string const& filename, bool sequential=true)
+			: map_(0), size_(0) {
+			const int fd = ::open(filename.c_str(), O_RDONLY);
+			if (fd < 0)
+				throw cannot_open(filename);
+			struct stat st;
+			if (0 == ::fstat(fd, &st) and S_ISREG(st.st_mode) and 0 < st.st_size) {
+				void *map = ::mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (MAP_FAILED != map) {
+					if (sequential)
+						::madvise(map, st.st_size, MADV_SEQUENTIAL);
+					this->map_ = map;
+					this->size_ = st.st_size;
+				}
+			}
+			if (not this->map_) {
+				char buffer[64*1024];
+				for (ssize_t n; 0 != (n = ::read(fd, buffer, sizeof(buffer))); ) {
+					if (n < 0) {
+						if (EINTR == errno) continue;
+						::close(fd);
+						throw cannot_open(filename);
+					}
+					this->buffer_.append(buffer, n);
+				}
+				this->size_ = this->buffer_.size();
+			}
+			::close(fd);
+		}
+		~mapped_file () {
+			if (this->map_)
+				::munmap(this->map_, this->size_);
+		}
+		
+		const char* begin () const {
+			return this->map_ ? (const char*)this->map_ : this->buffer_.data();
+		}
+		const char* end () const { return this->begin() + this->size_; }
+		std::size_t size () const { return this->size_; }
+		// whether the bytes are mapped (or were read)
+		bool mapped () const { return 0 != this->map_; }
+		
+	private:
+		mapped_file (mapped_file const&);
+		mapped_file& operator = (mapped_file const&);
+		
+		void *map_;
+		std::size_t size_;
+		std::string buffer_;
+	};
+	
+	// parses a whole file, straight from the mapped bytes
+	template <typename JSONType>
+	typename json_traits<JSONType>::value_t open (std::string const& filename) {
+		mapped_file file(filename);
+		JSONpp::push_parser<JSONType> parser;
+		return parser(file.begin(), file.end());
+	}
+	
+	inline json_v open (std::string const& filename) {
+		return JSONpp::open<json_v>(filename);
 	}
 
 	//=== [JSON IOMANIPULATOR] ===
@@ -797,6 +1342,7 @@ namespace JSONpp {
 			array_first   = 16, // new line before first element
 			object_first  = 32, // new line before first element
 			object_key    = 64, // new line after each key
+			decoded       = 128, // the strings are UTF-8 (see string_form)
 			standard      = readable | array_rc | object_rc | object_key,
 			std_ascii     = ascii | standard,
 			std_unicode   = unicode | standard,
@@ -805,6 +1351,10 @@ namespace JSONpp {
 			if (-1 == iomanipulator_::iword)
 				iomanipulator_::iword = std::ios_base::xalloc();
 		}
+		// both formats, e.g., std_unicode | decoded
+		friend iomanipulator_ operator | (iomanipulator_ const& L, iomanipulator_ const& R) {
+			return iomanipulator_(kinds(L.kind_ | R.kind_));
+		}
 		void set_format (std::ios_base& ios) const {
 			ios.iword(iomanipulator_::iword) = this->kind_;
 		}
@@ -825,6 +1375,7 @@ namespace JSONpp {
 	static const iomanipulator_ standard      = iomanipulator_(iomanipulator_::standard);
 	static const iomanipulator_ std_ascii     = iomanipulator_(iomanipulator_::std_ascii);
 	static const iomanipulator_ std_unicode   = iomanipulator_(iomanipulator_::std_unicode);;
+	static const iomanipulator_ decoded_strings = iomanipulator_(iomanipulator_::decoded);
 	
 	template <typename CharT>
 	std::basic_ostream<CharT>&
@@ -860,52 +1411,56 @@ namespace JSONpp {
 		
 		json_to_string () {}
 		
-		struct __detail : boost::static_visitor<string_t> {
-			string_t operator () (number_t const& N) const {
+		// The visitor appends everything to one string (out), so the text
+		// of a value is copied once, not once per level of nesting.
+		struct __detail : boost::static_visitor<void> {
+			void operator () (number_t const& N) const {
 				bsstream bss;
 				bss << N;
-				return bss.str();
+				*this->out += to_string_t(bss.str());
 			}
-			string_t operator () (string_t const& S) const {
-				return to_string_t("\"") + S + to_string_t("\"");
+			void operator () (string_t const& S) const {
+				*this->out += '\"';
+				escape(S, this->pretty, *this->out);
+				*this->out += '\"';
 			}
-			string_t operator () (bool_t const& B) const {
-				return to_string_t(B?"true":"false");
+			void operator () (bool_t const& B) const {
+				*this->out += to_string_t(B?"true":"false");
 			}
-			string_t operator () (null_t const& N) const {
-				return to_string_t("null");;
+			void operator () (null_t const& N) const {
+				*this->out += to_string_t("null");
 			}
-			string_t operator () (array_t const& A) const {
-				string_t result = to_string_t("[");
+			void operator () (array_t const& A) const {
+				string_t& result = *this->out;
+				result += '[';
 				*this->offset += 2;
 				for (std::size_t i=0; i<A.size(); ++i) {
 					if (0 == i) {
 						if (iomanipulator_::readable & this->pretty)
 							result += ' ';
 						if (iomanipulator_::object_first & this->pretty)
-							result += '\n' + string_t(*this->offset, ' ');
+							(result += '\n').append(*this->offset, ' ');
 					}
-					string_t lres = boost::apply_visitor(*this, A[i]);
-					result += lres;
+					boost::apply_visitor(*this, A[i]);
 					if (A.size() != (i+1)) {
 						result += ',';
 						if (iomanipulator_::readable & this->pretty)
 							result += ' ';
 						if (iomanipulator_::array_rc & this->pretty)
-							result += '\n' + string_t(*this->offset, ' ');
+							(result += '\n').append(*this->offset, ' ');
 					} else {
 						if (iomanipulator_::readable & this->pretty)
 							result += ' ';
 					}
 				}
 				*this->offset -= 2;
-				result += to_string_t("]");
-				return result;
+				result += ']';
 			}
-			string_t operator () (object_t const& O) const {
+			void operator () (object_t const& O) const {
 				typedef typename object_t::const_iterator c_iter;
 				
-				string_t result = to_string_t("{");
+				string_t& result = *this->out;
+				result += '{';
 				c_iter beg, end, fst, lst;
 				beg = fst = O.begin();
 				end = lst = O.end();
@@ -915,10 +1470,11 @@ namespace JSONpp {
 						if (iomanipulator_::readable & this->pretty)
 							result += ' ';
 						if (iomanipulator_::object_first & this->pretty)
-							result += '\n' + string_t(*this->offset, ' ');
+							(result += '\n').append(*this->offset, ' ');
 					}
-					string_t lres = '\"' + to_string_t(fst->first) + '\"';
-					result += lres;
+					const std::size_t key_start = result.size();
+					this->key(fst->first);
+					const std::size_t key_size = result.size() - key_start;
 					if (iomanipulator_::readable & this->pretty)
 						result += ' ';
 					result += ':';
@@ -926,12 +1482,12 @@ namespace JSONpp {
 						result += ' ';
 					if (iomanipulator_::object_key & this->pretty) {
 						result += '\n';
-						*this->offset += lres.size()/4+1;
-						result += string_t(*this->offset, ' ');
+						*this->offset += key_size/4+1;
+						result.append(*this->offset, ' ');
 					}
-					result += boost::apply_visitor(*this, fst->second);
+					boost::apply_visitor(*this, fst->second);
 					if (iomanipulator_::object_key & this->pretty) {
-						*this->offset -= lres.size()/4+1;
+						*this->offset -= key_size/4+1;
 					}
 					c_iter next = fst; ++next;
 					if (next != lst) {
@@ -939,27 +1495,57 @@ namespace JSONpp {
 						if (iomanipulator_::readable & this->pretty)
 							result += ' ';
 						if (iomanipulator_::object_rc & this->pretty)
-							result += '\n' + string_t(*this->offset, ' ');
+							(result += '\n').append(*this->offset, ' ');
 					} else {
 						if (iomanipulator_::readable & this->pretty)
 							result += ' ';
 					}
 				}
 				*this->offset -= 2;
-				result += to_string_t("}");
-				return result;
+				result += '}';
+			}
+			
+			// keys are printed like strings
+			void key (string_t const& K) const {
+				(*this)(K);
+			}
+			template <typename Key>
+			void key (Key const& K) const {
+				(*this)(to_string_t(K));
+			}
+			
+			// the text of a string: decoded strings are escaped for ascii or
+			// unicode output; folded ones have their escapes already (but in
+			// unicode, the escapes of non-ASCII become UTF-8 again)
+			static void escape (std::string const& S, signed long pretty, std::string& out) {
+				const bool unicode = (iomanipulator_::unicode & pretty);
+				if (iomanipulator_::decoded & pretty)
+					json_escape(S.data(), S.data()+S.size(), not unicode, out);
+				else
+					json_folded_escape(S.data(), S.data()+S.size(), unicode, out);
+			}
+			template <typename String, typename Out>
+			static void escape (String const& S, signed long pretty, Out& out) {
+				const std::string bytes(bel::begin(S), bel::end(S));
+				std::string escaped;
+				escape(bytes, pretty, escaped);
+				out += to_string_t(escaped);
 			}
 			
+			string_t*     out;
 			std::size_t*  offset;
 			signed long   pretty;
 		};
 		
 		string_t translate (value_t const& v, signed long pp=0) const {
+			string_t result;
 			std::size_t offset = 0;
 			__detail D;
 			D.pretty = pp;
 			D.offset = &offset;
-			return boost::apply_visitor(D, v);
+			D.out = &result;
+			boost::apply_visitor(D, v);
+			return result;
 		}
 	};
 	
@@ -0,0 +1,483 @@
+#include "jsonpp.hpp"
+// STL
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <vector>
+// C
+#include <stdint.h>
+
+#ifndef JSONPP_LAZY
+#define JSONPP_LAZY
+
+namespace JSONpp {
+
+	//=== [LAZY DOCUMENT] ===
+	// A document that is not parsed until it is looked at. parse() only
+	// finds where every token starts (the structural_index, the same the
+	// lexer uses), and keeps that and a pointer to the input; a value is
+	// an index into those positions, and a number, string or container is
+	// decoded when it is asked for. Going past a value that was not asked
+	// for (a member that is not the one wanted) skips its subtree by
+	// counting brackets in the positions, without looking at its text.
+	//
+	// So the cost of reading a few fields out of a big document is the
+	// index, plus the tokens between the root and those fields; but only
+	// what is read is checked, so a document with a mistake in a part that
+	// is never looked at reads without an error.
+	//
+	// The input is not copied: it has to outlive the document (and the
+	// values from it), e.g. a mapped_file. (Unlike the parser's, its keys
+	// have to be strings.) Positions are 32 bits, so a document has to be
+	// shorter than 4 GB; a longer one throws std::length_error.
+	class lazy_value;
+	class lazy_array;
+	class lazy_object;
+
+	class lazy_document {
+	public:
+		typedef std::vector<uint32_t> positions_t;
+
+		lazy_document () : first_(0), last_(0) {}
+
+		// index [first, last)
+		lazy_value parse (const char* first, const char* last);
+		lazy_value parse (std::string const& text);
+
+		// the top-level value
+		lazy_value root () const;
+		bool empty () const { return this->positions_.empty(); }
+		void clear () {
+			this->positions_.clear();
+			this->first_ = this->last_ = 0;
+		}
+
+		positions_t const& positions () const { return this->positions_; }
+		const char* begin () const { return this->first_; }
+		const char* end () const { return this->last_; }
+
+		// the character the token at `at' starts with
+		char at (std::size_t at) const {
+			if (this->positions_.size() <= at)
+				throw expected_got("value","nothing");
+			return this->first_[this->positions_[at]];
+		}
+		const char* text (std::size_t at) const { return this->first_ + this->positions_[at]; }
+
+		// the index just past the value at `at' (and all of its children)
+		std::size_t next (std::size_t at) const {
+			const char c = this->at(at);
+			if ('\"' == c)
+				return at+2;    // the opening and the closing quote
+			if ('{' != c and '[' != c)
+				return at+1;
+			std::size_t depth = 0;
+			const std::size_t n = this->positions_.size();
+			for ( ; at < n; ++at) {
+				switch (this->first_[this->positions_[at]]) {
+				case '{': case '[': ++depth; break;
+				case '}': case ']':
+					if (0 == --depth)
+						return at+1;
+					break;
+				case '\"': ++at; break;
+				default: break;
+				}
+			}
+			throw expected_got(('{' == c) ? "}" : "]", "nothing");
+		}
+
+	private:
+		lazy_document (lazy_document const&);
+		lazy_document& operator = (lazy_document const&);
+
+		// where the tokens of a document the index cannot take (comments)
+		// start, found by lexing it
+		void scan () {
+			lexer lex(this->first_, this->last_, false);
+			for ( ; token::eof != lex.kind(); lex.next()) {
+				token const& tok = lex.current();
+				if (token::string == tok.kind_) {
+					this->positions_.push_back(uint32_t(tok.first_-1 - this->first_));
+					this->positions_.push_back(uint32_t(tok.last_ - this->first_));
+				} else
+					this->positions_.push_back(uint32_t(tok.first_ - this->first_));
+			}
+		}
+
+		const char *first_, *last_;
+		positions_t positions_;
+	};
+
+	// one value of a lazy_document; kind() is what it is, as in the tape:
+	//   '"' string, 'd' number, 't' true, 'f' false, 'n' null,
+	//   '{' object, '[' array
+	class lazy_value {
+	public:
+		lazy_value () : doc_(0), index_(0) {}
+		lazy_value (lazy_document const& doc, std::size_t index) : doc_(&doc), index_(index) {}
+
+		char kind () const {
+			const char c = this->doc_->at(this->index_);
+			switch (c) {
+			case '\"': case '{': case '[': case 't': case 'f': case 'n':
+				return c;
+			case '-': case '0': case '1': case '2': case '3': case '4':
+			case '5': case '6': case '7': case '8': case '9':
+				return 'd';
+			default:
+				throw expected_got("value", std::string(1, c));
+			}
+		}
+		static const char* name (char k) {
+			switch (k) {
+			case '\"': return "string";
+			case 'd':  return "number";
+			case 't': case 'f': return "boolean";
+			case 'n':  return "null";
+			case '{':  return "object";
+			case '[':  return "array";
+			default:   return "nothing";
+			}
+		}
+		std::size_t index () const { return this->index_; }
+		// the index just past this value (and all of its children)
+		std::size_t next () const { return this->doc_->next(this->index_); }
+		lazy_document const& on () const { return *this->doc_; }
+
+		// the text of a string as it is written (without its quotes, escapes
+		// and all), and with its escapes decoded (UTF-8)
+		const char* data () const {
+			this->expect('\"');
+			return this->doc_->text(this->index_) + 1;
+		}
+		std::size_t length () const {
+			this->expect('\"');
+			this->doc_->at(this->index_+1);
+			return this->doc_->text(this->index_+1) - this->data();
+		}
+		std::string str () const {
+			const char *first = this->data();
+			return std::string(first, first + this->length());
+		}
+		std::string decoded () const {
+			std::string text;
+			const char *first = this->data();
+			json_unescape(first, first + this->length(), text);
+			return text;
+		}
+		double number () const {
+			this->expect('d');
+			const token tok = this->token_of();
+			double value;
+			number_decoder<double>::decode(tok.first_, tok.last_, value);
+			return value;
+		}
+		bool boolean () const {
+			const char k = this->kind();
+			if ('t' != k and 'f' != k)
+				throw expected_got("boolean", name(k));
+			if (token::boolean != this->token_of().kind_)
+				throw unknown_token(this->token_of().value());
+			return 't' == k;
+		}
+		bool is_null () const {
+			return 'n' == this->kind() and token::null == this->token_of().kind_;
+		}
+		lazy_array array () const;
+		lazy_object object () const;
+
+		// so that boost::apply_visitor (and so json_to_string) can visit it
+		// like a variant of the types in json_traits<lazy_value>
+		template <typename Visitor>
+		typename Visitor::result_type apply_visitor (Visitor& visitor) const;
+
+	private:
+		void expect (char k) const {
+			if (k != this->kind())
+				throw expected_got(name(k), name(this->kind()));
+		}
+		// the one token a scalar is (lexed from where it starts)
+		token token_of () const {
+			lexer lex(this->doc_->text(this->index_), this->doc_->end(), false);
+			return lex.current();
+		}
+
+		lazy_document const* doc_;
+		std::size_t index_;
+	};
+
+	// The elements of an array, in order. Its end is not known until it is
+	// reached, so end() is a sentinel that an iterator becomes on reaching
+	// the `]'; and, as for the tape, indexing remembers where it was.
+	class lazy_array {
+	public:
+		typedef lazy_value value_type;
+
+		class const_iterator {
+		public:
+			typedef std::forward_iterator_tag iterator_category;
+			typedef lazy_value                value_type;
+			typedef std::ptrdiff_t            difference_type;
+			typedef lazy_value const*         pointer;
+			typedef lazy_value const&         reference;
+
+			const_iterator () : done_(true) {}
+			const_iterator (lazy_document const& doc, std::size_t index)
+				: value_(doc, index), done_(']' == doc.at(index)) {}
+
+			reference operator * () const { return this->value_; }
+			pointer operator -> () const { return &this->value_; }
+			const_iterator& operator ++ () {
+				lazy_document const& doc = this->value_.on();
+				const std::size_t after = this->value_.next();
+				switch (doc.at(after)) {
+				case ',': this->value_ = lazy_value(doc, after+1); break;
+				case ']': this->done_ = true; break;
+				default: throw expected_got("]", std::string(1, doc.at(after)));
+				}
+				return *this;
+			}
+			const_iterator operator ++ (int) {
+				const_iterator previous = *this;
+				++*this;
+				return previous;
+			}
+			friend bool operator == (const_iterator const& L, const_iterator const& R) {
+				return (L.done_ and R.done_)
+					or (not L.done_ and not R.done_ and L.value_.index() == R.value_.index());
+			}
+			friend bool operator != (const_iterator const& L, const_iterator const& R) {
+				return not (L == R);
+			}
+
+		private:
+			lazy_value value_;
+			bool done_;
+		};
+		typedef const_iterator iterator;
+
+		lazy_array (lazy_document const& doc, std::size_t index)
+			: doc_(&doc), index_(index), at_(0), cursor_(doc, index+1) {}
+
+		const_iterator begin () const { return const_iterator(*this->doc_, this->index_+1); }
+		const_iterator end () const { return const_iterator(); }
+		bool empty () const { return this->begin() == this->end(); }
+		// (a walk over the elements)
+		std::size_t size () const { return std::distance(this->begin(), this->end()); }
+
+		lazy_value const& operator [] (std::size_t i) const {
+			if (i < this->at_) {
+				this->at_ = 0;
+				this->cursor_ = const_iterator(*this->doc_, this->index_+1);
+			}
+			for ( ; this->at_ < i and this->cursor_ != this->end(); ++this->at_)
+				++this->cursor_;
+			if (this->cursor_ == this->end())
+				throw expected_got("value", "]");
+			return *this->cursor_;
+		}
+
+	private:
+		lazy_document const* doc_;
+		std::size_t index_;
+		mutable std::size_t at_;        // the element cursor_ is on
+		mutable const_iterator cursor_;
+	};
+
+	// The members of an object, in document order, as (key, value) pairs.
+	class lazy_object {
+	public:
+		struct member {
+			std::string first;
+			lazy_value second;
+		};
+		typedef member value_type;
+
+		// the key is only copied out into ->first when it is asked for
+		class const_iterator {
+		public:
+			typedef std::forward_iterator_tag iterator_category;
+			typedef member                    value_type;
+			typedef std::ptrdiff_t            difference_type;
+			typedef member const*             pointer;
+			typedef member const&             reference;
+
+			const_iterator () : doc_(0), index_(0), done_(true), loaded_(false) {}
+			const_iterator (lazy_document const& doc, std::size_t index)
+				: doc_(&doc), index_(index), done_('}' == doc.at(index)), loaded_(false) {
+				if (not this->done_)
+					this->colon();
+			}
+
+			lazy_value key () const { return lazy_value(*this->doc_, this->index_); }
+			lazy_value value () const { return lazy_value(*this->doc_, this->value_); }
+
+			reference operator * () const {
+				if (not this->loaded_) {
+					this->member_.first = this->key().str();
+					this->member_.second = this->value();
+					this->loaded_ = true;
+				}
+				return this->member_;
+			}
+			pointer operator -> () const { return &**this; }
+			const_iterator& operator ++ () {
+				const std::size_t after = this->doc_->next(this->value_);
+				switch (this->doc_->at(after)) {
+				case ',':
+					this->index_ = after+1;
+					this->colon();
+					break;
+				case '}': this->done_ = true; break;
+				default: throw expected_got("}", std::string(1, this->doc_->at(after)));
+				}
+				this->loaded_ = false;
+				return *this;
+			}
+			const_iterator operator ++ (int) {
+				const_iterator previous = *this;
+				++*this;
+				return previous;
+			}
+			friend bool operator == (const_iterator const& L, const_iterator const& R) {
+				return (L.done_ and R.done_)
+					or (not L.done_ and not R.done_ and L.index_ == R.index_);
+			}
+			friend bool operator != (const_iterator const& L, const_iterator const& R) {
+				return not (L == R);
+			}
+
+		private:
+			// check the key and the colon after it, and find the value
+			void colon () {
+				const char k = this->key().kind();
+				if ('\"' != k)
+					throw expected_got("string", lazy_value::name(k));
+				const std::size_t at = this->doc_->next(this->index_);
+				if (':' != this->doc_->at(at))
+					throw expected_got(":", std::string(1, this->doc_->at(at)));
+				this->value_ = at+1;
+			}
+
+			lazy_document const* doc_;
+			std::size_t index_, value_;   // of the key, and of the value
+			bool done_;
+			mutable bool loaded_;
+			mutable member member_;
+		};
+		typedef const_iterator iterator;
+
+		lazy_object (lazy_document const& doc, std::size_t index) : doc_(&doc), index_(index) {}
+
+		const_iterator begin () const { return const_iterator(*this->doc_, this->index_+1); }
+		const_iterator end () const { return const_iterator(); }
+		bool empty () const { return this->begin() == this->end(); }
+		// (a walk over the members)
+		std::size_t size () const { return std::distance(this->begin(), this->end()); }
+
+		// the first member with the key (as it is written, escapes and all),
+		// or end(); the members before it are skipped, not decoded
+		const_iterator find (const char* key, std::size_t length) const {
+			const_iterator at = this->begin(), last = this->end();
+			for ( ; at != last; ++at) {
+				const lazy_value k = at.key();
+				if (k.length() == length
+						and 0 == std::memcmp(k.data(), key, length))
+					break;
+			}
+			return at;
+		}
+		const_iterator find (std::string const& key) const {
+			return this->find(key.data(), key.size());
+		}
+
+	private:
+		lazy_document const* doc_;
+		std::size_t index_;
+	};
+
+	inline lazy_value lazy_document::parse (const char* first, const char* last) {
+		this->clear();
+		// the positions are 32 bits, whether they come from the index or
+		// from scan()
+		if (std::size_t(last - first) >= 0xFFFFFFFFu)
+			throw std::length_error("JSON document too long for a lazy_document");
+		this->first_ = first;
+		this->last_ = last;
+		structural_index index;
+		if (index.build(first, last))
+			index.release(this->positions_);
+		else
+			this->scan();
+		if (this->positions_.empty()) {
+			this->clear();
+			throw expected_got("value","nothing");
+		}
+		return this->root();
+	}
+
+	inline lazy_value lazy_document::parse (std::string const& text) {
+		return this->parse(text.data(), text.data()+text.size());
+	}
+
+	inline lazy_value lazy_document::root () const {
+		return lazy_value(*this, 0);
+	}
+
+	inline lazy_array lazy_value::array () const {
+		this->expect('[');
+		return lazy_array(*this->doc_, this->index_);
+	}
+	inline lazy_object lazy_value::object () const {
+		this->expect('{');
+		return lazy_object(*this->doc_, this->index_);
+	}
+
+	template <typename Visitor>
+	typename Visitor::result_type lazy_value::apply_visitor (Visitor& visitor) const {
+		switch (this->kind()) {
+		case '\"': {
+			const std::string text = this->str();
+			return visitor(text);
+		}
+		case 'd': {
+			const double number = this->number();
+			return visitor(number);
+		}
+		case 't': case 'f': {
+			const bool boolean = this->boolean();
+			return visitor(boolean);
+		}
+		case '{': {
+			const lazy_object object = this->object();
+			return visitor(object);
+		}
+		case '[': {
+			const lazy_array array = this->array();
+			return visitor(array);
+		}
+		default: {
+			if (not this->is_null())
+				throw unknown_token(this->token_of().value());
+			const nil null = nil();
+			return visitor(null);
+		}
+		}
+	}
+
+	template <>
+	struct json_traits<lazy_value> {
+		typedef lazy_value                    value_t;
+		typedef std::string                   string_t;
+		typedef double                        number_t;
+		typedef lazy_object                   object_t;
+		typedef lazy_array                    array_t;
+		typedef bool                          bool_t;
+		typedef nil                           null_t;
+	};
+
+}
+
+#endif//JSONPP_LAZY
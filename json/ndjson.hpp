@@ -0,0 +1,254 @@
+#include "jsonpp.hpp"
+// STL
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <sstream>
+#include <string>
+#include <vector>
+// POSIX
+#include <pthread.h>
+#include <unistd.h>
+
+#ifndef JSONPP_NDJSON
+#define JSONPP_NDJSON
+
+namespace JSONpp {
+
+	//=== [NEWLINE-DELIMITED JSON] ===
+	// A buffer of JSON values, one per line (JSON Lines, NDJSON), parsed by
+	// a pool of worker threads. The buffer is cut into chunks on line
+	// boundaries; the workers take the next chunk as they finish the last
+	// one, and the results are delivered on the calling thread, in input
+	// order, to a callback:
+	//
+	//    ndjson_parser<json_v> parser;  // one worker per CPU
+	//    parser.parse(first, last, callback); // callback(line, value)
+	//
+	// or all collected into a vector. Blank lines are skipped. Workers run at
+	// most a few chunks ahead of the callback, so a slow consumer does not
+	// make the parsed-but-undelivered values pile up.
+	//
+	// A record that fails to parse (and a line with more than one value on
+	// it) stops the whole parse with a record_error naming its line; the records before it have all been
+	// delivered, those after it have not.
+	struct record_error : std::exception {
+		std::string message;
+		std::size_t line;
+		record_error (std::size_t line, std::string const& what) : line(line) {
+			std::ostringstream ostr;
+			ostr << "Line " << line << ": " << what;
+			this->message = ostr.str();
+		}
+		virtual ~record_error () throw() {}
+		virtual const char* what () const throw() {
+			return this->message.c_str();
+		}
+	};
+
+	template <typename JSONType>
+	class ndjson_parser {
+	public:
+		typedef typename json_traits<JSONType>::value_t value_t;
+
+		// workers=0 means one per CPU; chunk is the (rough) number of bytes
+		// handed to a worker at a time
+		explicit ndjson_parser (std::size_t workers=0, std::size_t chunk=256*1024)
+			: workers_(workers ? workers : cpus()), chunk_(chunk ? chunk : 1) {}
+
+		std::size_t workers () const { return this->workers_; }
+
+		// callback(line, value) for each record, in order; line is 1-based
+		template <typename Callback>
+		Callback& parse (const char* first, const char* last, Callback& callback) {
+			job work;
+			this->split(first, last, work);
+			work.window = 4*this->workers_;
+
+			std::vector<pthread_t> threads(std::min(this->workers_, work.chunks.size()));
+			std::size_t started = 0;
+			for ( ; started < threads.size(); ++started)
+				if (0 != pthread_create(&threads[started], 0, &ndjson_parser::worker, &work))
+					break;
+			if (0 == started and not work.chunks.empty()) // no threads: do it here
+				work.window = work.chunks.size();
+
+			try {
+				std::size_t line = 1;
+				for (std::size_t c=0; c<work.chunks.size(); ++c) {
+					chunk& ch = work.chunks[c];
+					if (0 == started)
+						parse_chunk(ch);
+					pthread_mutex_lock(&work.mutex);
+					while (not ch.done)
+						pthread_cond_wait(&work.cond, &work.mutex);
+					pthread_mutex_unlock(&work.mutex);
+
+					for (std::size_t r=0; r<ch.values.size(); ++r)
+						callback(line + ch.lines[r], ch.values[r]);
+					if (ch.failed)
+						throw record_error(line + ch.error_line, ch.error);
+					line += ch.line_count;
+					std::deque<value_t>().swap(ch.values);
+					std::vector<std::size_t>().swap(ch.lines);
+
+					pthread_mutex_lock(&work.mutex);
+					work.delivered = c+1;
+					pthread_cond_broadcast(&work.cond);
+					pthread_mutex_unlock(&work.mutex);
+				}
+			} catch (...) {
+				stop(work, threads, started);
+				throw;
+			}
+			stop(work, threads, started);
+			return callback;
+		}
+
+		// all the records, in order
+		std::vector<value_t> parse (const char* first, const char* last) {
+			collector collect;
+			this->parse(first, last, collect);
+			std::vector<value_t> values(collect.values.size());
+			for (std::size_t i=0; i<values.size(); ++i)
+				std::swap(values[i], collect.values[i]);
+			return values;
+		}
+
+	private:
+		// a piece of the input, and what became of it
+		struct chunk {
+			chunk () : first(0), last(0), done(false), failed(false),
+				line_count(0), error_line(0) {}
+			const char *first, *last;
+			bool done, failed;
+			std::size_t line_count;           // newlines in [first,last)
+			std::deque<value_t> values;       // a vector would copy them to grow
+			std::vector<std::size_t> lines;   // the line of each value, from 0
+			std::size_t error_line;
+			std::string error;
+		};
+
+		// what the workers share
+		struct job {
+			job () : next(0), delivered(0), window(1), stopped(false) {
+				pthread_mutex_init(&this->mutex, 0);
+				pthread_cond_init(&this->cond, 0);
+			}
+			~job () {
+				pthread_cond_destroy(&this->cond);
+				pthread_mutex_destroy(&this->mutex);
+			}
+			pthread_mutex_t mutex;
+			pthread_cond_t cond;
+			std::vector<chunk> chunks;
+			std::size_t next;       // the next chunk to hand out
+			std::size_t delivered;  // the chunks the callback is done with
+			std::size_t window;     // how far ahead of delivered to go
+			bool stopped;
+		};
+
+		struct collector {
+			void operator () (std::size_t, value_t& value) {
+				this->values.push_back(value_t());
+				std::swap(this->values.back(), value);
+			}
+			std::deque<value_t> values;
+		};
+
+		static std::size_t cpus () {
+			const long n = sysconf(_SC_NPROCESSORS_ONLN);
+			return (0 < n) ? n : 1;
+		}
+
+		// cut [first,last) into chunks ending just after a newline
+		void split (const char* first, const char* last, job& work) const {
+			while (first != last) {
+				const char *cut = last;
+				if (std::size_t(last - first) > this->chunk_) {
+					const char *nl = (const char*)std::memchr(first + this->chunk_, '\n',
+																										last - first - this->chunk_);
+					if (nl) cut = nl+1;
+				}
+				work.chunks.push_back(chunk());
+				work.chunks.back().first = first;
+				work.chunks.back().last = cut;
+				first = cut;
+			}
+		}
+
+		static void* worker (void* arg) {
+			job& work = *static_cast<job*>(arg);
+			while (true) {
+				pthread_mutex_lock(&work.mutex);
+				while (not work.stopped and work.next < work.chunks.size()
+							 and work.next >= work.delivered + work.window)
+					pthread_cond_wait(&work.cond, &work.mutex);
+				if (work.stopped or work.next == work.chunks.size()) {
+					pthread_mutex_unlock(&work.mutex);
+					return 0;
+				}
+				chunk& ch = work.chunks[work.next++];
+				pthread_mutex_unlock(&work.mutex);
+
+				parse_chunk(ch);
+
+				pthread_mutex_lock(&work.mutex);
+				ch.done = true;
+				pthread_cond_broadcast(&work.cond);
+				pthread_mutex_unlock(&work.mutex);
+			}
+		}
+
+		static void parse_chunk (chunk& ch) {
+			push_parser<JSONType> parser;
+			std::size_t line = 0;
+			for (const char *first = ch.first; first != ch.last; ++line) {
+				const char *eol = (const char*)std::memchr(first, '\n', ch.last - first);
+				const char *next = eol ? eol+1 : ch.last;
+				if (not eol) eol = ch.last;
+				if (not blank(first, eol)) {
+					try {
+						ch.values.push_back(value_t());
+						ch.values.back() = parser.parse_one(first, eol);
+						ch.lines.push_back(line);
+					} catch (std::exception& e) {
+						ch.values.pop_back();
+						ch.failed = true; ch.error_line = line; ch.error = e.what();
+						break;
+					} catch (...) {
+						ch.values.pop_back();
+						ch.failed = true; ch.error_line = line; ch.error = "unknown error";
+						break;
+					}
+				}
+				first = next;
+			}
+			ch.line_count = line;
+		}
+
+		static bool blank (const char* first, const char* last) {
+			for ( ; first != last; ++first)
+				switch (*first) {
+				case ' ': case '\t': case '\r': case '\v': case '\f': break;
+				default: return false;
+				}
+			return true;
+		}
+
+		static void stop (job& work, std::vector<pthread_t>& threads, std::size_t started) {
+			pthread_mutex_lock(&work.mutex);
+			work.stopped = true;
+			pthread_cond_broadcast(&work.cond);
+			pthread_mutex_unlock(&work.mutex);
+			for (std::size_t t=0; t<started; ++t)
+				pthread_join(threads[t], 0);
+		}
+
+		std::size_t workers_;
+		std::size_t chunk_;
+	};
+
+}
+
+#endif//JSONPP_NDJSON
@@ -0,0 +1,232 @@
+#include "jsonpp.hpp"
+// STL
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+
+#ifndef JSONPP_LOSSLESS_NUMBER
+#define JSONPP_LOSSLESS_NUMBER
+
+namespace JSONpp {
+
+	//=== [LOSSLESS NUMBERS] ===
+	// A number_t for make_json_value that does not squeeze everything
+	// through a double. The representation is picked at parse time from
+	// the shape of the token:
+	//   1. integers (no fraction, no exponent) that fit are kept exactly
+	//      as a signed (int64) or, if they only fit unsigned, as uint64
+	//   2. other numbers (and -0) become a double, when that loses nothing:
+	//      at most 15 significant digits (every such decimal comes back
+	//      from its double; longer ones need not), and in range
+	//   3. everything else -- integers beyond 64 bits, longer fractions,
+	//      exponents out of range -- keeps its decimal text as written
+	// Printing gives back the exact integer, the shortest text that reads
+	// back as the same double, or the original decimal text.
+	class json_number {
+	public:
+		enum kind {
+			int64,
+			uint64,
+			real,
+			decimal,
+		};
+
+		json_number () : kind_(int64) { this->value_.i = 0; }
+		json_number (int i) : kind_(int64) { this->value_.i = i; }
+		json_number (long long i) : kind_(int64) { this->value_.i = i; }
+		json_number (unsigned long long u) : kind_(uint64) { this->value_.u = u; }
+		json_number (double d) : kind_(real) { this->value_.d = d; }
+
+		// [first,last) is the text of a JSON number (as checked by the lexer)
+		static json_number from_text (const char* first, const char* last) {
+			json_number num;
+			const char *c = first;
+			const bool negative = ('-' == *c);
+			if (negative) ++c;
+			// the integer part; the significant digits run from the first
+			// digit that is not 0 to the last one that is not 0
+			unsigned long long magnitude = 0;
+			bool overflow = false;
+			std::size_t run = 0, significant = 0;
+			for ( ; c != last and '0' <= *c and *c <= '9'; ++c) {
+				const unsigned digit = *c - '0';
+				if (magnitude > (std::numeric_limits<unsigned long long>::max() - digit)/10)
+					overflow = true;
+				else
+					magnitude = 10*magnitude + digit;
+				if (0 != run or 0 != digit)
+					++run;
+				if (0 != digit)
+					significant = run;
+			}
+			if (c == last and negative and 0 == magnitude and not overflow) {
+				num.kind_ = real; // -0, which an integer would lose the sign of
+				num.value_.d = -0.0;
+				return num;
+			}
+			if (c == last) { // an integer
+				const unsigned long long limit = (unsigned long long)
+					std::numeric_limits<long long>::max() + (negative ? 1 : 0);
+				if (overflow or (negative and magnitude > limit)) {
+					num.kind_ = decimal;
+					num.text_.assign(first, last);
+				} else if (magnitude <= limit) {
+					num.kind_ = int64;
+					num.value_.i = negative ? (long long)(0-magnitude) : (long long)magnitude;
+				} else {
+					num.kind_ = uint64;
+					num.value_.u = magnitude;
+				}
+				return num;
+			}
+			// the fraction
+			if ('.' == *c)
+				for (++c; c != last and '0' <= *c and *c <= '9'; ++c) {
+					if (0 != run or '0' != *c)
+						++run;
+					if ('0' != *c)
+						significant = run;
+				}
+			double d = 0;
+			number_decoder<double>::decode(first, last, d);
+			const bool zero = (0 == significant);
+			if (significant <= 15 and std::abs(d) <= std::numeric_limits<double>::max()
+					and (0 != d or zero)) {
+				num.kind_ = real;
+				num.value_.d = d;
+			} else {
+				num.kind_ = decimal;
+				num.text_.assign(first, last);
+			}
+			return num;
+		}
+
+		kind which () const { return this->kind_; }
+		bool is_integer () const { return int64 == this->kind_ or uint64 == this->kind_; }
+
+		// conversions; the integers are exact when the kind matches
+		long long as_int64 () const {
+			switch (this->kind_) {
+			case int64: return this->value_.i;
+			case uint64: return (long long)this->value_.u;
+			case real: return (long long)this->value_.d;
+			default: return std::strtoll(this->text_.c_str(), 0, 10);
+			}
+		}
+		unsigned long long as_uint64 () const {
+			switch (this->kind_) {
+			case int64: return (unsigned long long)this->value_.i;
+			case uint64: return this->value_.u;
+			case real: return (unsigned long long)this->value_.d;
+			default: return std::strtoull(this->text_.c_str(), 0, 10);
+			}
+		}
+		double as_double () const {
+			switch (this->kind_) {
+			case int64: return double(this->value_.i);
+			case uint64: return double(this->value_.u);
+			case real: return this->value_.d;
+			default: {
+				double d = 0;
+				number_decoder<double>::decode(this->text_.data(),
+																			 this->text_.data()+this->text_.size(), d);
+				return d;
+			}
+			}
+		}
+		// the text of a decimal (empty for the other kinds)
+		std::string const& text () const { return this->text_; }
+
+		friend bool operator == (json_number const& L, json_number const& R) {
+			if (L.kind_ != R.kind_)
+				return false;
+			switch (L.kind_) {
+			case int64: return L.value_.i == R.value_.i;
+			case uint64: return L.value_.u == R.value_.u;
+			case real: return L.value_.d == R.value_.d;
+			default: return L.text_ == R.text_;
+			}
+		}
+		friend bool operator != (json_number const& L, json_number const& R) {
+			return not (L == R);
+		}
+
+		template <typename CharT>
+		friend std::basic_ostream<CharT>&
+		operator << (std::basic_ostream<CharT>& bostr, json_number const& num) {
+			switch (num.kind_) {
+			case int64: bostr << num.value_.i; break;
+			case uint64: bostr << num.value_.u; break;
+			case real: bostr << shortest(num.value_.d).c_str(); break;
+			default: bostr << num.text_.c_str(); break;
+			}
+			return bostr;
+		}
+		// reads one number token
+		template <typename CharT>
+		friend std::basic_istream<CharT>&
+		operator >> (std::basic_istream<CharT>& bistr, json_number& num) {
+			std::basic_string<CharT> word;
+			if (bistr >> word) {
+				std::string text(word.begin(), word.end());
+				num = from_text(text.data(), text.data()+text.size());
+			}
+			return bistr;
+		}
+
+	private:
+		// the shortest of %.15g, %.16g, %.17g that reads back exactly
+		static std::string shortest (double d) {
+			std::string text;
+			for (int precision=15; precision<=17; ++precision) {
+				std::ostringstream oss;
+				oss.imbue(std::locale::classic());
+				oss.precision(precision);
+				oss << d;
+				text = oss.str();
+				double back = 0;
+				number_decoder<double>::decode(text.data(), text.data()+text.size(), back);
+				if (back == d)
+					break;
+			}
+			return text;
+		}
+
+		kind kind_;
+		union {
+			long long i;
+			unsigned long long u;
+			double d;
+		} value_;
+		std::string text_;
+	};
+
+	// the parser builds json_numbers straight from the token
+	template <>
+	struct number_decoder<json_number> {
+		static void decode (const char* first, const char* last, json_number& num) {
+			num = json_number::from_text(first, last);
+		}
+	};
+
+	// the default JSON type, but with lossless numbers
+	typedef make_json_value<std::string,json_number> json_lossless_gen;
+	typedef json_lossless_gen::value_t json_lossless_v;
+
+	template <>
+	struct json_traits<json_lossless_v> {
+		typedef json_lossless_v                        value_t;
+		typedef std::string                            string_t;
+		typedef json_number                            number_t;
+		typedef std::map<std::string,json_lossless_v>  object_t;
+		typedef std::vector<json_lossless_v>           array_t;
+		typedef bool                                   bool_t;
+		typedef nil                                    null_t;
+	};
+
+}
+
+#endif//JSONPP_LOSSLESS_NUMBER
@@ -0,0 +1,207 @@
+#include "jsonpp.hpp"
+// STL
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+// POSIX
+#include <pthread.h>
+#include <unistd.h>
+
+#ifndef JSONPP_PARALLEL
+#define JSONPP_PARALLEL
+
+namespace JSONpp {
+
+	//=== [PARALLEL ARRAYS] ===
+	// A document that is one big array, parsed by a pool of worker threads:
+	// the structural index finds the commas between the elements (the ones
+	// at depth 1), the elements are cut into chunks of about `chunk' bytes
+	// on those commas, the workers parse a chunk at a time, and the values
+	// are moved into the one array_t, in order.
+	//
+	//    parallel_parser<json_v> parser;      // one worker per CPU
+	//    json_v doc = parser(first, last);
+	//
+	// Anything else -- a document that is not an array, a small one, one
+	// with comments (the index cannot take those) -- is parsed by the one
+	// push_parser. So is a document with a mistake in it: when a chunk
+	// fails the whole input is parsed again by the serial parser, which
+	// throws what it would have thrown had it been used in the first place
+	// (and from the same position).
+	//
+	// The workers build values with no arena or string_pool in scope.
+	template <typename JSONType>
+	class parallel_parser {
+	public:
+		typedef json_traits<JSONType> traits;
+		typedef typename traits::value_t      value_t;
+		typedef typename traits::array_t      array_t;
+
+		// workers=0 means one per CPU
+		explicit parallel_parser (std::size_t workers=0, std::size_t chunk=1024*1024,
+															string_form form=folded)
+			: workers_(workers ? workers : cpus()), chunk_(chunk ? chunk : 1), form_(form) {}
+
+		std::size_t workers () const { return this->workers_; }
+
+		value_t operator () (const char* first, const char* last) {
+			return this->parse(first, last);
+		}
+		value_t operator () (std::string const& text) {
+			return this->parse(text.data(), text.data()+text.size());
+		}
+
+		value_t parse (const char* first, const char* last) {
+			// the same checks (and transcoding) of the input as the serial
+			// parser does, so a bad encoding throws the same
+			const char *begin = first, *end = last;
+			std::string scratch;
+			if (decoded == this->form_)
+				utf_8_text(begin, end, scratch);
+			else
+				json_ascii(begin, end, scratch);
+
+			job work;
+			if (not this->split(begin, end, work))
+				return this->serial(first, last);
+
+			std::vector<pthread_t> threads(std::min(this->workers_, work.chunks.size()));
+			std::size_t started = 0;
+			for ( ; started < threads.size(); ++started)
+				if (0 != pthread_create(&threads[started], 0, &parallel_parser::worker, &work))
+					break;
+			if (0 == started) // no threads: do it here
+				worker(&work);
+			for (std::size_t t=0; t<started; ++t)
+				pthread_join(threads[t], 0);
+
+			std::size_t total = 0;
+			for (std::size_t c=0; c<work.chunks.size(); ++c) {
+				if (work.chunks[c].failed)
+					return this->serial(first, last);
+				total += work.chunks[c].values.size();
+			}
+
+			array_t array;
+			reserve(array, total);
+			for (std::size_t c=0; c<work.chunks.size(); ++c) {
+				std::deque<value_t>& values = work.chunks[c].values;
+				for (typename std::deque<value_t>::iterator v=values.begin(); v!=values.end(); ++v) {
+					array.push_back(value_t());
+					using std::swap;
+					swap(array.back(), *v);
+				}
+				std::deque<value_t>().swap(values);
+			}
+			value_t result;
+			result = JSONPP_MOVE(array);
+			return result;
+		}
+
+	private:
+		// some elements of the array (and their commas), and what became of
+		// them
+		struct chunk {
+			chunk () : first(0), last(0), failed(false) {}
+			const char *first, *last;
+			bool failed;
+			std::deque<value_t> values;   // a vector would copy them to grow
+		};
+
+		// what the workers share
+		struct job {
+			job () : next(0), form(folded) { pthread_mutex_init(&this->mutex, 0); }
+			~job () { pthread_mutex_destroy(&this->mutex); }
+			pthread_mutex_t mutex;
+			std::vector<chunk> chunks;
+			std::size_t next;       // the next chunk to hand out
+			string_form form;
+		};
+
+		static std::size_t cpus () {
+			const long n = sysconf(_SC_NPROCESSORS_ONLN);
+			return (0 < n) ? n : 1;
+		}
+
+		// cut the elements of the array [first,last) into chunks, on the
+		// commas at depth 1; false if it is not one array worth cutting up
+		bool split (const char* first, const char* last, job& work) const {
+			if (std::size_t(last - first) < 2*this->chunk_)
+				return false;
+			structural_index index;
+			if (not index.build(first, last))
+				return false;
+			structural_index::positions_t const& positions = index.positions();
+			if (positions.empty() or '[' != first[positions[0]])
+				return false;
+			work.form = this->form_;
+			const char *start = first + positions[0] + 1;
+			std::size_t depth = 1, p = 1;
+			for ( ; p < positions.size(); ++p) {
+				const char *at = first + positions[p];
+				switch (*at) {
+				case '{': case '[': ++depth; break;
+				case '}': case ']': --depth; break;
+				case ',':
+					if (1 == depth and std::size_t(at - start) >= this->chunk_) {
+						work.chunks.push_back(chunk());
+						work.chunks.back().first = start;
+						work.chunks.back().last = at;
+						start = at+1;
+					}
+					break;
+				default: break;
+				}
+				if (0 == depth)
+					break;
+			}
+			// the array has to close, with nothing after it
+			if (p+1 != positions.size() or ']' != first[positions[p]])
+				return false;
+			work.chunks.push_back(chunk());
+			work.chunks.back().first = start;
+			work.chunks.back().last = first + positions[p];
+			return 1 < work.chunks.size();
+		}
+
+		static void* worker (void* arg) {
+			job& work = *static_cast<job*>(arg);
+			push_parser<JSONType> parser(work.form);
+			while (true) {
+				pthread_mutex_lock(&work.mutex);
+				if (work.next == work.chunks.size()) {
+					pthread_mutex_unlock(&work.mutex);
+					return 0;
+				}
+				chunk& ch = work.chunks[work.next++];
+				pthread_mutex_unlock(&work.mutex);
+				try {
+					parser.parse_elements(ch.first, ch.last, ch.values);
+				} catch (...) {
+					ch.failed = true;
+					std::deque<value_t>().swap(ch.values);
+				}
+			}
+		}
+
+		value_t serial (const char* first, const char* last) const {
+			push_parser<JSONType> parser(this->form_);
+			return parser(first, last);
+		}
+
+		// a vector is given its size first, so that it does not copy the
+		// elements as it grows
+		template <typename T, typename A>
+		static void reserve (std::vector<T,A>& array, std::size_t n) { array.reserve(n); }
+		template <typename Array>
+		static void reserve (Array&, std::size_t) {}
+
+		std::size_t workers_;
+		std::size_t chunk_;
+		string_form form_;
+	};
+
+}
+
+#endif//JSONPP_PARALLEL
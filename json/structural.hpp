@@ -0,0 +1,238 @@
+// STL
+#include <cstring>
+#include <vector>
+// C
+#include <stdint.h>
+// SIMD
+#if !defined(JSONPP_NO_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+#define JSONPP_STRUCTURAL_AVX2
+#elif !defined(JSONPP_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define JSONPP_STRUCTURAL_SSE2
+#endif
+
+#ifndef JSONPP_STRUCTURAL_INDEX
+#define JSONPP_STRUCTURAL_INDEX
+
+namespace JSONpp {
+
+	//=== [STRUCTURAL INDEX] ===
+	// The first stage of lexing a large buffer: find, without looking at
+	// the bytes one at a time, the position of every character a token can
+	// start on. These are
+	//   1. the structural characters { } [ ] : , outside of strings
+	//   2. both quotes of every string (escaped quotes are not quotes)
+	//   3. the first character of every other run of non-whitespace outside
+	//      of a string, i.e., the start of numbers and identifiers
+	// Everything else is whitespace, the inside of a string, or the tail of
+	// a number or identifier, so the lexer can jump straight from one
+	// position to the next.
+	//
+	// The buffer is classified 64 bytes at a time into bit-masks (with AVX2
+	// or SSE2 compares when the compiler has them, with a table otherwise;
+	// define JSONPP_NO_SIMD to force the table). Which quotes open and which
+	// close a string is the prefix-xor of the unescaped quote mask.
+	//
+	// Comments cannot be told apart from the rest of the text this way, so
+	// if there is a '/' or '#' outside of a string the index gives up and
+	// build() returns false; the lexer then falls back to scanning.
+	class structural_index {
+	public:
+		typedef std::vector<uint32_t> positions_t;
+
+		structural_index () : count_(0), escapes_(false) {}
+
+		// index [first,last); false means the index cannot be used
+		bool build (const char* first, const char* last) {
+			this->count_ = 0;
+			this->escapes_ = false;
+			const std::size_t size = last - first;
+			if (size >= 0xFFFFFFFFu) // positions are 32 bits
+				return false;
+			this->positions_.resize(size/8 + 64);
+
+			state st;
+			std::size_t offset = 0;
+			for ( ; offset + 64 <= size; offset += 64)
+				if (not this->block(first + offset, offset, st))
+					return false;
+			if (offset < size) {
+				// pad the tail with whitespace
+				char tail[64];
+				std::memset(tail, ' ', sizeof(tail));
+				std::memcpy(tail, first + offset, size - offset);
+				if (not this->block(tail, offset, st))
+					return false;
+			}
+			this->positions_.resize(this->count_);
+			return true;
+		}
+
+		positions_t const& positions () const { return this->positions_; }
+		// hand the positions over to `into' (and forget them)
+		void release (positions_t& into) {
+			into.swap(this->positions_);
+			this->positions_.clear();
+			this->count_ = 0;
+		}
+		// whether there is a backslash anywhere in the input
+		bool escapes () const { return this->escapes_; }
+
+	private:
+		// what is carried from one block to the next
+		struct state {
+			state () : escaped(0), in_string(0), separator(1) {}
+			uint64_t escaped;    // bit 0: first char is escaped
+			uint64_t in_string;  // all ones: block starts inside a string
+			uint64_t separator;  // bit 0: previous char was ws/structural
+		};
+
+		// the character classes
+		struct masks {
+			uint64_t quote, backslash, structural, whitespace, comment;
+		};
+
+		bool block (const char* buf, std::size_t offset, state& st) {
+			masks m;
+			classify(buf, m);
+
+			// a character is escaped when it follows an odd-length run of
+			// backslashes; runs are rare, so walk them one at a time
+			uint64_t escaped = st.escaped, carry = 0;
+			uint64_t backslash = m.backslash & ~escaped;
+			while (backslash) {
+				const uint64_t bit = backslash & (~backslash + 1);
+				carry |= bit >> 63; // escapes the next block's first char
+				escaped |= bit << 1;
+				backslash &= ~(bit | (bit << 1));
+			}
+			st.escaped = carry;
+
+			// unescaped quotes toggle in and out of strings; in_string covers
+			// the opening quote up to (not including) the closing quote
+			const uint64_t quote = m.quote & ~escaped;
+			const uint64_t in_string = prefix_xor(quote) ^ st.in_string;
+			st.in_string = (in_string >> 63) ? ~uint64_t(0) : 0;
+
+			if (m.comment & ~in_string)
+				return false;
+
+			const uint64_t structural = m.structural & ~in_string;
+			const uint64_t separator = m.whitespace | m.structural;
+			const uint64_t previous = (separator << 1) | st.separator;
+			st.separator = separator >> 63;
+			const uint64_t other = ~(separator | m.quote) & ~in_string;
+
+			uint64_t bits = structural | quote | (other & previous);
+			if (this->positions_.size() < this->count_ + 64)
+				this->positions_.resize(2*this->positions_.size() + 64);
+			uint32_t *out = &this->positions_[this->count_];
+			this->count_ += __builtin_popcountll(bits);
+			while (bits) {
+				*out++ = uint32_t(offset + __builtin_ctzll(bits));
+				bits &= bits - 1;
+			}
+			this->escapes_ |= (0 != m.backslash);
+			return true;
+		}
+
+		static uint64_t prefix_xor (uint64_t x) {
+			x ^= x << 1;
+			x ^= x << 2;
+			x ^= x << 4;
+			x ^= x << 8;
+			x ^= x << 16;
+			x ^= x << 32;
+			return x;
+		}
+
+#if defined(JSONPP_STRUCTURAL_AVX2)
+		// compares for 32 bytes at a time; `{' `}' are `[' `]' with bit 5
+		// set, and \b\t\n\v\f\r are the range [8,13]
+		static uint32_t eq (__m256i v, char c) {
+			return _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)));
+		}
+		static void classify (__m256i v, uint32_t* m) {
+			const __m256i b = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+			const __m256i r = _mm256_xor_si256(_mm256_sub_epi8(v, _mm256_set1_epi8(8)),
+																				 _mm256_set1_epi8(char(0x80)));
+			m[0] = eq(v,'\"');
+			m[1] = eq(v,'\\');
+			m[2] = eq(b,'{') | eq(b,'}') | eq(v,':') | eq(v,',');
+			m[3] = eq(v,' ') | _mm256_movemask_epi8(_mm256_cmpgt_epi8(_mm256_set1_epi8(char(0x80+6)), r));
+			m[4] = eq(v,'/') | eq(v,'#');
+		}
+		static void classify (const char* buf, masks& m) {
+			uint32_t lo[5], hi[5];
+			classify(_mm256_loadu_si256((const __m256i*)(buf)), lo);
+			classify(_mm256_loadu_si256((const __m256i*)(buf + 32)), hi);
+			m.quote = lo[0] | (uint64_t(hi[0]) << 32);
+			m.backslash = lo[1] | (uint64_t(hi[1]) << 32);
+			m.structural = lo[2] | (uint64_t(hi[2]) << 32);
+			m.whitespace = lo[3] | (uint64_t(hi[3]) << 32);
+			m.comment = lo[4] | (uint64_t(hi[4]) << 32);
+		}
+#elif defined(JSONPP_STRUCTURAL_SSE2)
+		// compares for 16 bytes at a time; `{' `}' are `[' `]' with bit 5
+		// set, and \b\t\n\v\f\r are the range [8,13]
+		static uint64_t eq (__m128i v, char c) {
+			return uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c))));
+		}
+		static void classify (const char* buf, masks& m) {
+			m.quote = m.backslash = m.structural = m.whitespace = m.comment = 0;
+			for (int i=0; i<4; ++i) {
+				const __m128i v = _mm_loadu_si128((const __m128i*)(buf + 16*i));
+				const __m128i b = _mm_or_si128(v, _mm_set1_epi8(0x20));
+				const __m128i r = _mm_xor_si128(_mm_sub_epi8(v, _mm_set1_epi8(8)),
+																				_mm_set1_epi8(char(0x80)));
+				const uint64_t ws = uint16_t(_mm_movemask_epi8(
+					_mm_cmpgt_epi8(_mm_set1_epi8(char(0x80+6)), r)));
+				m.quote |= eq(v,'\"') << 16*i;
+				m.backslash |= eq(v,'\\') << 16*i;
+				m.structural |= (eq(b,'{') | eq(b,'}') | eq(v,':') | eq(v,',')) << 16*i;
+				m.whitespace |= (eq(v,' ') | ws) << 16*i;
+				m.comment |= (eq(v,'/') | eq(v,'#')) << 16*i;
+			}
+		}
+#else
+		enum klass { none=0, quote=1, backslash=2, structural=4, whitespace=8, comment=16 };
+		// the klass of every byte (all of them 0 past 0x7F); a constant, so
+		// that indexes built on several threads at once share it safely
+		static unsigned char const* table () {
+			static const unsigned char tbl[256] = {
+				 0,  0,  0,  0,  0,  0,  0,  0,  8,  8,  8,  8,  8,  8,  0,  0,
+				 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+				 8,  0,  1, 16,  0,  0,  0,  0,  0,  0,  0,  0,  4,  0,  0, 16,
+				 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  4,  0,  0,  0,  0,  0,
+				 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+				 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  4,  2,  4,  0,  0,
+				 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+				 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  4,  0,  4,  0,  0,
+			};
+			return tbl;
+		}
+		static void classify (const char* buf, masks& m) {
+			unsigned char const* tbl = table();
+			m.quote = m.backslash = m.structural = m.whitespace = m.comment = 0;
+			for (int i=0; i<64; ++i) {
+				const uint64_t bit = uint64_t(1) << i;
+				switch (tbl[(unsigned char)buf[i]]) {
+				case quote:      m.quote |= bit; break;
+				case backslash:  m.backslash |= bit; break;
+				case structural: m.structural |= bit; break;
+				case whitespace: m.whitespace |= bit; break;
+				case comment:    m.comment |= bit; break;
+				}
+			}
+		}
+#endif
+
+		positions_t positions_;
+		std::size_t count_;  // how much of positions_ is in use
+		bool escapes_;
+	};
+
+}
+
+#endif//JSONPP_STRUCTURAL_INDEX
@@ -0,0 +1,528 @@
+#include "jsonpp.hpp"
+// STL
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+// C
+#include <stdint.h>
+
+#ifndef JSONPP_TAPE
+#define JSONPP_TAPE
+
+namespace JSONpp {
+
+	//=== [TAPE] ===
+	// A parsed document as one flat array of 64-bit words (the tape) and
+	// one buffer with the text of its strings, instead of a tree of
+	// variants, maps and vectors: two allocations, read front to back, and
+	// nothing to destroy but the two buffers.
+	//
+	// Every value is one word, its kind in the top byte:
+	//   "      the rest is the offset of the string in the text buffer,
+	//          where its length (32 bits) comes first, then the text (in the
+	//          same JSON-ASCII form push_parser gives string_t), then a NUL
+	//   d      a number; the word after it holds the bits of the double
+	//   t f n  true, false, null
+	//   { [    the low 32 bits are the index just past the matching } or ],
+	//          the next 24 the number of members/elements (0xFFFFFF: more)
+	//   } ]    the index of the matching { or [
+	// The members of an object are its key (a string) and its value, in
+	// document order (and duplicate keys are kept); so a whole value,
+	// however big, is skipped in O(1).
+	//
+	//    JSONpp::tape doc;
+	//    JSONpp::tape_value root = doc.parse(first, last);
+	//    std::cout << JSONpp::printer(root);
+	//
+	// The values are read-only views into the tape; they are valid until it
+	// is parsed into again, cleared, or destroyed.
+	//
+	// A tape can also be a view of words and text that are somewhere else
+	// (attach), e.g. a document image mapped from disk (see image.hpp).
+	class tape_value;
+	class tape_array;
+	class tape_object;
+
+	class tape {
+	public:
+		typedef std::vector<uint64_t> words_t;
+
+		enum kind {
+			string = '"',
+			number = 'd',
+			true_value = 't',
+			false_value = 'f',
+			null = 'n',
+			object = '{',
+			object_end = '}',
+			array = '[',
+			array_end = ']',
+		};
+
+		// the (single) value in [first,last); the old contents are gone
+		// (an input with no value in it throws, and leaves the tape empty)
+		template <typename Iter>
+		tape_value parse (Iter first, Iter last);
+		template <typename String>
+		tape_value parse (String const& text);
+
+		tape () : image_words_(0), image_text_(0), image_size_(0), image_length_(0) {}
+
+		bool empty () const { return 0 == this->size(); }
+		// the value on it (an empty tape has none, and throws)
+		tape_value root () const;
+		void clear () {
+			this->words_.clear();
+			this->text_.clear();
+			this->image_words_ = 0;
+			this->image_text_ = 0;
+			this->image_size_ = 0;
+			this->image_length_ = 0;
+		}
+
+		// read [words, words+size) and [text, text+length) (which must
+		// outlive the tape) as the tape, without copying them
+		void attach (const uint64_t* words, std::size_t size,
+								const char* text, std::size_t length) {
+			this->clear();
+			this->image_words_ = words;
+			this->image_text_ = text;
+			this->image_size_ = size;
+			this->image_length_ = length;
+		}
+
+		// the words and text it parsed into (empty if it is attached)
+		words_t const& words () const { return this->words_; }
+		std::string const& text () const { return this->text_; }
+
+		// the words and text it reads, its own or attached
+		std::size_t size () const {
+			return this->image_words_ ? this->image_size_ : this->words_.size();
+		}
+		uint64_t at (std::size_t index) const {
+			return this->image_words_ ? this->image_words_[index] : this->words_[index];
+		}
+		const char* chars () const {
+			return this->image_words_ ? this->image_text_ : this->text_.data();
+		}
+		std::size_t chars_size () const {
+			return this->image_words_ ? this->image_length_ : this->text_.size();
+		}
+
+		// the index just past the value at index
+		std::size_t next (std::size_t index) const {
+			const uint64_t w = this->at(index);
+			switch (kind_of(w)) {
+			case number: return index + 2;
+			case object: case array: return uint32_t(w);
+			default: return index + 1;
+			}
+		}
+
+		static uint64_t word (char k, uint64_t payload) {
+			return (uint64_t((unsigned char)k) << 56) | payload;
+		}
+		static char kind_of (uint64_t w) { return char(w >> 56); }
+		static uint64_t payload_of (uint64_t w) { return w & 0x00FFFFFFFFFFFFFFull; }
+		static const char* name (char k) {
+			switch (k) {
+			case string: return "string";
+			case number: return "number";
+			case true_value: case false_value: return "boolean";
+			case null: return "null";
+			case object: return "object";
+			case array: return "array";
+			default: return "nothing";
+			}
+		}
+
+	private:
+		// writes the tape from the events of the event_parser
+		class builder : public null_handler {
+		public:
+			explicit builder (tape& t) : tape_(t) {}
+			void begin_object () { this->open(object); }
+			void end_object () { this->close(object, object_end); }
+			void begin_array () { this->open(array); }
+			void end_array () { this->close(array, array_end); }
+			void key (const char* first, const char* last) {
+				this->count(true);
+				this->text(first, last);
+			}
+			void string (const char* first, const char* last) {
+				this->count(false);
+				this->text(first, last);
+			}
+			void number (const char* first, const char* last) {
+				this->count(false);
+				double value;
+				number_decoder<double>::decode(first, last, value);
+				uint64_t bits;
+				std::memcpy(&bits, &value, sizeof(bits));
+				this->tape_.words_.push_back(word(tape::number, 0));
+				this->tape_.words_.push_back(bits);
+			}
+			void boolean (bool b) {
+				this->count(false);
+				this->tape_.words_.push_back(word(b ? true_value : false_value, 0));
+			}
+			void null () {
+				this->count(false);
+				this->tape_.words_.push_back(word(tape::null, 0));
+			}
+
+		private:
+			struct frame {
+				std::size_t start, count;
+				bool object;
+			};
+			// keys are the members of objects, values the elements of arrays
+			void count (bool key) {
+				if (not this->open_.empty() and key == this->open_.back().object)
+					++this->open_.back().count;
+			}
+			void text (const char* first, const char* last) {
+				std::string& text = this->tape_.text_;
+				const std::size_t length = last - first;
+				if (0xFFFFFFFFu < length)
+					throw std::length_error("JSON string too long for a tape");
+				const uint32_t length32 = uint32_t(length);
+				this->tape_.words_.push_back(word(tape::string, text.size()));
+				text.append(reinterpret_cast<const char*>(&length32), sizeof(length32));
+				text.append(first, last);
+				text += '\0';
+			}
+			void open (char k) {
+				this->count(false);
+				frame f = { this->tape_.words_.size(), 0, object == k };
+				this->open_.push_back(f);
+				this->tape_.words_.push_back(word(k, 0));
+			}
+			void close (char k, char end) {
+				words_t& words = this->tape_.words_;
+				const frame f = this->open_.back();
+				this->open_.pop_back();
+				if (0xFFFFFFFFu <= words.size())
+					throw std::length_error("JSON document too long for a tape");
+				const uint64_t count = (f.count < 0xFFFFFF) ? f.count : 0xFFFFFF;
+				words[f.start] = word(k, (count << 32) | (words.size()+1));
+				words.push_back(word(end, f.start));
+			}
+
+			tape& tape_;
+			std::vector<frame> open_;
+		};
+
+		words_t words_;
+		std::string text_;
+		const uint64_t *image_words_;   // attached, instead of words_/text_
+		const char *image_text_;
+		std::size_t image_size_;
+		std::size_t image_length_;
+	};
+
+	// one value on a tape
+	class tape_value {
+	public:
+		tape_value () : tape_(0), index_(0) {}
+		tape_value (tape const& t, std::size_t index) : tape_(&t), index_(index) {}
+
+		char kind () const { return tape::kind_of(this->word()); }
+		std::size_t index () const { return this->index_; }
+		// the index just past this value (and all of its children)
+		std::size_t next () const { return this->tape_->next(this->index_); }
+		tape const& on () const { return *this->tape_; }
+
+		// the text of a string (without its quotes), NUL-terminated
+		const char* c_str () const {
+			this->expect(tape::string);
+			return this->tape_->chars() + tape::payload_of(this->word()) + sizeof(uint32_t);
+		}
+		std::size_t length () const {
+			this->expect(tape::string);
+			uint32_t length;
+			std::memcpy(&length, this->tape_->chars() + tape::payload_of(this->word()),
+									sizeof(length));
+			return length;
+		}
+		std::string str () const {
+			const char *first = this->c_str();
+			return std::string(first, first + this->length());
+		}
+		double number () const {
+			this->expect(tape::number);
+			double value;
+			const uint64_t bits = this->tape_->at(this->index_+1);
+			std::memcpy(&value, &bits, sizeof(value));
+			return value;
+		}
+		bool boolean () const {
+			if (tape::true_value != this->kind() and tape::false_value != this->kind())
+				throw expected_got("boolean", tape::name(this->kind()));
+			return tape::true_value == this->kind();
+		}
+		bool is_null () const { return tape::null == this->kind(); }
+		tape_array array () const;
+		tape_object object () const;
+
+		// so that boost::apply_visitor (and so json_to_string) can visit it
+		// like a variant of the types in json_traits<tape_value>
+		template <typename Visitor>
+		typename Visitor::result_type apply_visitor (Visitor& visitor) const;
+
+	private:
+		uint64_t word () const { return this->tape_->at(this->index_); }
+		void expect (char k) const {
+			if (k != this->kind())
+				throw expected_got(tape::name(k), tape::name(this->kind()));
+		}
+
+		tape const* tape_;
+		std::size_t index_;
+	};
+
+	// The elements of an array, in order. Indexing walks the tape, but it
+	// remembers where it was, so going through the elements in order
+	// (A[0], A[1], ...) is as cheap as iterating.
+	class tape_array {
+	public:
+		typedef tape_value value_type;
+
+		class const_iterator {
+		public:
+			typedef std::forward_iterator_tag iterator_category;
+			typedef tape_value                value_type;
+			typedef std::ptrdiff_t            difference_type;
+			typedef tape_value const*         pointer;
+			typedef tape_value const&         reference;
+
+			const_iterator () {}
+			const_iterator (tape const& t, std::size_t index) : value_(t, index) {}
+
+			reference operator * () const { return this->value_; }
+			pointer operator -> () const { return &this->value_; }
+			const_iterator& operator ++ () {
+				this->value_ = tape_value(this->value_.on(), this->value_.next());
+				return *this;
+			}
+			const_iterator operator ++ (int) {
+				const_iterator previous = *this;
+				++*this;
+				return previous;
+			}
+			friend bool operator == (const_iterator const& L, const_iterator const& R) {
+				return L.value_.index() == R.value_.index();
+			}
+			friend bool operator != (const_iterator const& L, const_iterator const& R) {
+				return not (L == R);
+			}
+
+		private:
+			tape_value value_;
+		};
+		typedef const_iterator iterator;
+
+		tape_array (tape const& t, std::size_t index)
+			: tape_(&t), index_(index), at_(0), cursor_(t, index+1) {}
+
+		const_iterator begin () const { return const_iterator(*this->tape_, this->index_+1); }
+		const_iterator end () const { return const_iterator(*this->tape_, this->tape_->next(this->index_)-1); }
+		bool empty () const { return this->begin() == this->end(); }
+		std::size_t size () const { return container_size(*this->tape_, this->index_); }
+
+		tape_value const& operator [] (std::size_t i) const {
+			if (i < this->at_) {
+				this->at_ = 0;
+				this->cursor_ = tape_value(*this->tape_, this->index_+1);
+			}
+			for ( ; this->at_ < i; ++this->at_)
+				this->cursor_ = tape_value(*this->tape_, this->cursor_.next());
+			return this->cursor_;
+		}
+
+		// the count of the open word, or (past 24 bits) a walk
+		static std::size_t container_size (tape const& t, std::size_t index) {
+			const std::size_t count = (tape::payload_of(t.at(index)) >> 32) & 0xFFFFFF;
+			if (count < 0xFFFFFF)
+				return count;
+			const bool object = (tape::object == tape::kind_of(t.at(index)));
+			std::size_t n = 0;
+			for (std::size_t at = index+1, end = t.next(index)-1; at != end; at = t.next(at))
+				++n;
+			return object ? n/2 : n;
+		}
+
+	private:
+		tape const* tape_;
+		std::size_t index_;
+		mutable std::size_t at_;        // the element cursor_ is on
+		mutable tape_value cursor_;
+	};
+
+	// The members of an object, in document order, as (key, value) pairs.
+	class tape_object {
+	public:
+		struct member {
+			std::string first;
+			tape_value second;
+		};
+		typedef member value_type;
+
+		// the key is only copied out into ->first when it is asked for
+		class const_iterator {
+		public:
+			typedef std::forward_iterator_tag iterator_category;
+			typedef member                    value_type;
+			typedef std::ptrdiff_t            difference_type;
+			typedef member const*             pointer;
+			typedef member const&             reference;
+
+			const_iterator () : tape_(0), index_(0), loaded_(false) {}
+			const_iterator (tape const& t, std::size_t index)
+				: tape_(&t), index_(index), loaded_(false) {}
+
+			tape_value key () const { return tape_value(*this->tape_, this->index_); }
+			tape_value value () const { return tape_value(*this->tape_, this->index_+1); }
+
+			reference operator * () const {
+				if (not this->loaded_) {
+					this->member_.first = this->key().str();
+					this->member_.second = this->value();
+					this->loaded_ = true;
+				}
+				return this->member_;
+			}
+			pointer operator -> () const { return &**this; }
+			const_iterator& operator ++ () {
+				this->index_ = this->tape_->next(this->index_+1);
+				this->loaded_ = false;
+				return *this;
+			}
+			const_iterator operator ++ (int) {
+				const_iterator previous = *this;
+				++*this;
+				return previous;
+			}
+			friend bool operator == (const_iterator const& L, const_iterator const& R) {
+				return L.index_ == R.index_;
+			}
+			friend bool operator != (const_iterator const& L, const_iterator const& R) {
+				return not (L == R);
+			}
+
+		private:
+			tape const* tape_;
+			std::size_t index_;   // of the key
+			mutable bool loaded_;
+			mutable member member_;
+		};
+		typedef const_iterator iterator;
+
+		tape_object (tape const& t, std::size_t index) : tape_(&t), index_(index) {}
+
+		const_iterator begin () const { return const_iterator(*this->tape_, this->index_+1); }
+		const_iterator end () const { return const_iterator(*this->tape_, this->tape_->next(this->index_)-1); }
+		bool empty () const { return this->begin() == this->end(); }
+		std::size_t size () const { return tape_array::container_size(*this->tape_, this->index_); }
+
+		// the first member with the key (as it is written, escapes and all),
+		// or end()
+		const_iterator find (const char* key, std::size_t length) const {
+			const_iterator at = this->begin(), last = this->end();
+			for ( ; at != last; ++at) {
+				const tape_value k = at.key();
+				if (k.length() == length and 0 == std::memcmp(k.c_str(), key, length))
+					break;
+			}
+			return at;
+		}
+		const_iterator find (std::string const& key) const {
+			return this->find(key.data(), key.size());
+		}
+
+	private:
+		tape const* tape_;
+		std::size_t index_;
+	};
+
+	template <typename Iter>
+	tape_value tape::parse (Iter first, Iter last) {
+		this->clear();
+		builder build(*this);
+		try {
+			push(first, last, build);
+		} catch (...) {
+			this->clear();
+			throw;
+		}
+		return this->root();
+	}
+
+	template <typename String>
+	tape_value tape::parse (String const& text) {
+		return this->parse(bel::begin(text), bel::end(text));
+	}
+
+	inline tape_value tape::root () const {
+		if (this->empty())
+			throw expected_got("value","nothing");
+		return tape_value(*this, 0);
+	}
+
+	inline tape_array tape_value::array () const {
+		this->expect(tape::array);
+		return tape_array(*this->tape_, this->index_);
+	}
+	inline tape_object tape_value::object () const {
+		this->expect(tape::object);
+		return tape_object(*this->tape_, this->index_);
+	}
+
+	template <typename Visitor>
+	typename Visitor::result_type tape_value::apply_visitor (Visitor& visitor) const {
+		switch (this->kind()) {
+		case tape::string: {
+			const std::string text = this->str();
+			return visitor(text);
+		}
+		case tape::number: {
+			const double number = this->number();
+			return visitor(number);
+		}
+		case tape::true_value: case tape::false_value: {
+			const bool boolean = this->boolean();
+			return visitor(boolean);
+		}
+		case tape::object: {
+			const tape_object object = this->object();
+			return visitor(object);
+		}
+		case tape::array: {
+			const tape_array array = this->array();
+			return visitor(array);
+		}
+		default: {
+			const nil null = nil();
+			return visitor(null);
+		}
+		}
+	}
+
+	// for json_to_string (and so printer); there is nothing in a tape
+	// push_parser could build
+	template <>
+	struct json_traits<tape_value> {
+		typedef tape_value                    value_t;
+		typedef std::string                   string_t;
+		typedef double                        number_t;
+		typedef tape_object                   object_t;
+		typedef tape_array                    array_t;
+		typedef bool                          bool_t;
+		typedef nil                           null_t;
+	};
+
+}
+
+#endif//JSONPP_TAPE
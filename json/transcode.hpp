@@ -0,0 +1,227 @@
+#include "incremental.hpp"
+// STL
+#include <cstddef>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#ifndef JSONPP_TRANSCODE
+#define JSONPP_TRANSCODE
+
+namespace JSONpp {
+
+	//=== [STREAM TRANSCODING] ===
+	// JSON text from a stream, in any of the encodings of utf.hpp, read
+	// BUFLEN characters at a time and handed out as UTF-8, chunk by chunk.
+	// Only one chunk of the raw text and one of UTF-8 are held at a time,
+	// so a stream of any size is transcoded in bounded memory; UTF-8 input
+	// is only checked, and handed out from the read buffer.
+	//
+	// A stream of char is bytes, in whatever encoding the first four of
+	// them (or a byte-order mark) say. A stream of wider characters is
+	// taken to hold code units already: UTF-16 for 16-bit characters, code
+	// points for wider ones (e.g., a wifstream with a suitable locale).
+	//
+	// A character sequence, or a surrogate pair, cut by the end of a read
+	// is carried over to the next one.
+	template <typename Char, std::size_t BUFLEN=64*1024>
+	class utf_8_chunks {
+	public:
+		typedef std::basic_istream<Char> stream_type;
+
+		explicit utf_8_chunks (stream_type& stream)
+			: stream_(&stream), back_(BUFLEN+4), whole_(0), carry_(0), started_(false)
+			, encoding_(utf8), pending_(0), consumed_(0) {}
+
+		// the next chunk of UTF-8, in [first,last); false at the end of the
+		// stream (a chunk is never empty)
+		bool next (const char*& first, const char*& last) {
+			while (true) {
+				const bool more = (1 == sizeof(Char)) ? this->bytes(first, last)
+					: this->units(first, last);
+				if (not more or first != last)
+					return more;
+			}
+		}
+
+	private:
+		// a read of bytes; false when there was nothing left at all
+		bool bytes (const char*& first, const char*& last) {
+			char *buffer = reinterpret_cast<char*>(&this->back_[0]);
+			// what was cut off at the end of the last read goes first
+			std::memmove(buffer, buffer + this->whole_, this->carry_);
+			this->stream_->read(&this->back_[this->carry_], BUFLEN);
+			const std::size_t size = this->carry_ + this->stream_->gcount();
+			const bool eof = not *this->stream_;
+			if (0 == size)
+				return false;
+
+			const char *begin = buffer, *end = buffer + size;
+			if (not this->started_) {
+				this->started_ = true;
+				this->encoding_ = detect_encoding(begin, end);
+				this->consumed_ = begin - buffer;
+			}
+			// where the last whole character ends
+			std::size_t whole = size;
+			if (not eof) {
+				switch (this->encoding_) {
+				case utf8:
+					for (std::size_t back=1; back<=3 and back<=size; ++back) {
+						const unsigned char c = buffer[size-back];
+						if (0x80 == (0xC0 & c)) // a continuation byte
+							continue;
+						const std::size_t length = (c < 0xC0) ? 1 : (c < 0xE0) ? 2 : (c < 0xF0) ? 3 : 4;
+						if (back < length)
+							whole = size - back;
+						break;
+					}
+					break;
+				case utf16be: case utf16le: {
+					whole = size & ~std::size_t(1);
+					const std::size_t hi = whole - ((utf16be == this->encoding_) ? 2 : 1);
+					if (2 <= whole and 0xD8 == (0xFC & (unsigned char)buffer[hi]))
+						whole -= 2; // a high surrogate; its pair is in the next read
+				} break;
+				default:
+					whole = size & ~std::size_t(3);
+				}
+			}
+			this->whole_ = whole;
+			this->carry_ = size - whole;
+			end = buffer + whole;
+
+			try {
+				if (utf8 == this->encoding_) {
+					null_sink sink;
+					utf_8_decode(begin, end, sink);
+					first = begin; last = end;
+				} else {
+					this->out_.clear();
+					utf_8_sink sink(this->out_);
+					utf_decode(this->encoding_, begin, end, sink);
+					first = this->out_.data(); last = first + this->out_.size();
+				}
+			} catch (invalid_encoding& e) {
+				throw invalid_encoding(e.encoding, this->consumed_ + e.offset);
+			}
+			this->consumed_ += end - begin;
+			return true;
+		}
+
+		// a read of code units
+		bool units (const char*& first, const char*& last) {
+			this->stream_->read(&this->back_[0], BUFLEN);
+			const std::size_t size = this->stream_->gcount();
+			if (0 == size) {
+				if (this->pending_)
+					throw invalid_encoding("UTF-16", this->consumed_ - 1);
+				return false;
+			}
+			this->out_.clear();
+			utf_8_sink sink(this->out_);
+			for (std::size_t i=0; i<size; ++i, ++this->consumed_) {
+				unsigned long value = (unsigned long)this->back_[i];
+				if (2 == sizeof(Char)) {
+					value &= 0xFFFF;
+					if (this->pending_) {
+						if (value < 0xDC00 or 0xE000 <= value)
+							throw invalid_encoding("UTF-16", this->consumed_);
+						value = 0x10000 + ((this->pending_ - 0xD800) << 10) + (value - 0xDC00);
+						this->pending_ = 0;
+					} else if (0xD800 <= value and value < 0xDC00) {
+						this->pending_ = value;
+						continue;
+					}
+				}
+				if (0x10FFFF < value or (0xD800 <= value and value < 0xE000))
+					throw invalid_encoding((2 == sizeof(Char)) ? "UTF-16" : "UTF-32", this->consumed_);
+				sink.put(value);
+			}
+			first = this->out_.data(); last = first + this->out_.size();
+			return true;
+		}
+
+		utf_8_chunks (utf_8_chunks const&);
+		utf_8_chunks& operator = (utf_8_chunks const&);
+
+		stream_type *stream_;
+		std::vector<Char> back_;      // the raw text, as read
+		std::size_t whole_, carry_;   // what was used of it, and what is left
+		bool started_;
+		utf_encoding encoding_;
+		unsigned long pending_;       // a high surrogate, waiting for its pair
+		std::size_t consumed_;        // for the offsets of errors
+		std::string out_;             // the UTF-8, when it had to be transcoded
+	};
+
+	// The same, one char of UTF-8 at a time, as an input iterator; the
+	// default-constructed iterator is the end.
+	template <typename Char, std::size_t BUFLEN=64*1024>
+	class transcode_iterator {
+	public:
+		typedef std::input_iterator_tag iterator_category;
+		typedef char                    value_type;
+		typedef std::ptrdiff_t          difference_type;
+		typedef const char*             pointer;
+		typedef const char&             reference;
+		typedef utf_8_chunks<Char,BUFLEN> chunks_type;
+
+		transcode_iterator () : chunks_(0), first_(0), last_(0) {}
+		transcode_iterator (chunks_type& chunks) : chunks_(&chunks), first_(0), last_(0) {
+			this->advance();
+		}
+
+		reference operator * () const { return *this->first_; }
+		pointer operator -> () const { return this->first_; }
+		transcode_iterator& operator ++ () {
+			if (++this->first_ == this->last_)
+				this->advance();
+			return *this;
+		}
+		transcode_iterator operator ++ (int) {
+			transcode_iterator previous = *this;
+			++*this;
+			return previous;
+		}
+
+		friend bool operator == (transcode_iterator const& L, transcode_iterator const& R) {
+			return L.chunks_ == R.chunks_ and L.first_ == R.first_;
+		}
+		friend bool operator != (transcode_iterator const& L, transcode_iterator const& R) {
+			return not (L == R);
+		}
+
+	private:
+		void advance () {
+			if (not this->chunks_->next(this->first_, this->last_)) {
+				this->chunks_ = 0;
+				this->first_ = this->last_ = 0;
+			}
+		}
+
+		chunks_type *chunks_;
+		const char *first_, *last_;
+	};
+
+	// The first JSON value of a stream, in any encoding; the text goes
+	// through the incremental_parser a chunk at a time, so only the value
+	// itself is ever held in full.
+	template <typename JSONType, typename Char>
+	typename json_traits<JSONType>::value_t parse_stream (std::basic_istream<Char>& stream) {
+		typedef value_builder<JSONType> builder_t;
+		utf_8_chunks<Char> chunks(stream);
+		builder_t builder;
+		incremental_parser<builder_t> parser(builder);
+		const char *first, *last;
+		while (not builder.ready() and chunks.next(first, last))
+			parser.feed(first, last - first);
+		if (not builder.ready())
+			parser.finish();
+		return builder.ready() ? builder.take() : typename builder_t::value_t();
+	}
+
+}
+
+#endif//JSONPP_TRANSCODE
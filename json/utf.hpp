@@ -0,0 +1,580 @@
+// STL
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <sstream>
+#include <string>
+// SIMD
+#if !defined(JSONPP_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define JSONPP_UTF_SSE2
+#endif
+
+#ifndef JSONPP_UTF
+#define JSONPP_UTF
+
+namespace JSONpp {
+
+	//=== [UTF TRANSCODING] ===
+	// Bytes in any of the encodings rfc4627 allows (see JSTRING in
+	// jsonpp.hpp) => JSON-ASCII, the parser's internal form, in one pass:
+	// no iconv, no intermediate UTF-16 copy. The encoding is told by the
+	// byte-order mark if there is one, and by the pattern of zeros in the
+	// first four bytes if not. Malformed input (bad or overlong UTF-8,
+	// lone surrogates, truncated units) is an invalid_encoding error.
+	//
+	// Text that is JSON-ASCII already -- plain ASCII, which is most JSON --
+	// is not copied at all. Long stretches of ASCII are found (and, when
+	// transcoding, copied) sixteen bytes at a time with SSE2; define
+	// JSONPP_NO_SIMD to go one byte at a time.
+	struct invalid_encoding : std::exception {
+		std::string message;
+		const char *encoding;
+		std::size_t offset;
+		invalid_encoding (const char* encoding, std::size_t offset)
+			: encoding(encoding), offset(offset) {
+			std::ostringstream ostr;
+			ostr << "Not valid " << encoding << " at byte " << offset;
+			this->message = ostr.str();
+		}
+		virtual ~invalid_encoding () throw() {}
+		virtual const char* what () const throw() {
+			return this->message.c_str();
+		}
+	};
+
+	enum utf_encoding {
+		utf8,
+		utf16be,
+		utf16le,
+		utf32be,
+		utf32le,
+	};
+
+	// the encoding of [first,last); first is moved past a byte-order mark
+	inline utf_encoding detect_encoding (const char*& first, const char* last) {
+		const std::size_t size = last - first;
+		const unsigned char *b = (const unsigned char*)first;
+		if (4 <= size) {
+			if (0 == b[0] and 0 == b[1] and 0xFE == b[2] and 0xFF == b[3]) { first += 4; return utf32be; }
+			if (0xFF == b[0] and 0xFE == b[1] and 0 == b[2] and 0 == b[3]) { first += 4; return utf32le; }
+		}
+		if (3 <= size and 0xEF == b[0] and 0xBB == b[1] and 0xBF == b[2]) { first += 3; return utf8; }
+		if (2 <= size) {
+			if (0xFE == b[0] and 0xFF == b[1]) { first += 2; return utf16be; }
+			if (0xFF == b[0] and 0xFE == b[1]) { first += 2; return utf16le; }
+		}
+		// 00 00 00 xx, 00 xx 00 xx, xx 00 00 00, xx 00 xx 00, xx xx xx xx
+		if (4 <= size) {
+			if (0 == b[0] and 0 == b[1]) return utf32be;
+			if (0 == b[0]) return utf16be;
+			if (0 == b[1] and 0 == b[2] and 0 == b[3]) return utf32le;
+			if (0 == b[1]) return utf16le;
+		} else if (2 <= size) {
+			if (0 == b[0]) return utf16be;
+			if (0 == b[1]) return utf16le;
+		}
+		return utf8;
+	}
+
+	// the first byte of [first,last) that is not JSON-ASCII as it stands:
+	// anything outside [32,127) but for the whitespace \t\n\v\f\r\b
+	inline const char* json_ascii_span (const char* first, const char* last) {
+#if defined(JSONPP_UTF_SSE2)
+		// bytes >= 0x80 are negative, so one signed compare against 0x20
+		// finds them and the control characters together
+		const __m128i space = _mm_set1_epi8(0x20);
+		const __m128i del = _mm_set1_epi8(0x7F);
+		const __m128i nl = _mm_set1_epi8('\n'), tab = _mm_set1_epi8('\t'), cr = _mm_set1_epi8('\r');
+		for ( ; 16 <= last - first; first += 16) {
+			const __m128i v = _mm_loadu_si128((const __m128i*)first);
+			const __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(v, nl),
+				_mm_or_si128(_mm_cmpeq_epi8(v, tab), _mm_cmpeq_epi8(v, cr)));
+			const __m128i bad = _mm_or_si128(_mm_andnot_si128(ws, _mm_cmplt_epi8(v, space)),
+																			 _mm_cmpeq_epi8(v, del));
+			const int mask = _mm_movemask_epi8(bad);
+			if (0 != mask) {
+				first += __builtin_ctz(mask);
+				break;
+			}
+		}
+#endif
+		for ( ; first != last; ++first) {
+			const unsigned char c = *first;
+			if (c < 32 or 127 <= c)
+				switch (c) {
+				case '\t': case '\v': case '\n': case '\r': case '\b': case '\f':
+					break;
+				default:
+					return first;
+				}
+		}
+		return last;
+	}
+
+	inline bool json_ascii_clean (const char* first, const char* last) {
+		return last == json_ascii_span(first, last);
+	}
+
+	// one code point, folded: ASCII as is, the rest as \uXXXX (as a
+	// surrogate pair above 0xFFFF)
+	inline void json_ascii_fold (unsigned long value, std::string& result) {
+		if (31 < value and value < 127) {
+			result += (char)value;
+			return;
+		}
+		switch (value) {
+		case '\t': case '\v': case '\n': case '\r': case '\b': case '\f':
+			result += (char)value;
+			return;
+		}
+		static const char hex[] = "0123456789ABCDEF";
+		if (0xFFFF < value) {
+			value -= 0x10000;
+			json_ascii_fold(0xD800 + (value >> 10), result);
+			json_ascii_fold(0xDC00 + (value & 0x3FF), result);
+			return;
+		}
+		const char escape[] = { '\\', 'u',
+			hex[15&(value>>12)], hex[15&(value>>8)], hex[15&(value>>4)], hex[15&value] };
+		result.append(escape, escape+6);
+	}
+
+	// one code point, as UTF-8
+	inline void utf_8_append (unsigned long value, std::string& result) {
+		if (value < 0x80)
+			result += (char)value;
+		else if (value < 0x800) {
+			const char bytes[] = { char(0xC0 | (value >> 6)), char(0x80 | (value & 0x3F)) };
+			result.append(bytes, 2);
+		} else if (value < 0x10000) {
+			const char bytes[] = { char(0xE0 | (value >> 12)), char(0x80 | ((value >> 6) & 0x3F)),
+				char(0x80 | (value & 0x3F)) };
+			result.append(bytes, 3);
+		} else {
+			const char bytes[] = { char(0xF0 | (value >> 18)), char(0x80 | ((value >> 12) & 0x3F)),
+				char(0x80 | ((value >> 6) & 0x3F)), char(0x80 | (value & 0x3F)) };
+			result.append(bytes, 4);
+		}
+	}
+
+	// The decoders below hand what they decode to a sink: runs of bytes
+	// that stand for themselves (append), and single code points (put).
+	struct json_ascii_sink {
+		json_ascii_sink (std::string& out) : out(out) {}
+		void append (const char* first, const char* last) { this->out.append(first, last); }
+		void put (unsigned long value) { json_ascii_fold(value, this->out); }
+		std::string& out;
+	};
+	struct utf_8_sink {
+		utf_8_sink (std::string& out) : out(out) {}
+		void append (const char* first, const char* last) { this->out.append(first, last); }
+		void put (unsigned long value) { utf_8_append(value, this->out); }
+		std::string& out;
+	};
+	// for validating, without keeping anything
+	struct null_sink {
+		void append (const char*, const char*) {}
+		void put (unsigned long) {}
+	};
+
+	// UTF-8; error offsets are counted from origin (first, by default)
+	template <typename Sink>
+	void utf_8_decode (const char* first, const char* last, Sink& sink, const char* origin=0) {
+		if (not origin) origin = first;
+		while (first != last) {
+			const char *dirty = json_ascii_span(first, last);
+			sink.append(first, dirty);
+			if (dirty == last)
+				break;
+			first = dirty;
+			const unsigned char c = *first;
+			unsigned long value = c;
+			std::size_t more = 0;
+			if (c < 0x80) more = 0;
+			else if (0xC2 <= c and c < 0xE0) { value = c & 0x1F; more = 1; }
+			else if (0xE0 <= c and c < 0xF0) { value = c & 0x0F; more = 2; }
+			else if (0xF0 <= c and c < 0xF5) { value = c & 0x07; more = 3; }
+			else throw invalid_encoding("UTF-8", first - origin);
+			if (std::size_t(last - first) <= more)
+				throw invalid_encoding("UTF-8", first - origin);
+			for (std::size_t i=1; i<=more; ++i) {
+				if (0x80 != (0xC0 & (unsigned char)first[i]))
+					throw invalid_encoding("UTF-8", first + i - origin);
+				value = (value << 6) | (0x3F & first[i]);
+			}
+			// overlong forms, surrogates, and values beyond unicode
+			if ((2 == more and (value < 0x800 or (0xD800 <= value and value < 0xE000)))
+					or (3 == more and (value < 0x10000 or 0x10FFFF < value)))
+				throw invalid_encoding("UTF-8", first - origin);
+			sink.put(value);
+			first += more+1;
+		}
+	}
+
+	// UTF-16, with surrogate pairs checked
+	template <typename Sink>
+	void utf_16_decode (const char* first, const char* last, bool big, Sink& sink) {
+		const char *name = big ? "UTF-16BE" : "UTF-16LE";
+		if (0 != (last - first) % 2)
+			throw invalid_encoding(name, last - first - 1);
+		const unsigned char *b = (const unsigned char*)first;
+		const std::size_t hi = big ? 0 : 1, lo = big ? 1 : 0;
+		std::size_t i = 0, n = last - first;
+		while (i < n) {
+#if defined(JSONPP_UTF_SSE2)
+			// eight units at a time while they are all printable ASCII
+			for ( ; i + 16 <= n; i += 8*2) {
+				__m128i v = _mm_loadu_si128((const __m128i*)(b + i));
+				if (big)
+					v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+				// printable: 0x20 <= unit < 0x7F
+				const __m128i ok = _mm_and_si128(_mm_cmpgt_epi16(v, _mm_set1_epi16(0x1F)),
+																				 _mm_cmplt_epi16(v, _mm_set1_epi16(0x7F)));
+				if (0xFFFF != _mm_movemask_epi8(ok))
+					break;
+				char ascii[16];
+				_mm_storeu_si128((__m128i*)ascii, _mm_packus_epi16(v, v));
+				sink.append(ascii, ascii+8);
+			}
+			if (i == n)
+				break;
+#endif
+			unsigned long value = (b[i+hi] << 8) | b[i+lo];
+			i += 2;
+			if (0xD800 <= value and value < 0xDC00) { // high surrogate
+				if (n <= i)
+					throw invalid_encoding(name, i - 2);
+				const unsigned long low = (b[i+hi] << 8) | b[i+lo];
+				if (low < 0xDC00 or 0xE000 <= low)
+					throw invalid_encoding(name, i);
+				value = 0x10000 + ((value - 0xD800) << 10) + (low - 0xDC00);
+				i += 2;
+			} else if (0xDC00 <= value and value < 0xE000) // lone low surrogate
+				throw invalid_encoding(name, i - 2);
+			sink.put(value);
+		}
+	}
+
+	// UTF-32
+	template <typename Sink>
+	void utf_32_decode (const char* first, const char* last, bool big, Sink& sink) {
+		const char *name = big ? "UTF-32BE" : "UTF-32LE";
+		if (0 != (last - first) % 4)
+			throw invalid_encoding(name, (last - first) & ~3);
+		const unsigned char *b = (const unsigned char*)first;
+		for (std::size_t i=0, n=last-first; i<n; i+=4) {
+			const unsigned long value = big
+				? (((unsigned long)b[i] << 24) | (b[i+1] << 16) | (b[i+2] << 8) | b[i+3])
+				: (((unsigned long)b[i+3] << 24) | (b[i+2] << 16) | (b[i+1] << 8) | b[i]);
+			if (0x10FFFF < value or (0xD800 <= value and value < 0xE000))
+				throw invalid_encoding(name, i);
+			sink.put(value);
+		}
+	}
+
+	// UTF-8 => JSON-ASCII, appended to result
+	inline void utf_8_to_json_ascii (const char* first, const char* last, std::string& result) {
+		json_ascii_sink sink(result);
+		utf_8_decode(first, last, sink);
+	}
+	// UTF-16 => JSON-ASCII, appended to result
+	inline void utf_16_to_json_ascii (const char* first, const char* last, bool big,
+																		std::string& result) {
+		json_ascii_sink sink(result);
+		utf_16_decode(first, last, big, sink);
+	}
+
+	// [first,last) in any encoding => the sink
+	template <typename Sink>
+	void utf_decode (utf_encoding encoding, const char* first, const char* last, Sink& sink,
+									 const char* origin=0) {
+		switch (encoding) {
+		case utf8: utf_8_decode(first, last, sink, origin); break;
+		case utf16be: case utf16le: utf_16_decode(first, last, utf16be == encoding, sink); break;
+		default: utf_32_decode(first, last, utf32be == encoding, sink); break;
+		}
+	}
+
+	// the JSON-ASCII text of the bytes [first,last), without copying them
+	// when they already are (then scratch is left alone); otherwise first
+	// and last are moved to the transcoded text, kept in scratch
+	inline void json_ascii (const char*& first, const char*& last, std::string& scratch) {
+		const utf_encoding encoding = detect_encoding(first, last);
+		const std::size_t size = last - first;
+		scratch.clear();
+		json_ascii_sink sink(scratch);
+		if (utf8 == encoding) {
+			const char *dirty = json_ascii_span(first, last);
+			if (dirty == last)
+				return;
+			scratch.reserve(size + size/4);
+			scratch.assign(first, dirty);
+			utf_8_decode(dirty, last, sink, first);
+		} else {
+			scratch.reserve((utf16be == encoding or utf16le == encoding) ? size/2 + size/8 : size/4);
+			utf_decode(encoding, first, last, sink);
+		}
+		first = scratch.data();
+		last = first + scratch.size();
+	}
+
+	// the UTF-8 text of the bytes [first,last), likewise: UTF-8 is checked
+	// and left where it is, the other encodings are transcoded into scratch
+	inline void utf_8_text (const char*& first, const char*& last, std::string& scratch) {
+		const utf_encoding encoding = detect_encoding(first, last);
+		scratch.clear();
+		if (utf8 == encoding) {
+			null_sink sink;
+			utf_8_decode(first, last, sink);
+			return;
+		}
+		scratch.reserve(last - first);
+		utf_8_sink sink(scratch);
+		utf_decode(encoding, first, last, sink);
+		first = scratch.data();
+		last = first + scratch.size();
+	}
+
+	// Both, for strings of bytes (char) or of code units (wider characters,
+	// e.g., wchar_t: UTF-16 units or code points, or the bytes of some
+	// encoding if they all happen to be < 256), and for iterators (one copy
+	// is made, or two if they need transcoding).
+	template <typename X, typename Sink>
+	void utf_text (std::basic_string<X> const& str, std::string& text, bool json_ascii_form) {
+		typedef typename std::basic_string<X>::const_iterator xc_iter;
+		bool wide = false;
+		for (xc_iter xtr=str.begin(), xnd=str.end(); 1 < sizeof(X) and xtr!=xnd and not wide; ++xtr)
+			wide = (0xFF < (unsigned long)*xtr);
+		if (not wide) {
+			text.assign(str.begin(), str.end());
+			const char *first = text.data(), *last = first + text.size();
+			std::string scratch;
+			if (json_ascii_form)
+				json_ascii(first, last, scratch);
+			else
+				utf_8_text(first, last, scratch);
+			if (first == scratch.data())
+				text.swap(scratch);
+			else if (first != text.data()) // a byte-order mark
+				text.erase(0, first - text.data());
+			return;
+		}
+		text.clear();
+		text.reserve(str.size());
+		Sink sink(text);
+		for (xc_iter xtr=str.begin(), xnd=str.end(); xtr!=xnd; ++xtr)
+			sink.put((unsigned long)*xtr);
+	}
+
+	template <typename X>
+	std::string json_ascii (std::basic_string<X> const& str) {
+		std::string text;
+		utf_text<X,json_ascii_sink>(str, text, true);
+		return text;
+	}
+	template <typename Iter>
+	void json_ascii (Iter begin, Iter end, std::string& text) {
+		typedef typename std::iterator_traits<Iter>::value_type X;
+		utf_text<X,json_ascii_sink>(std::basic_string<X>(begin, end), text, true);
+	}
+
+	template <typename X>
+	std::string utf_8_text (std::basic_string<X> const& str) {
+		std::string text;
+		utf_text<X,utf_8_sink>(str, text, false);
+		return text;
+	}
+	template <typename Iter>
+	void utf_8_text (Iter begin, Iter end, std::string& text) {
+		typedef typename std::iterator_traits<Iter>::value_type X;
+		utf_text<X,utf_8_sink>(std::basic_string<X>(begin, end), text, false);
+	}
+
+	//=== [JSON STRING ESCAPES] ===
+	// four hex digits at first
+	inline bool hex_4 (const char* first, const char* last, unsigned long& value) {
+		if (last - first < 4)
+			return false;
+		value = 0;
+		for (int i=0; i<4; ++i) {
+			const char c = first[i];
+			value <<= 4;
+			if ('0' <= c and c <= '9') value |= c - '0';
+			else if ('a' <= c and c <= 'f') value |= c - 'a' + 10;
+			else if ('A' <= c and c <= 'F') value |= c - 'A' + 10;
+			else return false;
+		}
+		return true;
+	}
+
+	// The text of a string token (between the quotes), with its escapes
+	// replaced by what they stand for, as UTF-8. The lexer has checked the
+	// escapes already. \u escapes for a lone surrogate stand for U+FFFD.
+	inline void json_unescape (const char* first, const char* last, std::string& result) {
+		while (first != last) {
+			const char *slash = (const char*)std::memchr(first, '\\', last - first);
+			if (not slash) {
+				result.append(first, last);
+				return;
+			}
+			result.append(first, slash);
+			first = slash+1;
+			if (first == last)
+				return;
+			switch (*first++) {
+			case 'b': result += '\b'; break;
+			case 'f': result += '\f'; break;
+			case 'n': result += '\n'; break;
+			case 'r': result += '\r'; break;
+			case 't': result += '\t'; break;
+			case 'u': {
+				unsigned long value = 0;
+				if (not hex_4(first, last, value))
+					break;
+				first += 4;
+				if (0xD800 <= value and value < 0xDC00) {
+					unsigned long low = 0;
+					if (2 <= last - first and '\\' == first[0] and 'u' == first[1]
+							and hex_4(first+2, last, low) and 0xDC00 <= low and low < 0xE000) {
+						value = 0x10000 + ((value - 0xD800) << 10) + (low - 0xDC00);
+						first += 6;
+					} else
+						value = 0xFFFD;
+				} else if (0xDC00 <= value and value < 0xE000)
+					value = 0xFFFD;
+				utf_8_append(value, result);
+			} break;
+			default: // " \ /
+				result += first[-1];
+			}
+		}
+	}
+
+	// The printing side: the first byte of [first,last) that cannot be
+	// copied into a string as is, i.e., a quote, a backslash, a control
+	// character, or (if high) a byte >= 0x80. Sixteen bytes at a time with
+	// SSE2, so clean runs are found (and then copied) in bulk.
+	inline const char* json_plain_span (const char* first, const char* last, bool high) {
+#if defined(JSONPP_UTF_SSE2)
+		const __m128i space = _mm_set1_epi8(0x20), zero = _mm_setzero_si128();
+		const __m128i quote = _mm_set1_epi8('\"'), slash = _mm_set1_epi8('\\');
+		const __m128i keep = high ? zero : _mm_set1_epi8(char(0xFF));
+		for ( ; 16 <= last - first; first += 16) {
+			const __m128i v = _mm_loadu_si128((const __m128i*)first);
+			// signed: bytes >= 0x80 are below 0x20 too, unless kept
+			const __m128i low = _mm_andnot_si128(_mm_and_si128(keep, _mm_cmplt_epi8(v, zero)),
+																					 _mm_cmplt_epi8(v, space));
+			const int mask = _mm_movemask_epi8(_mm_or_si128(low,
+				_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, slash))));
+			if (0 != mask)
+				return first + __builtin_ctz(mask);
+		}
+#endif
+		for ( ; first != last; ++first) {
+			const unsigned char c = *first;
+			if (c < 0x20 or '\"' == c or '\\' == c or (high and 0x80 <= c))
+				return first;
+		}
+		return last;
+	}
+
+	// \uXXXX, for a code point (above 0xFFFF as a surrogate pair)
+	inline void json_u_escape (unsigned long value, std::string& result) {
+		static const char hex[] = "0123456789ABCDEF";
+		if (0xFFFF < value) {
+			value -= 0x10000;
+			json_u_escape(0xD800 + (value >> 10), result);
+			json_u_escape(0xDC00 + (value & 0x3FF), result);
+			return;
+		}
+		const char escape[] = { '\\', 'u',
+			hex[15&(value>>12)], hex[15&(value>>8)], hex[15&(value>>4)], hex[15&value] };
+		result.append(escape, escape+6);
+	}
+
+	// a control character (or " or \), escaped
+	inline void json_control_escape (unsigned char c, std::string& result) {
+		switch (c) {
+		case '\"': result += "\\\""; break;
+		case '\\': result += "\\\\"; break;
+		case '\b': result += "\\b"; break;
+		case '\f': result += "\\f"; break;
+		case '\n': result += "\\n"; break;
+		case '\r': result += "\\r"; break;
+		case '\t': result += "\\t"; break;
+		default: json_u_escape(c, result);
+		}
+	}
+
+	// and back: the text of a decoded (UTF-8) string, as it goes between the
+	// quotes. In ascii, everything outside of ASCII is escaped; otherwise
+	// it is copied as UTF-8.
+	inline void json_escape (const char* first, const char* last, bool ascii, std::string& result) {
+		while (first != last) {
+			const char *special = json_plain_span(first, last, ascii);
+			result.append(first, special);
+			if (special == last)
+				return;
+			first = special;
+			const unsigned char c = *first;
+			if (c < 0x80) {
+				json_control_escape(c, result);
+				++first;
+				continue;
+			}
+			std::size_t length = (c < 0xE0) ? 2 : (c < 0xF0) ? 3 : 4;
+			if (std::size_t(last - first) < length)
+				length = last - first;
+			unsigned long value = c & (0x7F >> length);
+			for (std::size_t i=1; i<length; ++i)
+				value = (value << 6) | (0x3F & first[i]);
+			json_u_escape(value, result);
+			first += length;
+		}
+	}
+
+	// the same, for a folded (JSON-ASCII) string: its escapes are already
+	// there, and are copied, but in unicode the \u escapes of anything
+	// outside of ASCII are turned back into UTF-8
+	inline void json_folded_escape (const char* first, const char* last, bool unicode,
+																	std::string& result) {
+		while (first != last) {
+			const char *special = json_plain_span(first, last, false);
+			result.append(first, special);
+			if (special == last)
+				return;
+			first = special;
+			if ('\\' != *first or 1 == last - first) { // not an escape
+				json_control_escape(*first, result);
+				++first;
+				continue;
+			}
+			unsigned long value = 0;
+			if (not ('u' == first[1] and hex_4(first+2, last, value))) {
+				result.append(first, first+2);
+				first += 2;
+				continue;
+			}
+			std::size_t length = 6;
+			if (0xD800 <= value and value < 0xDC00) {
+				unsigned long low = 0;
+				if (12 <= last - first and '\\' == first[6] and 'u' == first[7]
+						and hex_4(first+8, last, low) and 0xDC00 <= low and low < 0xE000) {
+					value = 0x10000 + ((value - 0xD800) << 10) + (low - 0xDC00);
+					length = 12;
+				} else
+					value = 0; // a lone surrogate stays as it is
+			} else if (0xDC00 <= value and value < 0xE000)
+				value = 0;
+			if (unicode and 0x80 <= value)
+				utf_8_append(value, result);
+			else
+				result.append(first, first+length);
+			first += length;
+		}
+	}
+
+}
+
+#endif//JSONPP_UTF
@@ -1,67 +1,1250 @@
 //#define DEBUG_JSON
 #include <json/jsonpp.hpp>
+#include <json/number.hpp>
+#include <json/incremental.hpp>
+#include <json/ndjson.hpp>
+#include <json/transcode.hpp>
+#include <json/arena.hpp>
+#include <json/tape.hpp>
+#include <json/flat_map.hpp>
+#include <json/intern.hpp>
+#include <json/compact.hpp>
+#include <json/lazy.hpp>
+#include <json/parallel.hpp>
+#include <json/cbor.hpp>
+#include <json/image.hpp>
+#include <json/bound.hpp>
+#include <json/footprint.hpp>
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <limits>
 #include <locale>
 #include <iterator>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <unistd.h>
 
-template <typename Char, std::size_t BUFLEN=256>
-class transcode_iterator {
-  static const std::size_t BACKLEN = sizeof(char)*BUFLEN;
-  static const std::size_t TRANLEN = sizeof(Char)*BUFLEN;
-  typedef std::basic_istream<Char> stream_type;
-public:
-  transcode_iterator ()
-    : stream_(0), cd_((iconv_t)-1)
-    , tran_off_(0), back_off_(0) {
-    this->zero();
-  }
-  transcode_iterator (stream_type& str)
-    : stream_(&str), cd_((iconv_t)-1)
-    , tran_off_(0), back_off_(0){
-    this->zero();
-  }
-  transcode_iterator (transcode_iterator const& ti)
-    : stream_(ti.stream_), cd_(ti.cd_) {
-    this->copy(ti);
-  }
-
-protected:
-  void zero () {
-    std::memset(this->back_buffer_, 0, BACKLEN);
-    std::memset(this->tran_buffer_, 0, TRANLEN);
-  }
-  void copy (transcode_iterator const& ti) {
-    this->tran_off_ = ti.tran_off_;
-    this->back_off_ = ti.back_off_;
-    std::memcpy(this->back_buffer_, ti.back_buffer_, BACKLEN);
-    std::memcpy(this->tran_buffer_, ti.tran_buffer_, TRANLEN);
-  }
-private:
-  stream_type *stream_;
-  char back_buffer_[BUFLEN];
-  Char tran_buffer_[BUFLEN];
-  std::size_t tran_off_, back_off_;
-  iconv_t cd_;
+// the parser's answer for `text', printed back compactly
+static std::string reparse (std::string const& text) {
+  try {
+    return JSONpp::to_string(JSONpp::parse(text.begin(), text.end()));
+  } catch (std::exception& e) {
+    return std::string("error: ") + e.what();
+  }
+}
+
+static int failures = 0;
+static void check_one (std::string const& text, std::string const& expected) {
+  std::string got = reparse(text);
+  if (got != expected) {
+    std::cout << "FAIL: " << text << std::endl
+              << "  expected: " << expected << std::endl
+              << "  got:      " << got << std::endl;
+    ++failures;
+  }
+}
+
+// checks both the scanning lexer and (by padding the text past the
+// threshold) the lexer walking the structural index
+static void check (std::string const& text, std::string const& expected) {
+  check_one(text, expected);
+  check_one(std::string(JSONpp::lexer::index_threshold, ' ') + text, expected);
+}
+
+static void test_parser () {
+  check("[]", "[]");
+  check("{}", "{}");
+  check("[[],{}]", "[[],{}]");
+  check(" [ 1 , \"a\\\"b\" , true , false , null ] ", "[1,\"a\\\"b\",true,false,null]");
+  check("{\"b\":[1,{\"c\":null}],\"a\":\"x\"}", "{\"a\":\"x\",\"b\":[1,{\"c\":null}]}");
+  check("[1, // one\n 2 /* two */, # three\n 3]", "[1,2,3]");
+  check("-12.5e1", "-125");
+  check("[1,]", "error: Unexpected token: ]");
+  check("{\"a\":1,}", "error: Expected a string got a }");
+  check("[1 2]", "error: Expected a ] got a 2");
+  check("[1", "error: Expected a ] got a nothing");
+  check("{\"a\" 1}", "error: Expected a : got a 1");
+  check("\"abc", "error: Expected a \" got a nothing");
+  check("[tru]", "error: Not a valid token: tru]");
+  check("[-]", "error: Not a valid token: -");
+  check("[truex]", "error: Expected a ] got a x");
+  check("[1-2]", "error: Expected a ] got a -2");
+  check("[\"a\"\"b\"]", "error: Expected a ] got a b");
+  // deep nesting
+  std::string deep;
+  for (std::size_t i=0; i<1000; ++i)
+    deep += "[{\"k\":";
+  deep += "1";
+  for (std::size_t i=0; i<1000; ++i)
+    deep += "}]";
+  check(deep, deep);
+  // escapes that straddle the 64-byte blocks of the structural index
+  for (std::size_t i=0; i<130; ++i) {
+    std::string pad(i, ' ');
+    check(pad + "[\"\\\\\", \"\\\"x\\\"\", \"\\\\\\\"\"," + pad + "\"y\"]",
+          "[\"\\\\\",\"\\\"x\\\"\",\"\\\\\\\"\",\"y\"]");
+  }
+}
+
+// writes the events it sees as a compact trace
+struct trace_handler : JSONpp::null_handler {
+  std::string trace;
+  void begin_object () { trace += "{"; }
+  void end_object () { trace += "}"; }
+  void begin_array () { trace += "["; }
+  void end_array () { trace += "]"; }
+  void key (const char* f, const char* l) { trace += "k:" + std::string(f,l) + " "; }
+  void string (const char* f, const char* l) { trace += "s:" + std::string(f,l) + " "; }
+  void number (const char* f, const char* l) { trace += "n:" + std::string(f,l) + " "; }
+  void boolean (bool b) { trace += b ? "T " : "F "; }
+  void null () { trace += "0 "; }
 };
 
+// from iterators, and from the bytes in place
+static void check_events (std::string const& text, std::string const& expected) {
+  for (int in_place=0; in_place<2; ++in_place) {
+    trace_handler handler;
+    try {
+      if (in_place)
+        JSONpp::push(text.data(), text.data()+text.size(), handler);
+      else
+        JSONpp::push(text.begin(), text.end(), handler);
+    } catch (std::exception& e) {
+      handler.trace += std::string("error: ") + e.what();
+    }
+    if (handler.trace != expected) {
+      std::cout << "FAIL (events): " << text << std::endl
+                << "  expected: " << expected << std::endl
+                << "  got:      " << handler.trace << std::endl;
+      ++failures;
+    }
+  }
+}
+
+static void test_events () {
+  check_events("{\"b\":[1,true,\"x\"], /* c */ \"a\":null}",
+               "{k:b [n:1 T s:x ]k:a 0 }");
+  check_events("[[],{},false]", "[[]{}F ]");
+  check_events("[1,", "[n:1 error: Expected a value got a nothing");
+}
+
+// the double decoder must agree, bit for bit, with strtod
+static void check_number (std::string const& text) {
+  double fast = -1, slow = std::strtod(text.c_str(), 0);
+  JSONpp::number_decoder<double>::decode(text.data(), text.data()+text.size(), fast);
+  if (0 != std::memcmp(&fast, &slow, sizeof(double))) {
+    std::cout << "FAIL (number): " << text << " " << fast << " != " << slow << std::endl;
+    ++failures;
+  }
+}
+
+static void test_numbers () {
+  const char *cases[] = {
+    "0", "-0", "1", "-1", "007", "1.5", "0.1", "0.3", "1e22", "1e23", "-2.5e-3",
+    "9007199254740992", "9007199254740993", "18446744073709551615",
+    "18446744073709551616", "123456789012345678901234567890", "1.7976931348623157e308",
+    "1e309", "-1e400", "4.9e-324", "2.2250738585072011e-308", "0.000000000000000000000000001",
+    "3.14159265358979323846264338327950288", "1E5", "1e+5", "1.", "100000000000000000000e-20",
+    "1e-400", "-1e-400", "-4.9e-324", "2.4e-324", "1e-330", "0.10000000000000001",
+    "2.2204460492503131e-16", "-1.2345678901234567e-300", "0e999",
+  };
+  for (std::size_t i=0; i<sizeof(cases)/sizeof(cases[0]); ++i)
+    check_number(cases[i]);
+  std::srand(4627);
+  for (std::size_t i=0; i<20000; ++i) {
+    std::ostringstream oss;
+    if (std::rand() % 2) oss << '-';
+    oss << std::rand() % 100000;
+    if (std::rand() % 2) oss << '.' << std::rand();
+    if (std::rand() % 2) oss << 'e' << (std::rand() % 80 - 40);
+    check_number(oss.str());
+  }
+}
+
+static void check_lossless (std::string const& text, std::string const& expected) {
+  std::string got;
+  try {
+    JSONpp::push_parser<JSONpp::json_lossless_v> parser;
+    JSONpp::json_lossless_v json = parser(text.begin(), text.end());
+    JSONpp::json_to_string<JSONpp::json_lossless_v> printer;
+    got = printer.translate(json);
+  } catch (std::exception& e) {
+    got = std::string("error: ") + e.what();
+  }
+  if (got != expected) {
+    std::cout << "FAIL (lossless): " << text << std::endl
+              << "  expected: " << expected << std::endl
+              << "  got:      " << got << std::endl;
+    ++failures;
+  }
+}
+
+static void test_lossless () {
+  check_lossless("[9007199254740993,-9223372036854775808,18446744073709551615]",
+                 "[9007199254740993,-9223372036854775808,18446744073709551615]");
+  check_lossless("[18446744073709551616,-9223372036854775809,1e400,1e-400]",
+                 "[18446744073709551616,-9223372036854775809,1e400,1e-400]");
+  check_lossless("[0.1,-2.5e-3,1e5,0.0,-0,3.141592653589793238462643]",
+                 "[0.1,-0.0025,100000,0,-0,3.141592653589793238462643]");
+  // a double only keeps 15 significant digits for certain; past that the
+  // text is kept (trailing zeros are not significant)
+  check_lossless("[0.10000000000000001,9007199254740993.0,1.23456789012345,1.500000000000000000]",
+                 "[0.10000000000000001,9007199254740993.0,1.23456789012345,1.5]");
+}
+
+// feeds text to an incremental_parser in pieces: split at `at', or in
+// chunks of `chunk' bytes
+static std::string feed_events (std::string const& text, std::size_t at, std::size_t chunk) {
+  trace_handler handler;
+  try {
+    JSONpp::incremental_parser<trace_handler> parser(handler);
+    if (chunk) {
+      for (std::size_t i=0; i<text.size(); i+=chunk)
+        parser.feed(text.data()+i, std::min(chunk, text.size()-i));
+    } else {
+      parser.feed(text.data(), at);
+      parser.feed(text.data()+at, text.size()-at);
+    }
+    parser.finish();
+  } catch (std::exception& e) {
+    handler.trace += std::string("error: ") + e.what();
+  }
+  return handler.trace;
+}
+
+// the incremental parser sees the same events as the event_parser, however
+// the input is cut up
+static void check_incremental (std::string const& text, std::string const& expected) {
+  for (std::size_t at=0; at<=text.size(); ++at) {
+    const std::string got = feed_events(text, at, 0);
+    if (got != expected) {
+      std::cout << "FAIL (incremental): " << text << " split at " << at << std::endl
+                << "  expected: " << expected << std::endl
+                << "  got:      " << got << std::endl;
+      ++failures;
+      return;
+    }
+  }
+  if (feed_events(text, 0, 1) != expected) {
+    std::cout << "FAIL (incremental): " << text << " byte by byte" << std::endl;
+    ++failures;
+  }
+}
+
+static void test_incremental () {
+  check_incremental("{\"b\":[1,true,\"x\"], /* c **/ \"a\":null} // d",
+                    "{k:b [n:1 T s:x ]k:a 0 }");
+  check_incremental("[[],{},false, -1.5e+3, \"q\\\"\\u00e9\"] # e",
+                    "[[]{}F n:-1.5e+3 s:q\\\"\\u00e9 ]");
+  check_incremental("1 2\n\"x\"{}", "n:1 n:2 s:x {}");
+  check_incremental("[\"\xc3\xa9\xf0\x9f\x98\x80\"]", "[s:\\u00E9\\uD83D\\uDE00 ]");
+  check_incremental("[1,", "[n:1 error: Expected a value got a nothing");
+  check_incremental("{\"a\" 1}", "{k:a error: Expected a : got a 1");
+  check_incremental("[1,]", "[n:1 error: Unexpected token: ]");
+  check_incremental("[nul", "[error: Not a valid token: nul");
+  check_incremental("[\"ab", "[error: Expected a \" got a nothing");
+
+  // and builds the same values as the parser
+  const std::string text = "{\"x\":[1,2,{\"y\":null}],\"z\":\"w\"}\n[true]\n";
+  JSONpp::value_builder<JSONpp::json_v> builder;
+  JSONpp::incremental_parser<JSONpp::value_builder<JSONpp::json_v> > parser(builder);
+  std::size_t completed = 0;
+  for (std::size_t i=0; i<text.size(); i+=3)
+    completed += parser.feed(text.data()+i, std::min<std::size_t>(3, text.size()-i));
+  completed += parser.finish();
+  std::string got;
+  while (builder.ready())
+    got += JSONpp::to_string(builder.take()) + " ";
+  const std::string expected = JSONpp::to_string(JSONpp::parse(text.begin(), text.begin()+30))
+    + " [true] ";
+  if (2 != completed or got != expected) {
+    std::cout << "FAIL (value_builder): " << completed << " " << got << std::endl;
+    ++failures;
+  }
+}
+
+// open reads regular files through a map, and pipes with read
+static void test_open () {
+  const char *text = "{\"a\":[1,\"\xc3\xa9\"]}";
+  const std::string expected = JSONpp::to_string(JSONpp::parse(text, text+std::strlen(text)));
+  int fds[2];
+  if (0 != pipe(fds)) {
+    ++failures;
+    return;
+  }
+  if (write(fds[1], text, std::strlen(text))) {}
+  close(fds[1]);
+  std::ostringstream pipe_name;
+  pipe_name << "/dev/fd/" << fds[0];
+  std::string got;
+  {
+    JSONpp::mapped_file file(pipe_name.str());
+    got = JSONpp::to_string(JSONpp::parse(file.begin(), file.end()));
+    if (file.mapped())
+      got += " (mapped)";
+  }
+  close(fds[0]);
+  if (got != expected) {
+    std::cout << "FAIL (open pipe): " << got << " != " << expected << std::endl;
+    ++failures;
+  }
+  JSONpp::mapped_file file("examples/large-dod.cif");
+  std::ifstream ifstr("examples/large-dod.cif", std::ios::binary);
+  std::string bytes((std::istreambuf_iterator<char>(ifstr)), std::istreambuf_iterator<char>());
+  if (not file.mapped() or bytes != std::string(file.begin(), file.end())
+      or JSONpp::to_string(JSONpp::open("examples/large-dod.cif"))
+         != JSONpp::to_string(JSONpp::parse(bytes.begin(), bytes.end()))) {
+    std::cout << "FAIL (open file)" << std::endl;
+    ++failures;
+  }
+  try {
+    JSONpp::open("examples/no such file");
+    std::cout << "FAIL (open missing)" << std::endl;
+    ++failures;
+  } catch (JSONpp::cannot_open&) {
+  }
+}
+
+// records come back in order, whatever the chunking and number of workers
+struct line_collector {
+  std::string got;
+  void operator () (std::size_t line, JSONpp::json_v& value) {
+    std::ostringstream ostr;
+    ostr << line << ":" << JSONpp::to_string(value) << " ";
+    got += ostr.str();
+  }
+};
+
+static void test_ndjson () {
+  std::string text, expected;
+  for (std::size_t i=0, line=1; i<500; ++i, ++line) {
+    std::ostringstream record, result;
+    record << "{\"id\":" << i << ",\"tags\":[\"t" << i%7 << "\"]}";
+    const std::string rec = record.str();
+    text += rec + ((i%5) ? "\n" : "\r\n\n");
+    result << line << ":" << JSONpp::to_string(JSONpp::parse(rec.begin(), rec.end())) << " ";
+    expected += result.str();
+    line += (0 == i%5);
+  }
+  for (std::size_t workers=1; workers<=4; ++workers) {
+    JSONpp::ndjson_parser<JSONpp::json_v> parser(workers, 100);
+    line_collector collect;
+    parser.parse(text.data(), text.data()+text.size(), collect);
+    if (collect.got != expected) {
+      std::cout << "FAIL (ndjson): " << workers << " workers" << std::endl;
+      ++failures;
+    }
+  }
+  JSONpp::ndjson_parser<JSONpp::json_v> parser(3, 100);
+  if (500 != parser.parse(text.data(), text.data()+text.size()).size()) {
+    std::cout << "FAIL (ndjson): collected" << std::endl;
+    ++failures;
+  }
+  // the first bad record, by line
+  std::string bad = text;
+  bad.insert(bad.find("{\"id\":321,"), "[1,]\n");
+  bad.insert(bad.find("{\"id\":400,"), "{]\n");
+  std::string got;
+  try {
+    parser.parse(bad.data(), bad.data()+bad.size());
+  } catch (JSONpp::record_error& e) {
+    got = e.what();
+  }
+  if (got != "Line 387: Unexpected token: ]") {
+    std::cout << "FAIL (ndjson error): " << got << std::endl;
+    ++failures;
+  }
+  // a line holds one value, and nothing else
+  const char *more[] = { "{\"a\":1} {\"b\":2}", "[1,2] garbage", "1 2", "null," };
+  for (std::size_t m=0; m<sizeof(more)/sizeof(more[0]); ++m) {
+    const std::string lines = std::string("{\"a\":0}\n") + more[m] + "\n[3]\n";
+    got.clear();
+    try {
+      parser.parse(lines.data(), lines.data()+lines.size());
+    } catch (JSONpp::record_error& e) {
+      got = e.what();
+    }
+    if (0 != got.find("Line 2: ")) {
+      std::cout << "FAIL (ndjson error): " << more[m] << " " << got << std::endl;
+      ++failures;
+    }
+  }
+}
+
+// every encoding, with and without a byte-order mark, folds to the same
+// JSON-ASCII; and malformed input is an error
+static std::string encode (std::wstring const& text, JSONpp::utf_encoding encoding) {
+  std::string bytes;
+  for (std::size_t i=0; i<text.size(); ++i) {
+    unsigned long c = text[i];
+    if (JSONpp::utf8 == encoding) {
+      if (c < 0x80) bytes += char(c);
+      else if (c < 0x800) { bytes += char(0xC0|(c>>6)); bytes += char(0x80|(c&0x3F)); }
+      else if (c < 0x10000) { bytes += char(0xE0|(c>>12)); bytes += char(0x80|((c>>6)&0x3F));
+                              bytes += char(0x80|(c&0x3F)); }
+      else { bytes += char(0xF0|(c>>18)); bytes += char(0x80|((c>>12)&0x3F));
+             bytes += char(0x80|((c>>6)&0x3F)); bytes += char(0x80|(c&0x3F)); }
+    } else if (JSONpp::utf32be == encoding or JSONpp::utf32le == encoding) {
+      char unit[4] = { char(c>>24), char(c>>16), char(c>>8), char(c) };
+      if (JSONpp::utf32le == encoding)
+        std::reverse(unit, unit+4);
+      bytes.append(unit, 4);
+    } else {
+      unsigned long units[2] = { c, 0 };
+      std::size_t n = 1;
+      if (0xFFFF < c) {
+        units[0] = 0xD800 + ((c-0x10000) >> 10);
+        units[1] = 0xDC00 + ((c-0x10000) & 0x3FF);
+        n = 2;
+      }
+      for (std::size_t u=0; u<n; ++u) {
+        char unit[2] = { char(units[u]>>8), char(units[u]) };
+        if (JSONpp::utf16le == encoding)
+          std::swap(unit[0], unit[1]);
+        bytes.append(unit, 2);
+      }
+    }
+  }
+  return bytes;
+}
+
+static std::string transcode (std::string const& bytes) {
+  try {
+    const char *first = bytes.data(), *last = first + bytes.size();
+    std::string scratch;
+    JSONpp::json_ascii(first, last, scratch);
+    return std::string(first, last);
+  } catch (std::exception& e) {
+    return std::string("error: ") + e.what();
+  }
+}
+
+static void test_utf () {
+  std::wstring text = L"[\"caf\u00e9\", \"\u4e2d\u6587\", \"\U0001F600\", \"\x01\"]";
+  const std::string expected = "[\"caf\\u00E9\", \"\\u4E2D\\u6587\", \"\\uD83D\\uDE00\", \"\\u0001\"]";
+  // with long ASCII runs around the special characters, for the SIMD paths
+  std::wstring padded = L"[\"" + std::wstring(37, L'x') + L"\u00e9" + std::wstring(50, L'y') + L"\"]";
+  const std::string padded_expected = "[\"" + std::string(37, 'x') + "\\u00E9" + std::string(50, 'y') + "\"]";
+  const JSONpp::utf_encoding encodings[] = {
+    JSONpp::utf8, JSONpp::utf16be, JSONpp::utf16le, JSONpp::utf32be, JSONpp::utf32le };
+  for (std::size_t e=0; e<5; ++e)
+    for (int bom=0; bom<2; ++bom) {
+      const std::wstring prefix = bom ? L"\xFEFF" : L"";
+      const std::string got = transcode(encode(prefix + text, encodings[e]));
+      const std::string got_padded = transcode(encode(prefix + padded, encodings[e]));
+      if (got != expected or got_padded != padded_expected) {
+        std::cout << "FAIL (utf): encoding " << e << " bom " << bom << ": " << got << std::endl;
+        ++failures;
+      }
+    }
+  // the same through iterators, of bytes and of wide characters
+  const std::string bytes = encode(text, JSONpp::utf8);
+  if (JSONpp::json_ascii(bytes) != expected or JSONpp::json_ascii(text) != expected) {
+    std::cout << "FAIL (utf): " << JSONpp::json_ascii(bytes) << std::endl;
+    ++failures;
+  }
+  // ASCII is not copied
+  const std::string ascii = "{\"a\": [1, 2, \"three\"]}\n";
+  const char *first = ascii.data(), *last = first + ascii.size();
+  std::string scratch;
+  JSONpp::json_ascii(first, last, scratch);
+  if (first != ascii.data() or last != ascii.data()+ascii.size()) {
+    std::cout << "FAIL (utf): ASCII was copied" << std::endl;
+    ++failures;
+  }
+  const char *bad[][2] = {
+    { "[\"\xc3\"]", "error: Not valid UTF-8 at byte 3" },
+    { "[\"\xc0\xaf\"]", "error: Not valid UTF-8 at byte 2" },
+    { "[\"\xed\xa0\x80\"]", "error: Not valid UTF-8 at byte 2" },
+    { "[\"abcdefghijklmnopqrstuvwxyz\xff\"]", "error: Not valid UTF-8 at byte 28" },
+  };
+  for (std::size_t i=0; i<sizeof(bad)/sizeof(bad[0]); ++i)
+    if (transcode(bad[i][0]) != bad[i][1]) {
+      std::cout << "FAIL (utf): " << transcode(bad[i][0]) << " != " << bad[i][1] << std::endl;
+      ++failures;
+    }
+  const std::string lone("\0[\xd8\x00\0]", 6);
+  if (transcode(lone) != "error: Not valid UTF-16BE at byte 4") {
+    std::cout << "FAIL (utf): " << transcode(lone) << std::endl;
+    ++failures;
+  }
+}
+
+// strings decoded to UTF-8 at parse time, and printed either way
+static void test_decoded () {
+  const std::string text = "{\"caf\xc3\xa9\": [\"a\\\"b\\\\c\\n\", \"\\u00e9\\ud83d\\ude00\\ud800\", \"\xe4\xb8\xad\"]}";
+  JSONpp::push_parser<JSONpp::json_v> parser(JSONpp::decoded);
+  JSONpp::json_v json = parser(text.data(), text.data()+text.size());
+  typedef JSONpp::json_traits<JSONpp::json_v> traits;
+  traits::object_t const& obj = boost::get<traits::object_t>(json);
+  traits::object_t::const_iterator it = obj.find("caf\xc3\xa9");
+  if (obj.end() == it) {
+    std::cout << "FAIL (decoded): key not found" << std::endl;
+    ++failures;
+    return;
+  }
+  traits::array_t const& arr = boost::get<traits::array_t>(it->second);
+  const std::string strings[] = { "a\"b\\c\n", "\xc3\xa9\xf0\x9f\x98\x80\xef\xbf\xbd", "\xe4\xb8\xad" };
+  for (std::size_t i=0; i<3; ++i)
+    if (boost::get<std::string>(arr[i]) != strings[i]) {
+      std::cout << "FAIL (decoded): " << boost::get<std::string>(arr[i]) << std::endl;
+      ++failures;
+    }
+  const std::string ascii = JSONpp::to_string(json, JSONpp::iomanipulator_::decoded);
+  const std::string unicode = JSONpp::to_string(json,
+    JSONpp::iomanipulator_::decoded | JSONpp::iomanipulator_::unicode);
+  if (ascii != "{\"caf\\u00E9\":[\"a\\\"b\\\\c\\n\",\"\\u00E9\\uD83D\\uDE00\\uFFFD\",\"\\u4E2D\"]}"
+      or unicode != "{\"caf\xc3\xa9\":[\"a\\\"b\\\\c\\n\",\"\xc3\xa9\xf0\x9f\x98\x80\xef\xbf\xbd\",\"\xe4\xb8\xad\"]}") {
+    std::cout << "FAIL (decoded print): " << ascii << std::endl
+              << "                      " << unicode << std::endl;
+    ++failures;
+  }
+  // both print forms read back as the same thing
+  if (JSONpp::to_string(parser(ascii.data(), ascii.data()+ascii.size()), JSONpp::iomanipulator_::decoded) != ascii
+      or JSONpp::to_string(parser(unicode.data(), unicode.data()+unicode.size()), JSONpp::iomanipulator_::decoded) != ascii) {
+    std::cout << "FAIL (decoded round trip)" << std::endl;
+    ++failures;
+  }
+  // UTF-16 comes out as UTF-8 too
+  const std::string utf16("\0[\0\"\x4e\x2d\0\"\0]", 10);
+  JSONpp::json_v wide = parser(utf16.data(), utf16.data()+utf16.size());
+  if (boost::get<std::string>(boost::get<traits::array_t>(wide)[0]) != "\xe4\xb8\xad") {
+    std::cout << "FAIL (decoded utf16)" << std::endl;
+    ++failures;
+  }
+}
+
+// streams in any encoding, read in small pieces that cut characters and
+// surrogate pairs in half
+static void test_transcode () {
+  std::wstring text = L"{\"café\": [\"中文\", \"\U0001F600\", 12345, true]}";
+  const std::string expected = "{\"caf\\u00E9\":[\"\\u4E2D\\u6587\",\"\\uD83D\\uDE00\",12345,true]}";
+  const JSONpp::utf_encoding encodings[] = {
+    JSONpp::utf8, JSONpp::utf16be, JSONpp::utf16le, JSONpp::utf32be, JSONpp::utf32le };
+  for (std::size_t e=0; e<5; ++e) {
+    std::istringstream bytes(encode(L"\xFEFF" + text, encodings[e]));
+    std::string got;
+    try {
+      typedef JSONpp::utf_8_chunks<char,5> chunks_t;
+      chunks_t chunks(bytes);
+      JSONpp::transcode_iterator<char,5> first(chunks), last;
+      std::string utf8(first, last);
+      bytes.clear(); bytes.seekg(0);
+      got = JSONpp::to_string(JSONpp::parse_stream<JSONpp::json_v>(bytes));
+      if (utf8 != encode(text, JSONpp::utf8))
+        got = "transcoded to " + utf8;
+    } catch (std::exception& e) {
+      got = std::string("error: ") + e.what();
+    }
+    if (got != expected) {
+      std::cout << "FAIL (transcode): encoding " << e << ": " << got << std::endl;
+      ++failures;
+    }
+  }
+  // wide characters are code points already
+  std::wistringstream wide(text);
+  if (JSONpp::to_string(JSONpp::parse_stream<JSONpp::json_v>(wide)) != expected) {
+    std::cout << "FAIL (transcode): wide" << std::endl;
+    ++failures;
+  }
+  // and errors are counted from the start of the stream
+  std::istringstream bad(std::string(100, ' ') + "[\"\xc3\x28\"]");
+  std::string got;
+  try {
+    JSONpp::utf_8_chunks<char,16> chunks(bad);
+    const char *first, *last;
+    while (chunks.next(first, last)) {}
+  } catch (std::exception& e) {
+    got = e.what();
+  }
+  if (got != "Not valid UTF-8 at byte 103") {
+    std::cout << "FAIL (transcode): " << got << std::endl;
+    ++failures;
+  }
+}
+
+// the printer escapes what it has to, in both string forms and both modes
+static void check_print (JSONpp::string_form form, std::string const& text,
+                         signed long format, std::string const& expected) {
+  JSONpp::push_parser<JSONpp::json_v> parser(form);
+  const std::string got = JSONpp::to_string(parser(text.data(), text.data()+text.size()), format);
+  if (got != expected) {
+    std::cout << "FAIL (print): " << text << std::endl
+              << "  expected: " << expected << std::endl
+              << "  got:      " << got << std::endl;
+    ++failures;
+  }
+}
+
+static void test_printer () {
+  using JSONpp::iomanipulator_;
+  const std::string text = "[\"tab\there\\t \\\"q\\\" caf\xc3\xa9 \\u00e9 \\ud83d\\ude00 \\ud800 \xe4\xb8\xad\"]";
+  check_print(JSONpp::folded, text, iomanipulator_::ascii,
+              "[\"tab\\there\\t \\\"q\\\" caf\\u00E9 \\u00e9 \\ud83d\\ude00 \\ud800 \\u4E2D\"]");
+  check_print(JSONpp::folded, text, iomanipulator_::unicode,
+              "[\"tab\\there\\t \\\"q\\\" caf\xc3\xa9 \xc3\xa9 \xf0\x9f\x98\x80 \\ud800 \xe4\xb8\xad\"]");
+  check_print(JSONpp::decoded, text, iomanipulator_::decoded,
+              "[\"tab\\there\\t \\\"q\\\" caf\\u00E9 \\u00E9 \\uD83D\\uDE00 \\uFFFD \\u4E2D\"]");
+  check_print(JSONpp::decoded, text, iomanipulator_::decoded | iomanipulator_::unicode,
+              "[\"tab\\there\\t \\\"q\\\" caf\xc3\xa9 \xc3\xa9 \xf0\x9f\x98\x80 \xef\xbf\xbd \xe4\xb8\xad\"]");
+  // special characters at every offset of a long string
+  for (std::size_t i=0; i<40; ++i) {
+    const std::string pad(i, 'x'), tail(40-i, 'y');
+    check_print(JSONpp::decoded, "{\"" + pad + "\\n\xc3\xa9\\\\" + tail + "\":1}", iomanipulator_::decoded,
+                "{\"" + pad + "\\n\\u00E9\\\\" + tail + "\":1}");
+    check_print(JSONpp::folded, "[\"" + pad + "\\n\xc3\xa9\\\\" + tail + "\"]", iomanipulator_::unicode,
+                "[\"" + pad + "\\n\xc3\xa9\\\\" + tail + "\"]");
+  }
+}
+
+static std::string arena_text (JSONpp::arena_json_v const& value) {
+  const JSONpp::arena_string text = JSONpp::json_to_string<JSONpp::arena_json_v>().translate(value);
+  return std::string(text.begin(), text.end());
+}
+
+static void test_arena () {
+  typedef JSONpp::arena_json_v arena_v;
+  JSONpp::arena memory(256);
+  JSONpp::arena_document<arena_v> doc(memory);
+  const char *texts[] = {
+    "[1, \"two\", {\"three\": [3, 3.5, null], \"four\": false}, []]",
+    "{\"a long key, past the short string buffer\": \"and a long value, too, for the same reason\"}",
+    "\"just a string\"",
+  };
+  std::size_t reserved = 0;
+  for (std::size_t i=0; i<sizeof(texts)/sizeof(texts[0]); ++i) {
+    const std::string text = texts[i];
+    const arena_v& root = doc.parse(text.begin(), text.end());
+    const std::string got = arena_text(root);
+    if (reparse(text) != got or 0 == memory.used()) {
+      std::cout << "FAIL (arena): " << text << std::endl
+                << "  got: " << got << std::endl;
+      ++failures;
+    }
+    reserved = std::max(reserved, memory.reserved());
+  }
+  // a reset keeps the blocks for the next document
+  doc.clear();
+  if (0 != memory.used() or reserved != memory.reserved()) {
+    std::cout << "FAIL (arena): reset" << std::endl;
+    ++failures;
+  }
+  // allocators pick up the arena in scope, and copies keep it; with none in
+  // scope they use the heap
+  JSONpp::arena other;
+  JSONpp::arena_string outside("a string longer than the short string buffer");
+  JSONpp::arena_json_gen::array_t array;
+  {
+    JSONpp::arena::scope in(other);
+    array.push_back(arena_v(JSONpp::arena_string("another string too long for the buffer")));
+    arena_v inside = array;
+    boost::get<JSONpp::arena_json_gen::array_t>(inside).push_back(outside);
+  }
+  arena_v copy = array;
+  if (0 != outside.get_allocator().memory() or 0 != array.get_allocator().memory()
+      or &other != boost::get<JSONpp::arena_string>(
+        boost::get<JSONpp::arena_json_gen::array_t>(copy)[0]).get_allocator().memory()) {
+    std::cout << "FAIL (arena): allocators" << std::endl;
+    ++failures;
+  }
+#if __cplusplus >= 201103L
+  // a move hands the box over; the value moved from reads as empty, and
+  // can be written to again
+  {
+    JSONpp::arena::scope in(other);
+    arena_v from = array, to = std::move(from);
+    const std::string before = arena_text(from);
+    boost::get<JSONpp::arena_json_gen::array_t>(from).push_back(arena_v(true));
+    if ("[]" != before or "[true]" != arena_text(from)
+        or 1 != boost::get<JSONpp::arena_json_gen::array_t>(to).size()) {
+      std::cout << "FAIL (arena): moved from " << before << std::endl;
+      ++failures;
+    }
+    from = std::move(to);
+    to = array;
+    if (arena_text(from) != arena_text(to)) {
+      std::cout << "FAIL (arena): moved back" << std::endl;
+      ++failures;
+    }
+  }
+#endif
+}
+
+static void test_tape () {
+  const char *texts[] = {
+    "[1, \"two\", {\"a\": [3, 3.5, null], \"b\": false, \"c\": {}}, [], [[true]]]",
+    "{\"k\": \"caf\xc3\xa9 \\n\"}",
+    "-2.5e3",
+  };
+  JSONpp::tape doc;
+  for (std::size_t i=0; i<sizeof(texts)/sizeof(texts[0]); ++i) {
+    const std::string text = texts[i];
+    std::ostringstream printed;
+    const JSONpp::tape_value root = doc.parse(text.data(), text.data()+text.size());
+    printed << JSONpp::printer(root);
+    if (reparse(text) != printed.str() or doc.words().size() != root.next()) {
+      std::cout << "FAIL (tape): " << text << std::endl
+                << "  got: " << printed.str() << std::endl;
+      ++failures;
+    }
+  }
+  // skipping, sizes, lookups, and the kinds
+  const std::string text = "{\"z\": [[1, [2]], {\"y\": 3}], \"a\": \"x\", \"z\": 4}";
+  const JSONpp::tape_object object = doc.parse(text.begin(), text.end()).object();
+  const JSONpp::tape_array array = object.begin()->second.array();
+  bool kind_error = false;
+  try {
+    array[0].number();
+  } catch (JSONpp::expected_got&) {
+    kind_error = true;
+  }
+  if (3 != object.size() or 2 != array.size() or 1 != array[1].object().size()
+      or JSONpp::tape::object != array[1].kind() or "x" != object.find("a")->second.str()
+      or 4 != (++object.find("a"))->second.number() or object.end() != object.find("y")
+      or 2 != array[0].array()[1].array()[0].number() or not kind_error) {
+    std::cout << "FAIL (tape): accessors" << std::endl;
+    ++failures;
+  }
+  // a document that does not parse leaves the tape empty
+  try {
+    doc.parse(std::string("[1, 2"));
+    ++failures;
+  } catch (std::exception&) {
+    if (not doc.empty())
+      ++failures;
+  }
+  // and so does one with no value in it; an empty tape has no root
+  const char *nothing[] = { "", "   " };
+  for (std::size_t n=0; n<2; ++n) {
+    try {
+      doc.parse(std::string(nothing[n]));
+      std::cout << "FAIL (tape): parsed \"" << nothing[n] << "\"" << std::endl;
+      ++failures;
+    } catch (JSONpp::expected_got&) {
+    }
+  }
+  try {
+    JSONpp::tape().root();
+    std::cout << "FAIL (tape): the root of an empty tape" << std::endl;
+    ++failures;
+  } catch (JSONpp::expected_got&) {
+  }
+}
+
+static void check_flat (std::string const& text, std::string const& expected) {
+  JSONpp::push_parser<JSONpp::json_flat_v> parser;
+  std::ostringstream printed;
+  printed << JSONpp::printer(parser(text.begin(), text.end()));
+  if (printed.str() != expected) {
+    std::cout << "FAIL (flat): " << text << std::endl
+              << "  expected: " << expected << std::endl
+              << "  got:      " << printed.str() << std::endl;
+    ++failures;
+  }
+}
+
+static void test_flat_map () {
+  // members stay in document order; a repeated key keeps its place, and
+  // the last value
+  check_flat("{\"b\": 1, \"a\": [{\"d\": null, \"c\": true}], \"b\": 2}",
+             "{\"b\":2,\"a\":[{\"d\":null,\"c\":true}]}");
+  check_flat("{}", "{}");
+  // past linear_limit the lookups go through the hash index
+  typedef JSONpp::json_flat_gen::object_t object_t;
+  object_t object;
+  const std::size_t n = 3*object_t::linear_limit;
+  for (std::size_t i=0; i<n; ++i) {
+    std::ostringstream key;
+    key << "key" << i;
+    object[key.str()] = double(i);
+  }
+  object_t reversed;
+  for (std::size_t i=n; i>0; --i)
+    reversed[(object.begin()+(i-1))->first] = (object.begin()+(i-1))->second;
+  bool found = true;
+  for (std::size_t i=0; i<n; ++i) {
+    std::ostringstream key;
+    key << "key" << i;
+    found = found and object.find(key.str()) == object.begin()+i
+      and double(i) == boost::get<double>(object[key.str()]);
+  }
+  const bool equal = (object == reversed);
+  object.erase("key7");
+  if (not found or not equal or object.size() != n-1 or object.count("key7")
+      or 0 == object.count("key8") or object == reversed) {
+    std::cout << "FAIL (flat): lookups" << std::endl;
+    ++failures;
+  }
+}
+
+static void test_intern () {
+  // every occurrence of a key is the one copy in the pool
+  typedef JSONpp::json_interned_gen::object_t object_t;
+  typedef JSONpp::json_interned_gen::array_t array_t;
+  const std::string text = "[{\"id\": 1, \"tags\": [\"a\"]}, {\"id\": 2, \"tags\": {\"id\": 3}}]";
+  JSONpp::string_pool pool;
+  JSONpp::json_interned_v doc =
+    JSONpp::parse_interned<JSONpp::json_interned_v>(text.begin(), text.end(), pool);
+  array_t const& records = boost::get<array_t>(doc);
+  object_t const& first = boost::get<object_t>(records[0]);
+  object_t const& second = boost::get<object_t>(records[1]);
+  object_t const& nested = boost::get<object_t>(second.find(pool.intern("tags"))->second);
+  std::ostringstream printed;
+  printed << JSONpp::printer(doc);
+  if (2 != pool.size() or first.begin()->first.data() != nested.begin()->first.data()
+      or first.begin()->first != pool.intern("id") or pool.intern("") != JSONpp::interned_string()
+      or printed.str() != "[{\"id\":1,\"tags\":[\"a\"]},{\"id\":2,\"tags\":{\"id\":3}}]") {
+    std::cout << "FAIL (intern): " << printed.str() << std::endl;
+    ++failures;
+  }
+  // keys from another pool are equal by their text
+  JSONpp::string_pool other;
+  if (other.intern("id") != pool.intern("id") or other.intern("id") == pool.intern("tags")) {
+    std::cout << "FAIL (intern): across pools" << std::endl;
+    ++failures;
+  }
+  // decoded keys go in through the pool's iterator overload
+  {
+    const std::string utf8 = "{\"caf\\u00e9\": 1, \"n\": {\"caf\xc3\xa9\": 2}}";
+    const std::string key = "caf\xc3\xa9";
+    JSONpp::string_pool decoded_pool;
+    JSONpp::string_pool::scope in(decoded_pool);
+    JSONpp::push_parser<JSONpp::json_interned_v> parser(JSONpp::decoded);
+    const JSONpp::json_interned_v decoded = parser(utf8.data(), utf8.data()+utf8.size());
+    object_t const& outer = boost::get<object_t>(decoded);
+    object_t const& inner = boost::get<object_t>(outer.find(decoded_pool.intern("n"))->second);
+    if (2 != decoded_pool.size() or outer.end() == outer.find(decoded_pool.intern(key.begin(), key.end()))
+        or inner.begin()->first.data() != outer.begin()->first.data()) {
+      std::cout << "FAIL (intern): decoded keys" << std::endl;
+      ++failures;
+    }
+  }
+  // the parsers need a pool to intern into
+  try {
+    JSONpp::push_parser<JSONpp::json_interned_v> parser;
+    parser(text.begin(), text.end());
+    std::cout << "FAIL (intern): parsed without a pool" << std::endl;
+    ++failures;
+  } catch (std::logic_error&) {
+  }
+}
+
+static void test_compact () {
+  // the parser and printer take it as they take json_v
+  typedef JSONpp::compact_value value_t;
+  const std::string text = "[1.5, -0, \"thirteen byte\", \"fourteen bytes\", \"\", true, false, null, "
+    "{\"b\": [1e300], \"a\": {}}]";
+  JSONpp::push_parser<value_t> parser;
+  value_t doc = parser(text.begin(), text.end());
+  std::ostringstream printed;
+  printed << JSONpp::printer(doc);
+  value_t::array_t const& values = doc.array();
+  value_t copy = doc;
+  if (16 != sizeof(value_t) or 9 != values.size()
+      or "thirteen byte" != values[2].str() or "fourteen bytes" != values[3].str()
+      or 0 != values[4].length() or not values[7].is_null() or false != values[6].boolean()
+      or 1e300 != values[8].object().find("b")->second.array()[0].number()
+      or not (copy == doc) or (copy == values[8])
+      or printed.str() != "[1.5,-0,\"thirteen byte\",\"fourteen bytes\",\"\",true,false,null,"
+                          "{\"b\":[1e+300],\"a\":{}}]") {
+    std::cout << "FAIL (compact): " << printed.str() << std::endl;
+    ++failures;
+  }
+  // a NaN is a number, not something else
+  value_t nan = std::numeric_limits<double>::quiet_NaN();
+  value_t negative_nan = -std::numeric_limits<double>::quiet_NaN();
+  if (value_t::number_kind != nan.kind() or value_t::number_kind != negative_nan.kind()) {
+    std::cout << "FAIL (compact): NaN" << std::endl;
+    ++failures;
+  }
+  try {
+    values[0].str();
+    std::cout << "FAIL (compact): a number as a string" << std::endl;
+    ++failures;
+  } catch (JSONpp::expected_got&) {
+  }
+}
+
+static void test_lazy () {
+  // only what is looked at is decoded (or checked): the mistakes in the
+  // members that are skipped do not come up
+  const std::string text = "{\"skip\": [1, {\"deep\": [tru]}, \"}]\"], \"bad\": nul, "
+    "\"id\": 42, \"name\": \"a\\u00e9\", \"tags\": [true, null, [], {}]}";
+  JSONpp::lazy_document doc;
+  JSONpp::lazy_object root = doc.parse(text).object();
+  JSONpp::lazy_object::const_iterator id = root.find("id"), name = root.find("name");
+  JSONpp::lazy_array tags = root.find("tags")->second.array();
+  std::ostringstream printed;
+  printed << JSONpp::printer(root.find("tags")->second);
+  if (id == root.end() or 42 != id->second.number() or "name" != name->first
+      or "a\\u00e9" != name->second.str() or "a\xc3\xa9" != name->second.decoded()
+      or root.find("missing") != root.end() or 5 != root.size()
+      or 4 != tags.size() or not tags[0].boolean() or not tags[1].is_null()
+      or not tags[2].array().empty() or not tags[3].object().empty()
+      or printed.str() != "[true,null,[],{}]") {
+    std::cout << "FAIL (lazy): " << printed.str() << std::endl;
+    ++failures;
+  }
+  // what is looked at is checked
+  try {
+    root.find("bad")->second.is_null();
+    std::cout << "FAIL (lazy): nul" << std::endl;
+    ++failures;
+  } catch (JSONpp::unknown_token&) {
+  }
+  // a document with comments is lexed for its positions instead
+  const std::string commented = "[1, /* two */ 2, // three\n 3]";
+  JSONpp::lazy_value numbers = doc.parse(commented);
+  if (3 != numbers.array().size() or 2 != numbers.array()[1].number()) {
+    std::cout << "FAIL (lazy): comments" << std::endl;
+    ++failures;
+  }
+}
+
+static void test_parallel () {
+  // cut into chunks of ~64 bytes, over 3 threads, it makes the same array
+  std::string text = "[";
+  for (int i=0; i<200; ++i) {
+    std::ostringstream element;
+    element << (i ? ", " : "") << "{\"id\": " << i << ", \"s\": \"[,]\\\"\", \"a\": [[], {}]}";
+    text += element.str();
+  }
+  text += "]";
+  JSONpp::parallel_parser<JSONpp::json_v> parallel(3, 64);
+  JSONpp::push_parser<JSONpp::json_v> serial;
+  if (not (parallel(text) == serial(text.data(), text.data()+text.size()))) {
+    std::cout << "FAIL (parallel): not the serial array" << std::endl;
+    ++failures;
+  }
+  // a mistake is reported as the serial parser reports it
+  const char* mistakes[] = { "1 2", "tru", "{\"a\" 1}", "[1,]", "]" };
+  for (std::size_t m=0; m<sizeof(mistakes)/sizeof(mistakes[0]); ++m) {
+    std::string bad = text;
+    bad.insert(bad.find(", {\"id\": 100,"), std::string(", ") + mistakes[m]);
+    std::string expected = "no error", got = "no error";
+    try { serial(bad.data(), bad.data()+bad.size()); } catch (std::exception& e) { expected = e.what(); }
+    try { parallel(bad); } catch (std::exception& e) { got = e.what(); }
+    if (expected != got or "no error" == expected) {
+      std::cout << "FAIL (parallel): " << mistakes[m] << std::endl
+                << "  expected: " << expected << std::endl
+                << "  got:      " << got << std::endl;
+      ++failures;
+    }
+  }
+}
+
+static void test_cbor () {
+  // the bytes are those of RFC 8949, appendix A, and come back the same
+  const std::string text = "[0, 23, 24, 1000000, -1, -1000, 1.5, 100000.0, 1.1, -0.0, 1e300, "
+    "\"\", \"a\", \"\\u00fc\", false, true, null, {\"a\": [2, 3]}]";
+  const unsigned char expected[] = {
+    0x92, 0x00, 0x17, 0x18, 0x18, 0x1a, 0x00, 0x0f, 0x42, 0x40, 0x20, 0x39, 0x03, 0xe7,
+    0xfa, 0x3f, 0xc0, 0x00, 0x00, 0x1a, 0x00, 0x01, 0x86, 0xa0,
+    0xfb, 0x3f, 0xf1, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9a, 0xfa, 0x80, 0x00, 0x00, 0x00,
+    0xfb, 0x7e, 0x37, 0xe4, 0x3c, 0x88, 0x00, 0x75, 0x9c,
+    0x60, 0x61, 0x61, 0x62, 0xc3, 0xbc, 0xf4, 0xf5, 0xf6,
+    0xa1, 0x61, 0x61, 0x82, 0x02, 0x03 };
+  JSONpp::push_parser<JSONpp::json_v> parser;
+  const JSONpp::json_v json = parser(text.data(), text.data()+text.size());
+  std::string bytes;
+  JSONpp::cbor_encode(json, std::back_inserter(bytes));
+  std::ostringstream printed;
+  printed << JSONpp::printer(JSONpp::cbor_decoder<JSONpp::json_v>()(bytes));
+  if (bytes != std::string((const char*)expected, sizeof(expected))
+      or printed.str() != "[0,23,24,1e+06,-1,-1000,1.5,100000,1.1,-0,1e+300,"
+                          "\"\",\"a\",\"\\u00FC\",false,true,null,{\"a\":[2,3]}]") {
+    std::cout << "FAIL (cbor): " << printed.str() << std::endl;
+    ++failures;
+  }
+  // strings that are not std::string come out the same, escaped or not
+  JSONpp::string_pool pool;
+  const std::string escaped = text.substr(0, text.size()-1) + ", {\"k\\ty\": \"tab\\tbed\"}]";
+  std::string interned, plain;
+  JSONpp::cbor_encode(JSONpp::parse_interned<JSONpp::json_interned_v>(escaped.begin(), escaped.end(), pool),
+                      std::back_inserter(interned));
+  JSONpp::cbor_encode(parser(escaped.data(), escaped.data()+escaped.size()), std::back_inserter(plain));
+  if (interned != plain or std::string::npos == plain.find("k\ty")) {
+    std::cout << "FAIL (cbor): interned strings" << std::endl;
+    ++failures;
+  }
+  // lossless numbers keep their kind: 64-bit integers exactly, decimals as
+  // bignums and decimal fractions
+  const std::string lossless = "[9007199254740993,18446744073709551615,-9223372036854775809,"
+    "123456789012345678901234567890,3.14159265358979323846,-0.10000000000000001,1e400,-0]";
+  JSONpp::push_parser<JSONpp::json_lossless_v> exact;
+  std::string exact_bytes;
+  JSONpp::cbor_encode(exact(lossless.data(), lossless.data()+lossless.size()),
+                      std::back_inserter(exact_bytes));
+  printed.str("");
+  printed << JSONpp::printer(JSONpp::cbor_decoder<JSONpp::json_lossless_v>()(exact_bytes));
+  if (printed.str() != lossless
+      or 0 != exact_bytes.find("\x88\x1b\x00\x20\x00\x00\x00\x00\x00\x01", 0, 10)) {
+    std::cout << "FAIL (cbor): lossless " << printed.str() << std::endl;
+    ++failures;
+  }
+  // and as doubles
+  printed.str("");
+  printed << JSONpp::printer(JSONpp::cbor_decoder<JSONpp::json_v>()(exact_bytes));
+  if (printed.str() != "[9.0072e+15,1.84467e+19,-9.22337e+18,1.23457e+29,3.14159,-0.1,inf,-0]") {
+    std::cout << "FAIL (cbor): lossless as doubles " << printed.str() << std::endl;
+    ++failures;
+  }
+  // indefinite lengths, a half float, a tag, and `undefined'
+  const unsigned char more[] = {
+    0xbf, 0x61, 0x61, 0x9f, 0xf9, 0x3c, 0x00, 0xc1, 0x01, 0xf7, 0xff,
+    0x7f, 0x61, 0x62, 0x62, 0x63, 0x64, 0xff, 0xf9, 0xfc, 0x00, 0xff };
+  printed.str("");
+  printed << JSONpp::printer(JSONpp::cbor_decoder<JSONpp::json_v>()(
+    (const char*)more, (const char*)more + sizeof(more)));
+  if (printed.str() != "{\"a\":[1,1,null],\"bcd\":-inf}") {
+    std::cout << "FAIL (cbor): " << printed.str() << std::endl;
+    ++failures;
+  }
+  // truncated, a byte string, and a key that is not text
+  const char* bad[] = { "\x82\x01", "\x41\x00", "\xa1\x01\x02" };
+  for (std::size_t b=0; b<sizeof(bad)/sizeof(bad[0]); ++b) {
+    try {
+      JSONpp::cbor_decoder<JSONpp::json_v>()(std::string(bad[b]));
+      std::cout << "FAIL (cbor): decoded bad CBOR " << b << std::endl;
+      ++failures;
+    } catch (JSONpp::invalid_encoding&) {
+    }
+  }
+}
+
+static void test_image () {
+  const std::string text = "{\"a\": [1, 2.5, \"caf\xc3\xa9\"], \"b\": {\"c\": null, \"d\": true}, \"e\": \"\"}";
+  JSONpp::tape doc;
+  std::ostringstream expected;
+  expected << JSONpp::printer(doc.parse(text));
+  char name[] = "/tmp/jsonpp-image-XXXXXX";
+  const int fd = mkstemp(name);
+  if (fd < 0) {
+    ++failures;
+    return;
+  }
+  close(fd);
+  JSONpp::write_image(doc, name);
+  {
+    // read straight out of the file, and the same after another write
+    JSONpp::document_image image(name, true);
+    JSONpp::write_image(doc, name);
+    std::ostringstream got;
+    got << JSONpp::printer(image.root());
+    if (got.str() != expected.str() or not image.document().words().empty()
+        or image.document().size() != image.root().next()
+        or doc.root().object().find("a")->second.array()[2].str()
+           != image.root().object().find("a")->second.array()[2].str()) {
+      std::cout << "FAIL (image): " << got.str() << " != " << expected.str() << std::endl;
+      ++failures;
+    }
+  }
+  // damaged images: a changed byte, another version, a short file
+  std::string bytes;
+  {
+    std::ifstream in(name, std::ios::binary);
+    bytes.assign((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  }
+  std::string damaged[3] = { bytes, bytes, bytes.substr(0, bytes.size()-1) };
+  damaged[0][bytes.size()-3] ^= 1;
+  damaged[1][8] = char(JSONpp::image_version + 1);
+  for (std::size_t d=0; d<3; ++d) {
+    {
+      std::ofstream out(name, std::ios::binary | std::ios::trunc);
+      out << damaged[d];
+    }
+    try {
+      JSONpp::document_image image(name, true);
+      std::cout << "FAIL (image): opened damaged image " << d << std::endl;
+      ++failures;
+    } catch (JSONpp::bad_image&) {
+    }
+  }
+  {
+    std::ofstream out(name, std::ios::binary | std::ios::trunc);
+    out << damaged[0];
+  }
+  {
+    JSONpp::document_image image(name);   // unverified
+    if (image.verify()) {
+      std::cout << "FAIL (image): verified a damaged image" << std::endl;
+      ++failures;
+    }
+  }
+  // an image of an empty tape has no root either
+  JSONpp::write_image(JSONpp::tape(), name);
+  try {
+    JSONpp::document_image image(name, true);
+    image.root();
+    std::cout << "FAIL (image): the root of an empty image" << std::endl;
+    ++failures;
+  } catch (JSONpp::expected_got&) {
+  }
+  std::remove(name);
+}
+
+// bound structs
+struct bound_point {
+  double x, y;
+  std::string name;
+  std::vector<int> tags;
+  boost::optional<unsigned> count;
+};
+JSONPP_BIND(bound_point, (x)(y)(name)(tags)(count))
+
+struct bound_shape {
+  std::vector<bound_point> points;
+  bool closed;
+  long long id;
+};
+namespace JSONpp {
+  template <> struct json_binding<bound_shape> {
+    template <typename Fields>
+    static void fields (Fields& f) {
+      f("points", &bound_shape::points)("closed", &bound_shape::closed)("id", &bound_shape::id);
+    }
+  };
+}
+
+static void test_bound () {
+  // keys in any order, unknown keys (however deep) skipped, escaped keys
+  const std::string text = "{\"closed\": true, \"extra\": {\"a\": [1, {\"b\": null}]}, "
+    "\"points\": [{\"y\": 2, \"x\": 1.5, \"\\u006eame\": \"caf\xc3\xa9\", \"tags\": [1, -2, 3e2]}, "
+    "{\"count\": null}, {\"count\": 7, \"x\": 0.1}], \"id\": -9223372036854775808}";
+  JSONpp::bound_parser<bound_shape> parser;
+  const bound_shape shape = parser(text);
+  if (3 != shape.points.size() or not shape.closed or -9223372036854775807LL-1 != shape.id
+      or 1.5 != shape.points[0].x or "caf\\u00E9" != shape.points[0].name
+      or 3 != shape.points[0].tags.size() or 300 != shape.points[0].tags[2]
+      or shape.points[1].count or 7u != *shape.points[2].count or 0.1 != shape.points[2].x) {
+    std::cout << "FAIL (bound): " << JSONpp::bound_to_string(shape) << std::endl;
+    ++failures;
+  }
+  // printed, it is what json_v makes of the same (less the unknown key, and
+  // the missing count; json_v prints its numbers short)
+  const std::string printed = JSONpp::bound_to_string(shape);
+  const std::string expected = "{\"closed\":true,\"id\":-9.22337e+18,\"points\":["
+    "{\"name\":\"caf\\u00E9\",\"tags\":[1,-2,300],\"x\":1.5,\"y\":2},"
+    "{\"name\":\"\",\"tags\":[],\"x\":0,\"y\":0},"
+    "{\"count\":7,\"name\":\"\",\"tags\":[],\"x\":0.1,\"y\":0}]}";
+  if (reparse(printed) != expected or parser(printed).points[2].x != 0.1
+      or std::string::npos == printed.find("\"id\":-9223372036854775808")) {
+    std::cout << "FAIL (bound): printed " << printed << std::endl;
+    ++failures;
+  }
+  // decoded strings are UTF-8, and are escaped again
+  const bound_shape utf8 = JSONpp::bound_parser<bound_shape>(JSONpp::decoded)(text);
+  if ("caf\xc3\xa9" != utf8.points[0].name
+      or std::string::npos == JSONpp::bound_to_string(utf8, JSONpp::decoded).find("caf\\u00E9")) {
+    std::cout << "FAIL (bound): decoded " << utf8.points[0].name << std::endl;
+    ++failures;
+  }
+  // digits too many for an integer, scaled back by the exponent
+  if (100000 != parser(std::string("{\"id\": 100000000000000000000e-15}")).id) {
+    std::cout << "FAIL (bound): an integer with an exponent" << std::endl;
+    ++failures;
+  }
+  // mistakes, in known and unknown keys alike
+  const char *bad[] = {
+    "{\"closed\": 1}", "{\"id\": 1.5}", "{\"id\": 9223372036854775808}",
+    "{\"points\": [{\"count\": -1}]}", "{\"points\": {}}", "[]", "",
+    "{\"extra\": [1}", "{\"extra\": {\"a\" 1}}", "{\"id\": 1,}",
+  };
+  for (std::size_t b=0; b<sizeof(bad)/sizeof(bad[0]); ++b) {
+    try {
+      parser(std::string(bad[b]));
+      std::cout << "FAIL (bound): parsed " << bad[b] << std::endl;
+      ++failures;
+    } catch (std::exception&) {
+    }
+  }
+}
+
+static void test_footprint () {
+  typedef JSONpp::json_traits<JSONpp::json_v> traits;
+  // slack put there on purpose: 13 unused elements, 90 unused characters
+  JSONpp::json_v doc = traits::object_t();
+  traits::object_t& object = boost::get<traits::object_t>(doc);
+  object["a"] = traits::array_t();
+  traits::array_t& array = boost::get<traits::array_t>(object["a"]);
+  array.reserve(16);
+  array.push_back(1.0);
+  array.push_back(true);
+  array.push_back(JSONpp::nil());
+  object["s"] = std::string("a string that is too long to keep inside itself");
+  boost::get<std::string>(object["s"]).reserve(std::string("a string that is too long to keep inside itself").size() + 90);
+  const std::string printed = JSONpp::to_string(doc);
+  const JSONpp::footprint before = JSONpp::measure(doc);
+  if (1 != before.numbers.count or 1 != before.booleans.count or 1 != before.nulls.count
+      or 1 != before.strings.count or 1 != before.objects.count or 1 != before.arrays.count
+      or 2 != before.keys.count or sizeof(JSONpp::json_v) != before.numbers.bytes
+      or 13*sizeof(JSONpp::json_v) != before.arrays.slack or 90 > before.strings.slack
+      or before.total().count != 8 or before.bytes() < before.wasted()) {
+    std::cout << "FAIL (footprint): measure" << std::endl << before;
+    ++failures;
+  }
+  JSONpp::shrink_to_fit(doc);
+  const JSONpp::footprint after = JSONpp::measure(doc);
+  if (JSONpp::to_string(doc) != printed or 0 != after.total().slack
+      or before.bytes() - before.total().slack != after.bytes()) {
+    std::cout << "FAIL (footprint): shrink_to_fit" << std::endl << after;
+    ++failures;
+  }
+  // flat objects keep their slack, and their index, until they are shrunk
+  std::string text = "{";
+  for (int i=0; i<20; ++i) {
+    std::ostringstream member;
+    member << (i ? ", " : "") << "\"key" << i << "\": [" << i << "]";
+    text += member.str();
+  }
+  text += "}";
+  JSONpp::push_parser<JSONpp::json_flat_v> parser;
+  JSONpp::json_flat_v flat = parser(text);
+  JSONpp::shrink_to_fit(flat);
+  const JSONpp::footprint fitted = JSONpp::measure(flat);
+  const JSONpp::json_flat_gen::object_t& members = boost::get<JSONpp::json_flat_gen::object_t>(flat);
+  if (0 != fitted.total().slack or 0 == fitted.objects.overhead or 20 != fitted.keys.count
+      or members.capacity() != 20 or members.end() == members.find("key17")
+      or 17 != boost::get<double>(boost::get<JSONpp::json_flat_gen::array_t>(members.find("key17")->second)[0])) {
+    std::cout << "FAIL (footprint): flat" << std::endl << fitted;
+    ++failures;
+  }
+}
+
 int main (int argc, char *argv[]) {
 
-  if (argc < 1)
+  test_parser();
+  test_events();
+  test_numbers();
+  test_lossless();
+  test_incremental();
+  test_utf();
+  test_decoded();
+  test_transcode();
+  test_printer();
+  test_arena();
+  test_tape();
+  test_flat_map();
+  test_intern();
+  test_compact();
+  test_lazy();
+  test_parallel();
+  test_cbor();
+  test_image();
+  test_bound();
+  test_footprint();
+  test_open();
+  test_ndjson();
+  if (0 != failures)
     return 1;
 
-  for (++argv; argc > 0; --argc, ++argv) {
+  for (++argv; argc > 1; --argc, ++argv) {
     std::cout << *argv << std::endl;
     try {
-      std::wifstream wifstr(*argv);
-
-      transcode_iterator<wchar_t> st(wifstr);
-
-      wifstr >> std::noskipws;
-      std::istream_iterator<wchar_t,wchar_t> ctr(wifstr);
-      std::istream_iterator<wchar_t,wchar_t> cnd;
-      JSONpp::json_v json = JSONpp::parse(ctr, cnd);
+      JSONpp::json_v json = JSONpp::open(*argv);
       std::cout << JSONpp::std_ascii << JSONpp::printer(json) << std::endl;
     } catch (std::exception& e) {
       std::cout << "error: " << e.what() << std::endl;